@@ -19,7 +19,8 @@ using namespace std;
 long Flow::s_flowIdTracker = 0;
 
 Flow::Flow(double startTime, int src, int dest, long sizeInByte) {
-  m_flowId = s_flowIdTracker++;
+  m_flowId = Coflow::defer_ids_ ? -1 : s_flowIdTracker++;
+  index_in_coflow_ = 0;
   m_startTime = startTime;
   m_endTime = INVALID_TIME;
   m_src = src;
@@ -31,11 +32,21 @@ Flow::Flow(double startTime, int src, int dest, long sizeInByte) {
   m_elecBps = 0.0;
   m_optcBps = 0.0;
 
-  bits_thru_side_ = 0;
-  bits_thru_main_ = 0;
-
   parent_coflow_ = nullptr;
   assigned_scheduler_ = nullptr;
+
+  parent_flow_ = nullptr;
+  num_sub_flows_ = 0;
+  num_sub_flows_finished_ = 0;
+}
+
+Flow::Flow(double startTime, const vector<int> &srcs, int dest,
+           long sizeInByte)
+    : Flow(startTime, srcs.front(), dest, sizeInByte) {
+  if (srcs.size() > 1) {
+    group_srcs_ = srcs;
+    group_indices_.assign(srcs.size(), 0);
+  }
 }
 
 Flow::~Flow() {
@@ -44,10 +55,102 @@ Flow::~Flow() {
 }
 
 void Flow::SetRate(long elecBps, long optcBps) {
+  if (parent_flow_) {
+    // parent flow's rate is the aggregated rate of all its sub-flows.
+    parent_flow_->m_elecBps += elecBps - m_elecBps;
+    parent_flow_->m_optcBps += optcBps - m_optcBps;
+  }
   m_elecBps = elecBps;
   m_optcBps = optcBps;
 }
 
+Flow *Flow::CreateSubFlow(long size_in_bit) {
+  Flow *sub_flow = new Flow(m_startTime, m_src, m_dest, 0);
+  sub_flow->m_sizeInBit = size_in_bit;
+  sub_flow->m_bitsLeft = size_in_bit;
+  sub_flow->m_thruOptic = m_thruOptic;
+  sub_flow->index_in_coflow_ = index_in_coflow_;
+  sub_flow->parent_coflow_ = parent_coflow_;
+  sub_flow->parent_flow_ = this;
+  num_sub_flows_++;
+  return sub_flow;
+}
+
+Flow *Flow::SplitMembers(const vector<int> &srcs) {
+  Flow *split = new Flow(m_startTime, srcs, m_dest, 0);
+  split->m_sizeInBit = m_sizeInBit;
+  split->m_bitsLeft = m_bitsLeft;
+  split->m_elecBps = m_elecBps;
+  split->m_optcBps = m_optcBps;
+  split->m_thruOptic = m_thruOptic;
+  split->parent_coflow_ = parent_coflow_;
+  vector<int> split_indices;
+  for (int src : srcs) {
+    auto src_it = find(group_srcs_.begin(), group_srcs_.end(), src);
+    auto index_it = group_indices_.begin() + (src_it - group_srcs_.begin());
+    split_indices.push_back(*index_it);
+    group_srcs_.erase(src_it);
+    group_indices_.erase(index_it);
+  }
+  // both groups take the index of their first member.
+  split->SetMemberIndicesInCoflow(split_indices);
+  split->index_in_coflow_ = split_indices.front();
+  m_src = group_srcs_.front();
+  index_in_coflow_ = group_indices_.front();
+  if (group_srcs_.size() == 1) {
+    group_srcs_.clear();
+    group_indices_.clear();
+  }
+  return split;
+}
+
+void Flow::MergeFlow(long size_in_byte) {
+  if (merged_size_in_bit_.empty()) merged_size_in_bit_.push_back(m_sizeInBit);
+  merged_size_in_bit_.push_back(size_in_byte * 8);
+  m_sizeInBit += size_in_byte * 8;
+  m_bitsLeft += size_in_byte * 8;
+}
+
+bool Flow::SubFlowFinishInc() {
+  if (num_sub_flows_finished_ >= num_sub_flows_) {
+    cerr << "[Flow::SubFlowFinishInc] ERROR: " << toString() << " has "
+         << num_sub_flows_finished_ << " of " << num_sub_flows_
+         << " sub-flows finished already" << endl;
+    exit(-1);
+  }
+  num_sub_flows_finished_++;
+  return num_sub_flows_finished_ >= num_sub_flows_;
+}
+
+void Flow::ConsumeBits(long bits) {
+  m_bitsLeft -= bits;
+  if (!parent_flow_) return;
+  parent_flow_->m_bitsLeft -= bits;
+  if (m_bitsLeft <= 0) {
+    // a finished sub-flow no longer contributes to the parent flow's rate.
+    SetRate(0, 0);
+  }
+}
+
+void Flow::AddBitsThruNetwork(int net_idx, long bits) {
+  if (net_idx >= (int) bits_thru_net_.size()) {
+    bits_thru_net_.resize(net_idx + 1, 0);
+  }
+  bits_thru_net_[net_idx] += bits;
+}
+
+long Flow::GetBitsOnNetwork(int net_idx) {
+  return net_idx < (int) bits_thru_net_.size() ? bits_thru_net_[net_idx] : 0;
+}
+
+long Flow::GetBitsOnSide() {
+  long bits_on_side = 0;
+  for (int net_idx = 1; net_idx < (int) bits_thru_net_.size(); net_idx++) {
+    bits_on_side += bits_thru_net_[net_idx];
+  }
+  return bits_on_side;
+}
+
 bool Flow::isRawFlow() {
   if (m_bitsLeft != m_sizeInBit
       || m_elecBps != 0
@@ -70,7 +173,7 @@ long Flow::Transmit(double startTime, double endTime) {
     bps = m_elecBps;
   }
   long tBitsValid = tBits < m_bitsLeft ? tBits : m_bitsLeft;
-  m_bitsLeft -= tBitsValid;
+  ConsumeBits(tBitsValid);
 
   //debug msg
   if (DEBUG_LEVEL >= 15) {
@@ -87,9 +190,25 @@ long Flow::Transmit(double startTime, double endTime) {
   return m_bitsLeft;
 }
 
+long Flow::TransmitDeferred(double startTime,
+                            const vector<double> &endTimes) {
+  long bps = m_thruOptic ? m_optcBps : m_elecBps;
+  long tBits = 0;
+  for (double endTime : endTimes) {
+    // same rounding as Transmit(), interval by interval.
+    tBits += ceil((endTime - startTime) * bps);
+    startTime = endTime;
+  }
+  if (tBits >= m_bitsLeft) {
+    return -1;
+  }
+  ConsumeBits(tBits);
+  return tBits;
+}
+
 long Flow::TxLocal() {
   if (!REMOTE_IN_OUT_PORTS && m_src == m_dest) {
-    m_bitsLeft = 0;
+    ConsumeBits(m_bitsLeft);
   }
   return m_bitsLeft;
 }
@@ -102,7 +221,7 @@ long Flow::TxSalvage() {
     bps = m_elecBps;
   }
   if (bps > 0 && m_bitsLeft <= 10) {
-    m_bitsLeft = 0;
+    ConsumeBits(m_bitsLeft);
   }
   return m_bitsLeft;
 }
@@ -117,7 +236,9 @@ string Flow::toString() {
   std::stringstream ss;
   ss << "Flow-[" << m_flowId << ", "
      << m_src << "->" << m_dest << " "
-     << m_bitsLeft << " bits] ";
+     << m_bitsLeft << " bits";
+  if (!group_srcs_.empty()) ss << " x " << group_srcs_.size();
+  ss << "] ";
   return ss.str();
 }
 
@@ -150,10 +271,12 @@ string Coflow::toString() {
 }
 
 int Coflow::s_coflowIdTracker = 0;
+thread_local bool Coflow::defer_ids_ = false;
 
 Coflow::Coflow(double startTime) {
   m_job_id = -1;
-  m_coflowId = s_coflowIdTracker++;
+  m_coflowId = defer_ids_ ? -1 : s_coflowIdTracker++;
+  coflow_rand_seed_ = 0;
   m_startTime = startTime;
   m_nFlows = 0;
   m_nFlowsCompleted = 0;
@@ -168,6 +291,7 @@ Coflow::Coflow(double startTime) {
   m_is_rejected = false;
 
   has_route_ = false;
+  infocom_sticky_route_ = false;
 }
 
 Coflow::~Coflow() {
@@ -182,7 +306,7 @@ Coflow::~Coflow() {
   flows_.clear();
 }
 
-bool Coflow::NumFlowFinishInc() {
+bool Coflow::NumFlowFinishInc(Flow *finished_flow) {
   if (m_nFlowsCompleted < m_nFlows) {
     m_nFlowsCompleted++;
     return true;
@@ -199,6 +323,11 @@ bool Coflow::isRawCoflow() {
   return true;
 }
 
+void Coflow::AssignIds() {
+  m_coflowId = s_coflowIdTracker++;
+  for (Flow *flow : flows_) flow->AssignId();
+}
+
 void
 Coflow::AddFlow(Flow *fp) {
   if (!fp) return;
@@ -209,16 +338,27 @@ Coflow::AddFlow(Flow *fp) {
   // by default, use 1G to estimate.
   if (!REMOTE_IN_OUT_PORTS && fp->GetSrc() == fp->GetDest()) return;
 
+  // a flow group loads each member src, and its dst once per member.
+  int num_members = fp->GetNumMembers();
   double time = fp->GetSizeInBit() / (double) DEFAULT_LINK_RATE_BPS;
-  MapWithInc(m_src_time, fp->GetSrc(), time);
-  MapWithInc(m_dst_time, fp->GetDest(), time);
   long bits = fp->GetSizeInBit();
-  MapWithInc(m_src_bits, fp->GetSrc(), bits);
-  MapWithInc(m_dst_bits, fp->GetDest(), bits);
-  m_coflow_size_in_bytes += (bits / 8.0);
+  for (int member_idx = 0; member_idx < num_members; member_idx++) {
+    MapWithInc(m_src_time, fp->GetMemberSrc(member_idx), time);
+    MapWithInc(m_src_bits, fp->GetMemberSrc(member_idx), bits);
+  }
+  MapWithInc(m_dst_time, fp->GetDest(), time * num_members);
+  MapWithInc(m_dst_bits, fp->GetDest(), bits * num_members);
+  m_coflow_size_in_bytes += (bits * num_members / 8.0);
 
 }
 
+Flow *Coflow::SplitFlowGroup(Flow *group, const vector<int> &srcs) {
+  Flow *split = group->SplitMembers(srcs);
+  flows_.push_back(split);
+  m_nFlows++;
+  return split;
+}
+
 long
 Coflow::GetMaxPortLoadInBits() {
   double max_src = MaxMap(m_src_bits);
@@ -299,7 +439,7 @@ double Coflow::GetOptimalWorkSpanOnPortInSeconds(int src, int dst) {
 long Coflow::CalcTotalBitsLeft() {
   m_bits_left = 0;
   for (Flow *flow : flows_) {
-    m_bits_left += flow->GetBitsLeft();
+    m_bits_left += flow->GetBitsLeft() * flow->GetNumMembers();
   }
   return m_bits_left;
 }
@@ -310,8 +450,12 @@ long Coflow::CalcAlpha() {
   map<int, long> sBits;
   map<int, long> rBits;
   for (Flow *flow :flows_) {
-    MapWithInc(sBits, flow->GetSrc(), flow->GetBitsLeft());
-    MapWithInc(rBits, flow->GetDest(), flow->GetBitsLeft());
+    for (int member_idx = 0; member_idx < flow->GetNumMembers();
+         member_idx++) {
+      MapWithInc(sBits, flow->GetMemberSrc(member_idx), flow->GetBitsLeft());
+    }
+    MapWithInc(rBits, flow->GetDest(),
+               flow->GetBitsLeft() * flow->GetNumMembers());
   }
 
   long sBitsMax = MaxMap(sBits);
@@ -9,7 +9,9 @@
 #ifndef COFLOW_H
 #define COFLOW_H
 
+#include <cstdint>
 #include <vector>
+#include "flow_size_matrix.h"
 #include "util.h"
 
 #include <map>
@@ -23,8 +25,20 @@ class Scheduler;
 class Flow {
  public:
   Flow(double startTime, int src, int dest, long sizeInByte);
+  // Flow-group mode. A group of identical flows, one from each of srcs to
+  // dest, each of sizeInByte, is scheduled and transmitted as a unit. Sizes,
+  // bits left and rates are those of each member, and every member loads its
+  // own src as well as the dst.
+  Flow(double startTime, const vector<int> &srcs, int dest, long sizeInByte);
   ~Flow();
   long GetFlowId() { return m_flowId; }
+  // Take the next flow id, for flows built while Coflow::defer_ids_.
+  void AssignId() { m_flowId = s_flowIdTracker++; }
+  // mapper_idx * num_reducers + reducer_idx in the parent coflow, which keys
+  // the random stream of the flow. Sub-flows share it with their parent, and
+  // a flow group takes that of its first member.
+  int GetIndexInCoflow() { return index_in_coflow_; }
+  void SetIndexInCoflow(int index) { index_in_coflow_ = index; }
 
   double GetStartTime() { return m_startTime; }
   void SetEndTime(double endtime) { m_endTime = endtime; }
@@ -34,33 +48,85 @@ class Flow {
   Coflow *GetParentCoflow() { return parent_coflow_; }
 
   bool HasDemand();
+  // src of the first member if a flow group.
   int GetSrc() { return m_src; }
+  // 1 unless a flow group.
+  int GetNumMembers() { return group_srcs_.empty() ? 1 : group_srcs_.size(); }
+  int GetMemberSrc(int member_idx) {
+    return group_srcs_.empty() ? m_src : group_srcs_[member_idx];
+  }
+  // index in the parent coflow of the flow of a member, as without groups.
+  int GetMemberIndexInCoflow(int member_idx) {
+    return group_srcs_.empty() ? index_in_coflow_ : group_indices_[member_idx];
+  }
+  void SetMemberIndicesInCoflow(const vector<int> &indices) {
+    if (!group_srcs_.empty()) group_indices_ = indices;
+  }
+  // Move the members from srcs out of this flow group into a new flow group,
+  // with the same bits left and rates.
+  Flow *SplitMembers(const vector<int> &srcs);
+  // Rack-pair aggregation. Merge a flow of size_in_byte between the same
+  // racks into this (raw) flow, which keeps the sizes of the flows merged.
+  void MergeFlow(long size_in_byte);
+  // 1 unless flows are merged into this one.
+  int GetNumMerged() {
+    return merged_size_in_bit_.empty() ? 1 : merged_size_in_bit_.size();
+  }
+  long GetMergedSizeInBit(int merged_idx) {
+    return merged_size_in_bit_.empty() ? m_sizeInBit
+                                       : merged_size_in_bit_[merged_idx];
+  }
   int GetDest() { return m_dest; }
   long GetSizeInBit() { return m_sizeInBit; }
   long GetBitsLeft() { return m_bitsLeft; }
   long GetElecRate(void) { return m_elecBps; }
   long GetOptcRate(void) { return m_optcBps; }
-  long GetBitsOnMain() { return bits_thru_main_; }
-  long GetBitsOnSide() { return bits_thru_side_; }
+  // Bits routed through the main network (index 0) and through all the other
+  // side networks, respectively.
+  long GetBitsOnMain() { return GetBitsOnNetwork(0); }
+  long GetBitsOnSide();
+  long GetBitsOnNetwork(int net_idx);
   void SetRate(long elecBps, long optcBps);
   void SetThruOptic(bool thruOptc) { m_thruOptic = thruOptc; }
   bool isThruOptic() { return m_thruOptic; }
   bool isRawFlow();
   long Transmit(double startTime, double endTime);// return bitsLeft
+  // Replay Transmit() over consecutive intervals (startTime, endTimes[0]],
+  // (endTimes[0], endTimes[1]], ... in one go. Return the bits transmitted,
+  // or -1 (with nothing transmitted) if the flow would finish on the way.
+  long TransmitDeferred(double startTime, const vector<double> &endTimes);
   long TxSalvage();// clear flow if smaller than threshold.
   long TxLocal();  // clear flow if local rack; return bitsLeft otherwise
-  void SetBitsThruHybrid(long bits_thru_main, long bits_thru_side) {
-    bits_thru_main_ = bits_thru_main;
-    bits_thru_side_ = bits_thru_side;
-  }
+  // Used for accounting in hybrid net with K networks, indexed by the order
+  // of the children schedulers.
+  void AddBitsThruNetwork(int net_idx, long bits);
+
+  // Split-flow mode. A parent flow is represented by sub-flows, each on one
+  // network. The sub-flow is owned by the child coflow holding it; the parent
+  // flow only keeps aggregated bits left and rates of its sub-flows.
+  Flow *CreateSubFlow(long size_in_bit);
+  Flow *GetParentFlow() { return parent_flow_; }
+  bool IsSubFlow() { return parent_flow_ != nullptr; }
+  int GetNumSubFlows() { return num_sub_flows_; }
+  int GetNumSubFlowsFinished() { return num_sub_flows_finished_; }
+  // return true if all sub-flows of this (parent) flow have finished.
+  bool SubFlowFinishInc();
+
   std::string toString();
   Scheduler *assigned_scheduler_;
   std::string assigned_scheduler_name_;
  private:
   static long s_flowIdTracker;
   long m_flowId;
+  int index_in_coflow_;
   int m_src;
   int m_dest;
+  // srcs of the members of a flow group, and their indices in the parent
+  // coflow, empty otherwise.
+  vector<int> group_srcs_;
+  vector<int> group_indices_;
+  // sizes of the flows merged into this one, empty if none.
+  vector<long> merged_size_in_bit_;
   bool m_thruOptic;
   long m_sizeInBit;
   long m_bitsLeft;
@@ -69,77 +135,19 @@ class Flow {
   long m_elecBps;
   long m_optcBps;
 
-  // Used for accounting in hybrid net.
-  long bits_thru_side_;
-  long bits_thru_main_;
+  // Used for accounting in hybrid net. bits_thru_net_[i] is the bits routed
+  // through the i-th network.
+  vector<long> bits_thru_net_;
 
   Coflow *parent_coflow_; // not owned.
-};
 
-class CompTimeBreakdown {
- public:
-  CompTimeBreakdown() {
-    m_time_shuffle_random = 0.0;
-    m_time_sort = 0.0;
-    m_time_reserve = 0.0;
-    m_time_stuff = 0.0;
-    m_time_slice = 0.0;
-  }
-  double GetSunflowTotalTime() {
-    return m_time_shuffle_random
-        + m_time_sort
-        + m_time_reserve;
-  }
-  double GetSolsticeTotalTime() {
-    return m_time_stuff + m_time_slice;
-  }
-  double GetVectorAvgTime() {
-    // for ansop
-    if (m_time_vector.empty()) return 0.0;
-    double sum = 0.0;
-    for (vector<double>::const_iterator
-             t = m_time_vector.begin();
-         t != m_time_vector.end();
-         t++) {
-      sum += *t;
-    }
-    return sum / m_time_vector.size(); // avg
-  }
-  double GetVectorMaxTime() {
-    // for ansop
-    double max = -1.0;
-    for (vector<double>::const_iterator
-             t = m_time_vector.begin();
-         t != m_time_vector.end();
-         t++) {
-      if (max < *t || max < 0) {
-        max = *t;
-      }
-    }
-    return max;
-  }
-  double GetVectorMinTime() {
-    // for ansop
-    double min = -1.0;
-    for (vector<double>::const_iterator
-             t = m_time_vector.begin();
-         t != m_time_vector.end();
-         t++) {
-      if (min > *t || min < 0) {
-        min = *t;
-      }
-    }
-    return min;
-  }
-  // for sunflow
-  double m_time_shuffle_random;
-  double m_time_sort;
-  double m_time_reserve;
-  // for conext
-  double m_time_stuff;
-  double m_time_slice;
-  // for ansop
-  vector<double> m_time_vector;
+  // Used by split-flow mode.
+  Flow *parent_flow_; // not owned.
+  int num_sub_flows_;
+  int num_sub_flows_finished_;
+
+  // deduct bits from this flow, as well as the parent flow if any.
+  void ConsumeBits(long bits);
 };
 
 class Coflow {
@@ -147,6 +155,12 @@ class Coflow {
   Coflow(double startTime);
   virtual ~Coflow();
   int GetCoflowId() { return m_coflowId; }
+  // Take the next coflow id, then the next flow ids in the order of flows.
+  // Coflows built while defer_ids_ get the same ids as if built here.
+  void AssignIds();
+  // If set, coflows and flows built on this thread get id -1 until
+  // AssignIds(), so that coflows may be built on other threads in any order.
+  static thread_local bool defer_ids_;
   virtual int GetJobId() { return m_job_id; }
   void SetJobId(int job_id) { m_job_id = job_id; }
   double GetEndTime() { return m_endTime; }
@@ -160,10 +174,10 @@ class Coflow {
   const vector<int> &GetReducerLocations() { return reducer_locations_; }
   int GetNumMap() { return mapper_locations_.size(); }
   int GetNumRed() { return reducer_locations_.size(); }
-  void SetMRFlowBytes(const map<pair<int, int>, long> &mr_flow_bytes) {
-    mr_flow_bytes_ = mr_flow_bytes;
+  void SetMRFlowBytes(FlowSizeMatrix &&mr_flow_bytes) {
+    mr_flow_bytes_ = std::move(mr_flow_bytes);
   }
-  const map<pair<int, int>, long> &GetMRFlowBytes() { return mr_flow_bytes_; }
+  const FlowSizeMatrix &GetMRFlowBytes() { return mr_flow_bytes_; }
 
   void SetMapReduceLoadMB(const vector<int> &mapper_locations,
                           const vector<int> &reducer_locations,
@@ -188,6 +202,9 @@ class Coflow {
   }
 
   virtual void AddFlow(Flow *f);
+  // Split the members from srcs off a flow group of this coflow, e.g. as they
+  // are rated apart, into a flow group of their own. Port loads stay.
+  Flow *SplitFlowGroup(Flow *group, const vector<int> &srcs);
 
   long GetMaxPortLoadInBits();
   double GetMaxPortLoadInSec();
@@ -210,12 +227,6 @@ class Coflow {
   bool IsRejected() { return m_is_rejected; }
   void SetRejected() { m_is_rejected = true; }
 
-  void SetCompTime(CompTimeBreakdown comptime) { m_comp_time = comptime; }
-  void AddTimeToVector(double one_slot_computation_time) {
-    m_comp_time.m_time_vector.push_back(one_slot_computation_time);
-  }
-  CompTimeBreakdown GetCompTime() { return m_comp_time; }
-
   void SetStaticAlpha(long alpha) { m_static_alpha = alpha; }
   long GetStaticAlpha() { return m_static_alpha; }
 
@@ -235,12 +246,15 @@ class Coflow {
 
   vector<Flow *> *GetFlows(void) { return &flows_; }
 
-  virtual bool NumFlowFinishInc();
+  // finished_flow is the flow in this coflow that just finished.
+  virtual bool NumFlowFinishInc(Flow *finished_flow);
   bool isRawCoflow();
 
   void Print();
   string toString();
-  int coflow_rand_seed_;
+  // run seed of the random streams of this coflow, keyed with its job id.
+  // See counter_rng.h.
+  uint64_t coflow_rand_seed_;
 
   void SetName(string n) { name_ = n; }
   string GetName() {
@@ -249,6 +263,8 @@ class Coflow {
 
   // Used by mobihoc/infocom solver.
   bool has_route_;
+  // the route is kept across reschedules, in sticky routing of infocom.
+  bool infocom_sticky_route_;
   double mobihoc_base_alpha_;
   double infocom_base_cct_;
 
@@ -264,7 +280,7 @@ class Coflow {
   vector<int> mapper_locations_;
   vector<int> reducer_locations_;
   // map from (mapper_idx, reducer_idx) to the size of flows between them.
-  map<pair<int, int>, long> mr_flow_bytes_;
+  FlowSizeMatrix mr_flow_bytes_;
 
   int m_coflowId;
   int m_nFlows;
@@ -293,8 +309,6 @@ class Coflow {
   // aalo
   double m_coflow_sent_bytes;
 
-  CompTimeBreakdown m_comp_time;
-
   /* data */
 };
 
@@ -304,12 +318,24 @@ class ChildCoflow : public Coflow {
       : Coflow(parent_coflow->GetStartTime()), parent_coflow_(parent_coflow) {}
   virtual ~ChildCoflow() {
     // cout << "ChildCoflow destructor called.\n";
+    for (Flow *flow : flows_) {
+      // sub-flows are owned by this child coflow.
+      if (flow->IsSubFlow()) delete flow;
+    }
     flows_.clear(); // not allow base class to delete flows.
   }
   virtual bool IsComplete() { return parent_coflow_->IsComplete(); }
-  virtual bool NumFlowFinishInc() {
+  // Returns true if the parent coflow has one more flow finished, i.e. either
+  // a whole flow or the last sub-flow of a parent flow has finished.
+  virtual bool NumFlowFinishInc(Flow *finished_flow) {
     m_nFlowsCompleted++;
-    return parent_coflow_->NumFlowFinishInc();
+    Flow *parent_flow = finished_flow->GetParentFlow();
+    if (parent_flow && !parent_flow->SubFlowFinishInc()) {
+      // other sub-flows of the parent flow are still in flight.
+      return false;
+    }
+    return parent_coflow_->NumFlowFinishInc(
+        parent_flow ? parent_flow : finished_flow);
   }
   virtual int GetJobId() { return parent_coflow_->GetJobId(); }
   virtual Coflow *GetRootCoflow() { return parent_coflow_; }
@@ -0,0 +1,56 @@
+//
+//  comp_time_model.cc
+//  Ximulator
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "comp_time_model.h"
+
+const double CostCompTimeModel::DEFAULT_BASE_USEC = 0;
+const double CostCompTimeModel::DEFAULT_COFLOW_USEC = 0;
+const double CostCompTimeModel::DEFAULT_FLOW_USEC = 1.2;
+const double CostCompTimeModel::DEFAULT_PORT_USEC = 0;
+
+CompTimeModel* CompTimeModel::Create(const string& name) {
+  if (name == "measured") {
+    return new MeasuredCompTimeModel();
+  }
+  if (name == "cost") {
+    return new CostCompTimeModel(CostCompTimeModel::DEFAULT_BASE_USEC,
+                                 CostCompTimeModel::DEFAULT_COFLOW_USEC,
+                                 CostCompTimeModel::DEFAULT_FLOW_USEC,
+                                 CostCompTimeModel::DEFAULT_PORT_USEC);
+  }
+  if (name.substr(0, 5) == "cost_") {
+    // "cost_B_C_F_P"
+    string costs = name.substr(5);
+    for (char& c : costs) {
+      if (c == '_') c = ' ';
+    }
+    istringstream cost_stream(costs);
+    double base_usec, coflow_usec, flow_usec, port_usec;
+    string rest;
+    if (cost_stream >> base_usec >> coflow_usec >> flow_usec >> port_usec
+        && !(cost_stream >> rest)) {
+      return new CostCompTimeModel(base_usec, coflow_usec, flow_usec,
+                                   port_usec);
+    }
+  }
+  cerr << "[CompTimeModel::Create] ERROR: unknown computation time model "
+       << name << endl;
+  exit(-1);
+}
+
+double MeasuredCompTimeModel::Stop(const CompTimeCounters& counters) {
+  return chrono::duration<double>(
+      chrono::steady_clock::now() - start_time_).count();
+}
+
+double CostCompTimeModel::Stop(const CompTimeCounters& counters) {
+  return (base_usec_ + coflow_usec_ * counters.num_coflows
+      + flow_usec_ * counters.num_flows + port_usec_ * counters.num_ports)
+      / 1e6;
+}
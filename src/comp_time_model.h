@@ -0,0 +1,79 @@
+//
+//  comp_time_model.h
+//  Ximulator
+//
+//  Computation time of a reschedule, by which a scheduler delays the new
+//  schedule unless ZERO_COMP_TIME. Models are selected by name:
+//  - "measured": time of the rate control on a monotonic clock.
+//  - "cost": a linear cost of the work of the rate control, which is the
+//    same on any machine. "cost_B_C_F_P" costs B + C per coflow + F per flow
+//    + P per port in microseconds, "cost" uses calibrated defaults.
+//
+
+#ifndef COMP_TIME_MODEL_H
+#define COMP_TIME_MODEL_H
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+// work of a rate control.
+struct CompTimeCounters {
+  long num_coflows = 0;
+  // flows with demand.
+  long num_flows = 0;
+  // distinct src and dst ports of the flows.
+  long num_ports = 0;
+};
+
+class CompTimeModel {
+ public:
+  // Caller owns the model. Exits on an unknown name.
+  static CompTimeModel* Create(const string& name);
+
+  virtual ~CompTimeModel() {}
+  // Called right before the rate control.
+  virtual void Start() = 0;
+  // Called right after the rate control, with its work. Returns the
+  // computation time in seconds.
+  virtual double Stop(const CompTimeCounters& counters) = 0;
+  // false if counters are ignored, so that they need not be counted.
+  virtual bool UsesCounters() = 0;
+};
+
+class MeasuredCompTimeModel : public CompTimeModel {
+ public:
+  virtual void Start() { start_time_ = chrono::steady_clock::now(); }
+  virtual double Stop(const CompTimeCounters& counters);
+  virtual bool UsesCounters() { return false; }
+
+ private:
+  chrono::steady_clock::time_point start_time_;
+};
+
+class CostCompTimeModel : public CompTimeModel {
+ public:
+  CostCompTimeModel(double base_usec, double coflow_usec, double flow_usec,
+                    double port_usec)
+      : base_usec_(base_usec), coflow_usec_(coflow_usec),
+        flow_usec_(flow_usec), port_usec_(port_usec) {}
+  virtual void Start() {}
+  virtual double Stop(const CompTimeCounters& counters);
+  virtual bool UsesCounters() { return true; }
+
+  // fit to the measured model of varysImpl and aaloImpl on
+  // trace/fbtrace-1hr.txt, whose time grows with the flows only.
+  static const double DEFAULT_BASE_USEC;
+  static const double DEFAULT_COFLOW_USEC;
+  static const double DEFAULT_FLOW_USEC;
+  static const double DEFAULT_PORT_USEC;
+
+ private:
+  const double base_usec_;
+  const double coflow_usec_;
+  const double flow_usec_;
+  const double port_usec_;
+};
+
+#endif //COMP_TIME_MODEL_H
@@ -0,0 +1,89 @@
+//
+//  counter_rng.h
+//  Ximulator
+//
+//  A counter-based random generator, Philox4x32-10 (Salmon et al., SC'11).
+//  Each random block is a pure function of a key and a counter, so that a
+//  stream keyed by (run seed, coflow id, flow index) is the same however many
+//  coflows there are and in whatever order, or on whichever thread, they are
+//  created. Construction costs nothing but the key, unlike mt19937.
+//
+
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class CounterRng {
+ public:
+  typedef uint32_t result_type;
+  // flow index of the stream of a coflow as a whole.
+  static const uint32_t COFLOW_STREAM = 0xffffffff;
+
+  CounterRng(uint64_t seed, uint32_t coflow_id, uint32_t flow_idx)
+      : key_{(uint32_t) seed, (uint32_t) (seed >> 32)}, block_(0),
+        coflow_id_(coflow_id), flow_idx_(flow_idx), used_(4) {}
+
+  // UniformRandomBitGenerator, e.g. for std::shuffle.
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xffffffff; }
+  result_type operator()() {
+    if (used_ == 4) {
+      Generate();
+      used_ = 0;
+    }
+    return out_[used_++];
+  }
+
+  // 53 random bits in [0, 1).
+  double Uniform() {
+    // drawn in sequence, as operands are evaluated in unspecified order.
+    uint32_t hi = (*this)();
+    uint32_t lo = (*this)();
+    uint64_t bits = ((uint64_t) hi << 21) ^ (lo >> 11);
+    return bits * (1.0 / 9007199254740992.0);
+  }
+  // in [0, n), by multiply-shift, whose bias is below n / 2^32.
+  uint32_t Below(uint32_t n) {
+    return (uint32_t) (((uint64_t) (*this)() * n) >> 32);
+  }
+  // index i with probability (cumulative[i] - cumulative[i - 1]) /
+  // cumulative.back(), for non-decreasing cumulative weights.
+  int Pick(const vector<long>& cumulative) {
+    long draw = (long) (Uniform() * cumulative.back());
+    return (int) (upper_bound(cumulative.begin(), cumulative.end(), draw)
+        - cumulative.begin());
+  }
+
+ private:
+  void Generate() {
+    uint32_t c[4] = {(uint32_t) block_, (uint32_t) (block_ >> 32),
+                     flow_idx_, coflow_id_};
+    uint32_t k[2] = {key_[0], key_[1]};
+    for (int round = 0; round < 10; round++) {
+      uint64_t p0 = (uint64_t) 0xD2511F53 * c[0];
+      uint64_t p1 = (uint64_t) 0xCD9E8D57 * c[2];
+      uint32_t next[4] = {(uint32_t) (p1 >> 32) ^ c[1] ^ k[0], (uint32_t) p1,
+                          (uint32_t) (p0 >> 32) ^ c[3] ^ k[1], (uint32_t) p0};
+      copy(next, next + 4, c);
+      k[0] += 0x9E3779B9;
+      k[1] += 0xBB67AE85;
+    }
+    copy(c, c + 4, out_);
+    block_++;
+  }
+
+  const uint32_t key_[2];
+  uint64_t block_;
+  const uint32_t coflow_id_;
+  const uint32_t flow_idx_;
+  // random words of the last block, and how many are used.
+  uint32_t out_[4];
+  int used_;
+};
+
+#endif //COUNTER_RNG_H
@@ -18,15 +18,21 @@ void DbLogger::WriteCoflowFeatures(Coflow* coflow) {
   double min_flow_size_Gbit = -1.0;
   double max_flow_size_Gbit = -1.0;
 
-  int flow_num = (int) coflow->GetFlows()->size();
+  // members of a flow group, and flows merged, count as flows of their own.
+  int flow_num = 0;
   for (Flow* flow : *(coflow->GetFlows())) {
-    double this_flow_size_Gbit = ((double) flow->GetSizeInBit() / 1e9);
-    total_flow_size_Gbit += this_flow_size_Gbit; // each flow >= 1MB
-    if (min_flow_size_Gbit > this_flow_size_Gbit || min_flow_size_Gbit < 0) {
-      min_flow_size_Gbit = this_flow_size_Gbit;
-    }
-    if (max_flow_size_Gbit < this_flow_size_Gbit || max_flow_size_Gbit < 0) {
-      max_flow_size_Gbit = this_flow_size_Gbit;
+    flow_num += flow->GetNumMembers() * flow->GetNumMerged();
+    total_flow_size_Gbit +=
+        flow->GetSizeInBit() * flow->GetNumMembers() / 1e9; // each flow >= 1MB
+    for (int merged_idx = 0; merged_idx < flow->GetNumMerged(); merged_idx++) {
+      double this_flow_size_Gbit =
+          ((double) flow->GetMergedSizeInBit(merged_idx) / 1e9);
+      if (min_flow_size_Gbit > this_flow_size_Gbit || min_flow_size_Gbit < 0) {
+        min_flow_size_Gbit = this_flow_size_Gbit;
+      }
+      if (max_flow_size_Gbit < this_flow_size_Gbit || max_flow_size_Gbit < 0) {
+        max_flow_size_Gbit = this_flow_size_Gbit;
+      }
     }
   }
 
@@ -126,12 +132,19 @@ void DbLogger::WriteOnFlowFinish(double finish_time, Flow* flow,
     has_fct_header_ = true;
     out << "job_id, flow_id, src, dst, flow_size_bit, tArr, tFin, fct" << endl;
   }
-  out << flow->GetParentCoflow()->GetJobId() << ','
-      << flow->GetFlowId() << ','
-      << flow->GetSrc() << ','
-      << flow->GetDest() << ','
-      << flow->GetSizeInBit() << ','
-      << flow->GetStartTime() << ','
-      << finish_time << ','
-      << fct << endl;
+  // one line per member of a flow group, and per flow merged, under the id of
+  // the flow.
+  for (int member_idx = 0; member_idx < flow->GetNumMembers(); member_idx++) {
+    for (int merged_idx = 0; merged_idx < flow->GetNumMerged();
+         merged_idx++) {
+      out << flow->GetParentCoflow()->GetJobId() << ','
+          << flow->GetFlowId() << ','
+          << flow->GetMemberSrc(member_idx) << ','
+          << flow->GetDest() << ','
+          << flow->GetMergedSizeInBit(merged_idx) << ','
+          << flow->GetStartTime() << ','
+          << finish_time << ','
+          << fct << endl;
+    }
+  }
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 
+#include <fstream>
 #include <iomanip>
 #include <map>
+#include <sstream>
 
 #include "events.h"
+#include "profiler.h"
 
 using namespace std;
 
@@ -24,8 +27,10 @@ ostream& operator<<(std::ostream& out, const EventType value) {
     INSERT_ELEMENT(APPLY_CIRCUIT);
     INSERT_ELEMENT(APPLY_NEW_SCHEDULE);
     INSERT_ELEMENT(SCHEDULE_END);
+    INSERT_ELEMENT(CAPACITY_CHANGE);
     INSERT_ELEMENT(MSG_TRAFFIC_FINISH);
     INSERT_ELEMENT(ALARM_SCHEDULER);
+    INSERT_ELEMENT(MSG_CAPACITY_CHANGE);
 #undef INSERT_ELEMENT
   }
   return out << strings[value];
@@ -260,8 +265,22 @@ Simulator::Run() {
     return;
   }
 
+  if (!CAPACITY_EVENT_FILE_NAME.empty()) {
+    LoadCapacityEvents(CAPACITY_EVENT_FILE_NAME);
+  }
+  if (!PORT_CAPACITY_FILE_NAME.empty()) {
+    LoadPortCapacity(PORT_CAPACITY_FILE_NAME);
+  }
+
+  if (LOG_COMP_STAT) {
+    Profiler::Get().Clear();
+  }
   m_trafficPtr->NotifySimStart();
 
+  if (NUM_SCHEDULER_THREADS > 1 && !worker_pool_) {
+    worker_pool_.reset(new WorkerPool(NUM_SCHEDULER_THREADS));
+  }
+
   while (!m_timeline.empty()) {
     // Step 1: peek for time of next event
     Event* nextEvent = PeekNext();
@@ -281,16 +300,15 @@ Simulator::Run() {
         break;
       case MSG_TRAFFIC_FINISH:DoNotifyTrafficFinish();
         break;
-      case ALARM_SCHEDULER: {
-        static_cast<EventNotifyScheduler*>(
-            nextEvent)->scheduler->SchedulerAlarmPortal(m_currentTime);
+      case ALARM_SCHEDULER:DoNotifySchedulers();
         // m_schedulerPtr->SchedulerAlarmPortal(m_currentTime);
-      }
         break;
       case MSG_ADD_FLOWS:DoNotifyAddFlows();
         break;
       case MSG_ADD_COFLOWS:DoNotifyAddCoflows();
         break;
+      case MSG_CAPACITY_CHANGE:DoNotifyCapacityChange();
+        break;
       default:break;
     }
 
@@ -305,6 +323,71 @@ Simulator::Run() {
   // end of simulation.
   m_trafficPtr->NotifySimEnd();
   m_schedulerPtr->NotifySimEnd();
+  if (LOG_COMP_STAT) {
+    Profiler::Get().Report(cout);
+    ofstream comptime_audit_file(COMPTIME_AUDIT_FILE_NAME);
+    if (!comptime_audit_file.is_open()) {
+      cerr << "[Simulator::Run] ERROR: unable to open file "
+           << COMPTIME_AUDIT_FILE_NAME << endl;
+      exit(-1);
+    }
+    Profiler::Get().Report(comptime_audit_file);
+  }
+}
+
+void
+Simulator::DoNotifySchedulers() {
+  Scheduler* scheduler = static_cast<EventNotifyScheduler*>(
+      PeekNext())->scheduler;
+  if (!worker_pool_ || !scheduler->SupportsConcurrentSchedule()) {
+    scheduler->SchedulerAlarmPortal(m_currentTime);
+    return;
+  }
+
+  // Take over alarms of other schedulers right behind, at the same time.
+  // These schedulers (children of HPNs) do not share any state, so each of
+  // them is equivalent to be woken up one after another.
+  vector<Event*> alarms_taken;
+  vector<Scheduler*> schedulers(1, scheduler);
+  for (vector<Event*>::iterator tlIt = m_timeline.begin() + 1;
+       tlIt != m_timeline.end();) {
+    if ((*tlIt)->GetEventType() != ALARM_SCHEDULER
+        || (*tlIt)->GetEventTime() != m_currentTime) {
+      break;
+    }
+    Scheduler* next_scheduler = static_cast<EventNotifyScheduler*>(
+        *tlIt)->scheduler;
+    if (!next_scheduler->SupportsConcurrentSchedule()) break;
+    schedulers.push_back(next_scheduler);
+    alarms_taken.push_back(*tlIt);
+    tlIt = m_timeline.erase(tlIt);
+  }
+  if (schedulers.size() == 1) {
+    scheduler->SchedulerAlarmPortal(m_currentTime);
+    return;
+  }
+
+  // 1. sequentially, process events up to rescheduling.
+  vector<Scheduler*> schedulers_to_schedule;
+  for (Scheduler* s : schedulers) {
+    if (s->AlarmPortalUntilSchedule(m_currentTime)) {
+      schedulers_to_schedule.push_back(s);
+    }
+  }
+  // 2. concurrently, compute rates.
+  worker_pool_->ParallelFor(
+      (int) schedulers_to_schedule.size(), [&schedulers_to_schedule](int i) {
+        schedulers_to_schedule[i]->PrecomputeSchedule();
+      });
+  // 3. sequentially, in the order of alarms, apply the new schedules and
+  // process the rest of the events.
+  for (Scheduler* s : schedulers_to_schedule) {
+    s->SchedulerAlarmPortal(m_currentTime);
+  }
+
+  for (Event* alarm : alarms_taken) {
+    delete alarm;
+  }
 }
 
 void
@@ -345,4 +428,68 @@ Simulator::DoNotifyAddCoflows() {
   }
   m_schedulerPtr->NotifyAddCoflows(m_currentTime, addCoflowsEvent->m_cfpVp);
 
-}
\ No newline at end of file
+}
+
+void
+Simulator::AddCapacityChange(double time, int net_idx, long link_rate_bps) {
+  AddEvent(new MsgEventCapacityChange(time, net_idx, link_rate_bps));
+}
+
+void
+Simulator::LoadCapacityEvents(const string& file_name) {
+  ifstream capacity_file(file_name);
+  if (!capacity_file.is_open()) {
+    cout << "Error: unable to open file " << file_name << endl;
+    cout << "Now terminate the program" << endl;
+    exit(-1);
+  }
+  string line;
+  while (getline(capacity_file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    double time;
+    int net_idx;
+    long link_rate_bps;
+    istringstream line_stream(line);
+    if (!(line_stream >> time >> net_idx >> link_rate_bps)) {
+      cerr << "[Simulator::LoadCapacityEvents] ERROR: invalid line \""
+           << line << "\" in " << file_name << endl;
+      exit(-1);
+    }
+    AddCapacityChange(time, net_idx, link_rate_bps);
+  }
+}
+
+void
+Simulator::LoadPortCapacity(const string& file_name) {
+  ifstream port_file(file_name);
+  if (!port_file.is_open()) {
+    cout << "Error: unable to open file " << file_name << endl;
+    cout << "Now terminate the program" << endl;
+    exit(-1);
+  }
+  string line;
+  while (getline(port_file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    int net_idx, port;
+    long src_port_bps, dst_port_bps;
+    istringstream line_stream(line);
+    if (!(line_stream >> net_idx >> port >> src_port_bps >> dst_port_bps)) {
+      cerr << "[Simulator::LoadPortCapacity] ERROR: invalid line \""
+           << line << "\" in " << file_name << endl;
+      exit(-1);
+    }
+    m_schedulerPtr->SetPortCapacity(net_idx, port, src_port_bps, dst_port_bps);
+  }
+}
+
+void
+Simulator::DoNotifyCapacityChange() {
+  MsgEventCapacityChange* event = (MsgEventCapacityChange*) PeekNext();
+  if (event->GetEventType() != MSG_CAPACITY_CHANGE) {
+    cout << "[Simulator::DoNotifyCapacityChange] error: "
+         << " the event type is not MSG_CAPACITY_CHANGE!" << endl;
+    return;
+  }
+  m_schedulerPtr->NotifyCapacityChange(m_currentTime, event->net_idx,
+                                       event->link_rate_bps);
+}
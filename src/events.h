@@ -10,12 +10,14 @@
 #ifndef EVENTS_H
 #define EVENTS_H
 
+#include <memory>
 #include <vector>
 #include <iostream>
 
 #include "global.h"
 #include "scheduler.h"
 #include "traffic_generator.h"
+#include "worker_pool.h"
 
 using namespace std;
 
@@ -62,6 +64,17 @@ class MsgEventAddCoflows : public Event {
   vector<Coflow *> *m_cfpVp; // pointer to the vector of coflow pointer
 };
 
+class MsgEventCapacityChange : public Event {
+ public:
+  MsgEventCapacityChange(double time, int net_idx, long link_rate_bps) :
+      Event(/*type*/ MSG_CAPACITY_CHANGE, time),
+      net_idx(net_idx), link_rate_bps(link_rate_bps) {};
+  ~MsgEventCapacityChange() {}
+  /* message body */
+  int net_idx;        // index of the network (child scheduler) in HPNs
+  long link_rate_bps; // new link rate of the network
+};
+
 // for scheduler
 class EventCoflowArrive : public Event {
  public:
@@ -81,6 +94,17 @@ class EventFlowArrive : public Event {
   ~EventFlowArrive() {}
 };
 
+class EventCapacityChange : public Event {
+ public:
+  EventCapacityChange(double time, long link_rate_bps, int net_idx = 0) :
+      Event(/*type*/ CAPACITY_CHANGE, time), link_rate_bps(link_rate_bps),
+      net_idx(net_idx) {};
+  ~EventCapacityChange() {}
+  /* message body */
+  long link_rate_bps;
+  int net_idx;
+};
+
 class MsgEventTrafficFinish : public Event {
  public:
   MsgEventTrafficFinish(/*EventType type,*/
@@ -161,6 +185,8 @@ class Simulator : public TimeLine {
   bool InstallScheduler(const std::string &schedulerName);
   bool InstallTrafficGen(std::string trafficProducerName, DbLogger *db_logger);
   void UpdateTrafficAlarm(Event *);
+  // Change the link rate of the net_idx-th network at the given time.
+  void AddCapacityChange(double time, int net_idx, long link_rate_bps);
   void Run();
   // Used for testing.
   double GetTotalCCT() { return m_trafficPtr->m_totalCCT; }
@@ -171,10 +197,19 @@ class Simulator : public TimeLine {
   TrafficGen *m_trafficPtr;
   double m_currentTime;
 
+  // Used to run schedulers woken up at the same time concurrently, if
+  // NUM_SCHEDULER_THREADS > 1.
+  unique_ptr<WorkerPool> worker_pool_;
+
   void DoNotifyAddFlows();
   void DoNotifyAddCoflows();
+  void DoNotifySchedulers();
 
   void DoNotifyTrafficFinish();
+
+  void LoadCapacityEvents(const string &file_name);
+  void LoadPortCapacity(const string &file_name);
+  void DoNotifyCapacityChange();
 };
 
 #endif /* EVENTS_H */
@@ -0,0 +1,47 @@
+//
+//  flow_size_matrix.h
+//  Ximulator
+//
+//  Bytes of the flow from each mapper to each reducer of a coflow, dense and
+//  row-major by mapper, i.e. in the order of (mapper_idx, reducer_idx). Every
+//  mapper of a trace coflow sends to every reducer, so a flat vector holds
+//  the sizes in one allocation, moved rather than copied into the coflow.
+//
+
+#ifndef FLOW_SIZE_MATRIX_H
+#define FLOW_SIZE_MATRIX_H
+
+#include <vector>
+
+using namespace std;
+
+class FlowSizeMatrix {
+ public:
+  FlowSizeMatrix() : num_map_(0), num_red_(0) {}
+  // all flows of 0 bytes.
+  FlowSizeMatrix(int num_map, int num_red)
+      : num_map_(num_map), num_red_(num_red),
+        bytes_((size_t) num_map * num_red, 0) {}
+
+  int GetNumMap() const { return num_map_; }
+  int GetNumRed() const { return num_red_; }
+  // number of flows, i.e. num_map * num_red.
+  size_t GetNumFlows() const { return bytes_.size(); }
+
+  long &At(int mapper_idx, int reducer_idx) {
+    return bytes_[(size_t) mapper_idx * num_red_ + reducer_idx];
+  }
+  long At(int mapper_idx, int reducer_idx) const {
+    return bytes_[(size_t) mapper_idx * num_red_ + reducer_idx];
+  }
+  // bytes of flow index mapper_idx * num_red + reducer_idx.
+  vector<long> &GetBytes() { return bytes_; }
+  const vector<long> &GetBytes() const { return bytes_; }
+
+ private:
+  int num_map_;
+  int num_red_;
+  vector<long> bytes_;
+};
+
+#endif //FLOW_SIZE_MATRIX_H
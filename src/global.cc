@@ -32,11 +32,20 @@ bool ENABLE_PERTURB_IN_PLAY = false;
 // all flows to the same reducer will be equally
 // distributed for all mappers.
 bool EQUAL_FLOW_TO_SAME_REDUCER = false;
+// if true, flows of a coflow into the same reducer of the same size are held
+// as one flow group, scheduled and transmitted as a unit. Only varysImpl
+// schedules flow groups.
+bool FLOW_GROUPS = false;
+// if true, flows of a coflow between the same pair of racks are merged into
+// one flow, which keeps the sizes of the flows merged for FCTs. Flow groups
+// are not merged.
+bool AGGREGATE_RACK_PAIRS = false;
 
 // used to initialized end time.
 double INVALID_TIME = -1.0;
 
-// if true, log down comp time stat.
+// if true, profile the phases of the schedulers and report them to
+// COMPTIME_AUDIT_FILE_NAME at the end of the simulation.
 bool LOG_COMP_STAT = false;
 
 // default num of racks used in tms to determine
@@ -46,11 +55,6 @@ int NUM_RACKS = 150;
 //  rack_number = circuit_number mod NUM_RACKS
 int NUM_LINK_PER_RACK = 1;
 
-// used by traffic generator.
-// which indicates max number of coflows supported per run.
-// used to initialized the random seed for each coflow.
-int PERTURB_SEED_NUM = 600;
-
 // all flow byte sizes are multiplied by TRAFFIC_SIZE_INFLATE.
 double TRAFFIC_SIZE_INFLATE = 1;
 
@@ -64,14 +68,54 @@ string MAC_BASE_DIR = "../../";
 string LINUX_BASE_DIR = "../";
 string BASE_DIR = IsOnApple() ? MAC_BASE_DIR : LINUX_BASE_DIR;
 
+// text or binary, see trace_reader.h.
 string TRAFFIC_TRACE_FILE_NAME = BASE_DIR + "trace/fbtrace-1hr.txt";
+// replay the trace from the first coflow arriving at or after
+// TRACE_START_MS, or from coflow TRACE_START_JOB_ID if >= 0, as if the trace
+// started there.
+double TRACE_START_MS = 0;
+int TRACE_START_JOB_ID = -1;
+// if > 0, a background thread parses the trace up to this many seconds of
+// trace time ahead of the replay.
+double TRACE_PREFETCH_WINDOW_SEC = 0;
+// if not empty, coflows of the trace are remapped onto NUM_RACKS racks and
+// replicated as "<random|locality|hash>_<copies>_<shift sec>_<seed>", see
+// trace_scaler.h.
+string TRACE_SCALE = "";
 
 string RESULTS_DIR = "results/";
 string CCT_AUDIT_FILE_NAME = BASE_DIR + RESULTS_DIR + "audit_cct.txt";
 string FCT_AUDIT_FILE_NAME = BASE_DIR + RESULTS_DIR + "audit_fct.txt";
 string COMPTIME_AUDIT_FILE_NAME = BASE_DIR + RESULTS_DIR + "audit_comp.txt";
 
+// optional. each line "time_in_sec net_idx link_rate_bps" changes the link
+// rate of the net_idx-th network (child scheduler) at the given time.
+string CAPACITY_EVENT_FILE_NAME = "";
+
+// optional. each line "net_idx port src_port_bps dst_port_bps" sets the
+// capacity of a port of the net_idx-th network at its initial link rate.
+// other ports run at the link rate of the network.
+string PORT_CAPACITY_FILE_NAME = "";
+
 bool ZERO_COMP_TIME = true;
+// computation time model of schedulers, used unless ZERO_COMP_TIME:
+// "measured" or "cost[_B_C_F_P]", see comp_time_model.h.
+string COMP_TIME_MODEL_NAME = "measured";
+
+// number of threads to run rate control of the children schedulers in HPNs
+// concurrently, when several of them reschedule at the same time. The infocom
+// scheduler uses them to evaluate coflows concurrently.
+// 1 runs all schedulers sequentially.
+int NUM_SCHEDULER_THREADS = 1;
+// number of threads to build coflows of upcoming arrivals of the trace
+// concurrently, ahead of their arrival. 1 builds one coflow at a time.
+int NUM_TRAFFIC_THREADS = 1;
+// LP backend of the infocom solver: "simplex" (built-in) or "gurobi". Empty
+// uses Gurobi if Ximulator is built with Gurobi, otherwise simplex.
+string LP_SOLVER_NAME = "";
+// if true, flows of the infocom scheduler keep their network once they get
+// rates, and only new coflows are routed.
+bool INFOCOM_STICKY_ROUTING = false;
 // for aalo.
 int AALO_Q_NUM = 10;
 double AALO_INIT_Q_HEIGHT = 10.0 * 1000000; // 10MB
@@ -26,6 +26,8 @@ extern bool ENABLE_LEAK_CHECK;
 extern bool LEAK_CHECK_EXIT;
 extern bool ENABLE_PERTURB_IN_PLAY;
 extern bool EQUAL_FLOW_TO_SAME_REDUCER;
+extern bool FLOW_GROUPS;
+extern bool AGGREGATE_RACK_PAIRS;
 
 extern double INVALID_TIME;
 
@@ -34,14 +36,24 @@ extern bool LOG_COMP_STAT;
 extern int NUM_RACKS;
 extern int NUM_LINK_PER_RACK;
 
-extern int PERTURB_SEED_NUM;
-
 extern string TRAFFIC_TRACE_FILE_NAME;
+extern double TRACE_START_MS;
+extern int TRACE_START_JOB_ID;
+extern double TRACE_PREFETCH_WINDOW_SEC;
+extern string TRACE_SCALE;
 extern string CCT_AUDIT_FILE_NAME;
 extern string FCT_AUDIT_FILE_NAME;
 extern string COMPTIME_AUDIT_FILE_NAME;
+extern string CAPACITY_EVENT_FILE_NAME;
+extern string PORT_CAPACITY_FILE_NAME;
 
 extern bool ZERO_COMP_TIME;
+extern string COMP_TIME_MODEL_NAME;
+
+extern int NUM_SCHEDULER_THREADS;
+extern int NUM_TRAFFIC_THREADS;
+extern string LP_SOLVER_NAME;
+extern bool INFOCOM_STICKY_ROUTING;
 
 extern double TRAFFIC_SIZE_INFLATE;
 extern double TRAFFIC_ARRIVAL_SPEEDUP;
@@ -71,11 +83,13 @@ typedef enum Event_Type {
   APPLY_CIRCUIT,
   APPLY_NEW_SCHEDULE,
   SCHEDULE_END,
+  CAPACITY_CHANGE,
   MSG_ADD_FLOWS,          /*for Simulator */
   MSG_ADD_COFLOWS,
   ALARM_TRAFFIC,
   MSG_TRAFFIC_FINISH,
   ALARM_SCHEDULER,
+  MSG_CAPACITY_CHANGE,
 } EventType;
 
 extern const int FLOAT_TIME_WIDTH;
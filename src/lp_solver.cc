@@ -0,0 +1,41 @@
+//
+// Factory of LP backends.
+//
+
+#include <cfloat>
+#include <cstdlib>
+#include <iostream>
+
+#include "lp_solver.h"
+
+const double LpSolver::INFINITY_BOUND = DBL_MAX;
+
+#ifdef XIMULATOR_WITH_GUROBI
+// defined in lp_solver_gurobi.cc
+LpSolver* CreateGurobiLpSolver(int debug_level);
+#endif
+
+bool LpSolver::HasGurobi() {
+#ifdef XIMULATOR_WITH_GUROBI
+  return true;
+#else
+  return false;
+#endif
+}
+
+LpSolver* LpSolver::Create(const string& name, int debug_level) {
+  if (name == "simplex" || (name.empty() && !HasGurobi())) {
+    return new SimplexLpSolver(debug_level);
+  }
+  if (name == "gurobi" || name.empty()) {
+#ifdef XIMULATOR_WITH_GUROBI
+    return CreateGurobiLpSolver(debug_level);
+#else
+    cerr << "[LpSolver::Create] ERROR: Ximulator is built without Gurobi"
+         << endl;
+    exit(-1);
+#endif
+  }
+  cerr << "[LpSolver::Create] ERROR: unknown LP solver " << name << endl;
+  exit(-1);
+}
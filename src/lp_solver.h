@@ -0,0 +1,158 @@
+//
+// Linear programs used by the solvers, e.g. SolverInfocom. A LP is built by
+// adding continuous variables and linear constraints, then optimized by one
+// of the backends:
+// - "simplex": the built-in dense two-phase simplex, always available.
+// - "gurobi" : Gurobi, available if Ximulator is built with Gurobi.
+// Variables (columns) may be added and right-hand sides changed after
+// Optimize(), and the next Optimize() starts from the last optimal basis, e.g.
+// for column generation or for a LP reused on new residual bandwidth. So may
+// objective coefficients, e.g. for a second objective on the optimal face.
+//
+
+#ifndef XIMULATOR_LP_SOLVER_H
+#define XIMULATOR_LP_SOLVER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class LpSolver {
+ public:
+  enum Status {
+    LP_OPTIMAL,
+    LP_INFEASIBLE,
+    LP_UNBOUNDED,
+    LP_ERROR,
+  };
+
+  enum Sense {
+    LP_LESS_EQUAL,
+    LP_GREATER_EQUAL,
+    LP_EQUAL,
+  };
+
+  // Create a solver of the backend given by name, or of the default backend
+  // (Gurobi if available, otherwise simplex) if name is empty.
+  // Caller owns the solver.
+  static LpSolver* Create(const string& name, int debug_level = 0);
+  static bool HasGurobi();
+
+  // bound of a variable without lower or upper bound.
+  static const double INFINITY_BOUND;
+
+  virtual ~LpSolver() {}
+
+  // Add a continuous variable lb <= x <= ub with coefficient obj in the
+  // objective. Returns the index of the variable.
+  virtual int AddVar(double lb, double ub, double obj, const string& name) = 0;
+  // Same as above, with coefficients in existing constraints given by
+  // (constr, coef) pairs.
+  virtual int AddVar(double lb, double ub, double obj, const string& name,
+                     const vector<pair<int, double>>& column) = 0;
+  // Add a constraint sum(coef * x[var]) (sense) rhs, with terms of
+  // (var, coef) pairs. Returns the index of the constraint.
+  virtual int AddConstr(const vector<pair<int, double>>& terms, Sense sense,
+                        double rhs, const string& name) = 0;
+  virtual void SetRhs(int constr, double rhs) = 0;
+  virtual void SetObj(int var, double obj) = 0;
+  virtual void SetMaximize(bool maximize) = 0;
+
+  virtual Status Optimize() = 0;
+  // Valid only if Optimize() returns LP_OPTIMAL.
+  virtual double GetValue(int var) = 0;
+  virtual double GetObjValue() = 0;
+  // Dual value of a constraint, such that the reduced cost of a variable is
+  // obj - sum(coef * dual) over its column.
+  virtual double GetDual(int constr) = 0;
+  virtual string GetVarName(int var) = 0;
+  // false if the model is kept dense, whose size grows with the product of
+  // the number of rows and columns.
+  virtual bool IsSparse() = 0;
+};
+
+// Dense two-phase simplex on a tableau, with Bland's rule on degenerate
+// pivots to avoid cycling. Good enough for LPs up to a few thousand rows.
+class SimplexLpSolver : public LpSolver {
+ public:
+  SimplexLpSolver(int debug_level = 0);
+  virtual ~SimplexLpSolver() {}
+
+  virtual int AddVar(double lb, double ub, double obj, const string& name);
+  virtual int AddVar(double lb, double ub, double obj, const string& name,
+                     const vector<pair<int, double>>& column);
+  virtual int AddConstr(const vector<pair<int, double>>& terms, Sense sense,
+                        double rhs, const string& name);
+  virtual void SetRhs(int constr, double rhs);
+  virtual void SetObj(int var, double obj);
+  virtual void SetMaximize(bool maximize);
+
+  virtual Status Optimize();
+  virtual double GetValue(int var) { return values_[var]; }
+  virtual double GetObjValue() { return obj_value_; }
+  virtual double GetDual(int constr);
+  virtual string GetVarName(int var) { return var_names_[var]; }
+  virtual bool IsSparse() { return false; }
+
+ private:
+  struct Row {
+    vector<pair<int, double>> terms;
+    Sense sense;
+    double rhs;
+  };
+
+  // Build the tableau from scratch and find a feasible basis (phase 1).
+  // Returns LP_OPTIMAL if found.
+  Status Build();
+  // Append columns of the variables added since the last Optimize(), keeping
+  // the current basis.
+  void AppendNewColumns();
+  // Update the right-hand side column to the rhs of the rows changed since
+  // the last Optimize(), keeping the current basis. Returns false if the
+  // basis is no longer valid, e.g. on a redundant row.
+  bool UpdateRhs();
+  // Set the cost row to the objective (phase 2) over the current basis.
+  void SetPhase2Cost();
+  // Pivot the tableau on (row, col), making col basic in row.
+  void Pivot(int row, int col);
+  // Minimize the cost row over the current basis, only entering columns
+  // marked in enterable_. Returns LP_OPTIMAL, LP_UNBOUNDED or LP_ERROR.
+  Status Minimize();
+  // Dual simplex: pivot until the right-hand sides are non-negative, e.g.
+  // after UpdateRhs(). Returns LP_OPTIMAL, LP_INFEASIBLE or LP_ERROR.
+  Status DualMinimize();
+
+  const int debug_level_;
+  bool maximize_;
+  vector<double> lb_, ub_, obj_;
+  vector<string> var_names_;
+  vector<Row> rows_;
+
+  // The tableau is valid for the first num_built_vars_ variables and all
+  // rows, if built_.
+  bool built_;
+  int num_built_vars_;
+  // tableau of num_rows_ constraint rows and one cost row at the bottom.
+  // The last column is the right-hand side.
+  int num_rows_, num_cols_;
+  vector<vector<double>> tableau_;
+  vector<int> basis_;
+  // column of each variable.
+  vector<int> var_cols_;
+  // columns allowed to enter the basis, i.e. not artificial.
+  vector<bool> enterable_;
+  // rows are negated (-1) to keep the right-hand sides non-negative. The
+  // column of row i in the initial identity basis is identity_cols_[i].
+  vector<int> row_signs_, identity_cols_;
+  // rhs of rows_ in the tableau.
+  vector<double> built_rhs_;
+
+  vector<double> values_;
+  double obj_value_;
+
+  static const double EPSILON_;
+};
+
+#endif //XIMULATOR_LP_SOLVER_H
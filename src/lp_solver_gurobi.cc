@@ -0,0 +1,191 @@
+//
+// LP backend on Gurobi. Only built if Gurobi is found.
+//
+
+#include <iostream>
+#include <memory>
+
+#include "gurobi_c++.h"
+#include "lp_solver.h"
+
+class GurobiLpSolver : public LpSolver {
+ public:
+  GurobiLpSolver(int debug_level)
+      : failed_(false), pending_update_(false), num_constrs_(0) {
+    try {
+      model_.reset(new GRBModel(*GetEnv()));
+      if (debug_level == 0) {
+        model_->getEnv().set(GRB_IntParam_OutputFlag, 0); // Gurobi output
+      }
+    } catch (GRBException e) {
+      OnError(e);
+    }
+  }
+  virtual ~GurobiLpSolver() {}
+
+  virtual int AddVar(double lb, double ub, double obj, const string& name) {
+    return AddVar(lb, ub, obj, name, vector<pair<int, double>>());
+  }
+
+  virtual int AddVar(double lb, double ub, double obj, const string& name,
+                     const vector<pair<int, double>>& column) {
+    var_names_.push_back(name);
+    if (failed_) return (int) var_names_.size() - 1;
+    try {
+      UpdateIfNeeded();
+      GRBColumn grb_column;
+      for (const auto& constr_coef : column) {
+        grb_column.addTerm(constr_coef.second, constrs_[constr_coef.first]);
+      }
+      vars_.push_back(model_->addVar(ToGurobiBound(lb), ToGurobiBound(ub),
+                                     obj, GRB_CONTINUOUS, grb_column, name));
+      pending_update_ = true;
+    } catch (GRBException e) {
+      OnError(e);
+    }
+    return (int) var_names_.size() - 1;
+  }
+
+  virtual int AddConstr(const vector<pair<int, double>>& terms, Sense sense,
+                        double rhs, const string& name) {
+    num_constrs_++;
+    if (failed_) return num_constrs_ - 1;
+    try {
+      UpdateIfNeeded();
+      GRBLinExpr expr;
+      for (const auto& var_coef : terms) {
+        expr += var_coef.second * vars_[var_coef.first];
+      }
+      char grb_sense = sense == LP_LESS_EQUAL ? GRB_LESS_EQUAL :
+                       sense == LP_GREATER_EQUAL ? GRB_GREATER_EQUAL
+                                                 : GRB_EQUAL;
+      constrs_.push_back(model_->addConstr(expr, grb_sense, rhs, name));
+      pending_update_ = true;
+    } catch (GRBException e) {
+      OnError(e);
+    }
+    return num_constrs_ - 1;
+  }
+
+  virtual void SetRhs(int constr, double rhs) {
+    if (failed_) return;
+    try {
+      UpdateIfNeeded();
+      constrs_[constr].set(GRB_DoubleAttr_RHS, rhs);
+      pending_update_ = true;
+    } catch (GRBException e) {
+      OnError(e);
+    }
+  }
+
+  virtual void SetObj(int var, double obj) {
+    if (failed_) return;
+    try {
+      UpdateIfNeeded();
+      vars_[var].set(GRB_DoubleAttr_Obj, obj);
+      pending_update_ = true;
+    } catch (GRBException e) {
+      OnError(e);
+    }
+  }
+
+  virtual void SetMaximize(bool maximize) {
+    if (failed_) return;
+    try {
+      model_->set(GRB_IntAttr_ModelSense,
+                  maximize ? GRB_MAXIMIZE : GRB_MINIMIZE);
+    } catch (GRBException e) {
+      OnError(e);
+    }
+  }
+
+  virtual Status Optimize() {
+    if (failed_) return LP_ERROR;
+    try {
+      model_->optimize();
+      int status = model_->get(GRB_IntAttr_Status);
+      if (status == GRB_OPTIMAL) return LP_OPTIMAL;
+      if (status == GRB_UNBOUNDED) return LP_UNBOUNDED;
+      if (status == GRB_INFEASIBLE || status == GRB_INF_OR_UNBD) {
+        return LP_INFEASIBLE;
+      }
+    } catch (GRBException e) {
+      OnError(e);
+    } catch (...) {
+      cerr << "Exception during optimization" << endl;
+    }
+    return LP_ERROR;
+  }
+
+  virtual double GetValue(int var) {
+    if (failed_) return 0;
+    try {
+      return vars_[var].get(GRB_DoubleAttr_X);
+    } catch (GRBException e) {
+      OnError(e);
+    }
+    return 0;
+  }
+  virtual double GetObjValue() {
+    if (failed_) return 0;
+    try {
+      return model_->get(GRB_DoubleAttr_ObjVal);
+    } catch (GRBException e) {
+      OnError(e);
+    }
+    return 0;
+  }
+  virtual double GetDual(int constr) {
+    if (failed_) return 0;
+    try {
+      return constrs_[constr].get(GRB_DoubleAttr_Pi);
+    } catch (GRBException e) {
+      OnError(e);
+    }
+    return 0;
+  }
+  virtual string GetVarName(int var) { return var_names_[var]; }
+  virtual bool IsSparse() { return true; }
+
+ private:
+  // The environment is started once per thread and shared by the models of
+  // the thread, as starting it is much slower than solving the small LPs of
+  // the solvers. Models copy the environment, so parameters of a model stay
+  // with the model.
+  static GRBEnv* GetEnv() {
+    static thread_local unique_ptr<GRBEnv> env(new GRBEnv());
+    return env.get();
+  }
+
+  // Integrate new variables and constraints before referring to them.
+  void UpdateIfNeeded() {
+    if (pending_update_) {
+      model_->update();
+      pending_update_ = false;
+    }
+  }
+
+  void OnError(GRBException& e) {
+    cerr << "Gurobi Error: " << e.getMessage() << endl;
+    failed_ = true;
+  }
+
+  static double ToGurobiBound(double bound) {
+    if (bound >= INFINITY_BOUND) return GRB_INFINITY;
+    if (bound <= -INFINITY_BOUND) return -GRB_INFINITY;
+    return bound;
+  }
+
+  // Once failed, e.g. without a license, Optimize() returns LP_ERROR.
+  bool failed_;
+  bool pending_update_;
+  unique_ptr<GRBModel> model_;
+  vector<GRBVar> vars_;
+  vector<GRBConstr> constrs_;
+  vector<string> var_names_;
+  int num_constrs_;
+};
+
+LpSolver* CreateGurobiLpSolver(int debug_level) {
+  return new GurobiLpSolver(debug_level);
+}
@@ -0,0 +1,412 @@
+//
+// Built-in LP backend: dense two-phase simplex on a tableau.
+//
+
+#include <algorithm> // max
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#include "lp_solver.h"
+
+const double SimplexLpSolver::EPSILON_ = 1e-9;
+
+SimplexLpSolver::SimplexLpSolver(int debug_level)
+    : debug_level_(debug_level), maximize_(false), built_(false),
+      num_built_vars_(0), num_rows_(0), num_cols_(0), obj_value_(0) {}
+
+int SimplexLpSolver::AddVar(double lb, double ub, double obj,
+                            const string& name) {
+  return AddVar(lb, ub, obj, name, vector<pair<int, double>>());
+}
+
+int SimplexLpSolver::AddVar(double lb, double ub, double obj,
+                            const string& name,
+                            const vector<pair<int, double>>& column) {
+  int var = (int) lb_.size();
+  lb_.push_back(lb);
+  ub_.push_back(ub);
+  obj_.push_back(obj);
+  var_names_.push_back(name);
+  for (const auto& constr_coef : column) {
+    rows_[constr_coef.first].terms.push_back(
+        std::make_pair(var, constr_coef.second));
+  }
+  if (lb != 0 || ub < INFINITY_BOUND) {
+    // bounds change the rows of the tableau.
+    built_ = false;
+  }
+  return var;
+}
+
+int SimplexLpSolver::AddConstr(const vector<pair<int, double>>& terms,
+                               Sense sense, double rhs, const string& name) {
+  rows_.push_back(Row{terms, sense, rhs});
+  built_ = false;
+  return (int) rows_.size() - 1;
+}
+
+void SimplexLpSolver::SetRhs(int constr, double rhs) {
+  rows_[constr].rhs = rhs;
+}
+
+void SimplexLpSolver::SetObj(int var, double obj) {
+  // the cost row is set from obj_ by every Optimize().
+  obj_[var] = obj;
+}
+
+void SimplexLpSolver::SetMaximize(bool maximize) {
+  maximize_ = maximize;
+}
+
+double SimplexLpSolver::GetDual(int constr) {
+  // the cost row holds -(dual) under the identity columns, for the
+  // minimization of the (negated if maximize_) objective on normalized rows.
+  double dual = -tableau_[num_rows_][identity_cols_[constr]]
+      * row_signs_[constr];
+  return maximize_ ? -dual : dual;
+}
+
+LpSolver::Status SimplexLpSolver::Optimize() {
+  if (built_) {
+    AppendNewColumns();
+    if (!UpdateRhs()) built_ = false;
+  }
+  if (!built_) {
+    Status status = Build();
+    if (status != LP_OPTIMAL) return status;
+  }
+
+  // phase 2: optimize the objective, as a minimization. Right-hand sides may
+  // be negative if changed since the last basis.
+  SetPhase2Cost();
+  Status status = DualMinimize();
+  if (status == LP_ERROR) {
+    // start over from scratch, where right-hand sides are non-negative.
+    status = Build();
+    if (status != LP_OPTIMAL) return status;
+    SetPhase2Cost();
+  }
+  if (status == LP_OPTIMAL) {
+    status = Minimize();
+  }
+  if (status != LP_OPTIMAL) return status;
+
+  int num_vars = (int) lb_.size();
+  values_.assign(lb_.begin(), lb_.end());
+  vector<int> col_vars(num_cols_, -1);
+  for (int var = 0; var < num_vars; var++) {
+    col_vars[var_cols_[var]] = var;
+  }
+  for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+    int var = col_vars[basis_[row_idx]];
+    if (var >= 0) {
+      values_[var] += tableau_[row_idx][num_cols_];
+    }
+  }
+  obj_value_ = 0;
+  for (int var = 0; var < num_vars; var++) {
+    obj_value_ += obj_[var] * values_[var];
+  }
+  return LP_OPTIMAL;
+}
+
+LpSolver::Status SimplexLpSolver::Build() {
+  int num_vars = (int) lb_.size();
+
+  // substitute x = lb + y, so that all variables y >= 0, and bound y from
+  // above by extra rows.
+  vector<Row> rows;
+  for (const Row& row : rows_) {
+    Row shifted = row;
+    for (const auto& var_coef : row.terms) {
+      if (lb_[var_coef.first] <= -INFINITY_BOUND) {
+        cerr << "[SimplexLpSolver::Build] ERROR: free variable "
+             << var_names_[var_coef.first] << " is not supported" << endl;
+        return LP_ERROR;
+      }
+      shifted.rhs -= var_coef.second * lb_[var_coef.first];
+    }
+    rows.push_back(shifted);
+  }
+  for (int var = 0; var < num_vars; var++) {
+    if (ub_[var] < INFINITY_BOUND) {
+      rows.push_back(Row{{std::make_pair(var, 1.0)}, LP_LESS_EQUAL,
+                         ub_[var] - lb_[var]});
+    }
+  }
+  // keep the right-hand sides non-negative.
+  num_rows_ = (int) rows.size();
+  row_signs_.assign(num_rows_, 1);
+  for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+    Row& row = rows[row_idx];
+    if (row.rhs >= 0) continue;
+    for (auto& var_coef : row.terms) var_coef.second = -var_coef.second;
+    row.rhs = -row.rhs;
+    if (row.sense == LP_LESS_EQUAL) {
+      row.sense = LP_GREATER_EQUAL;
+    } else if (row.sense == LP_GREATER_EQUAL) {
+      row.sense = LP_LESS_EQUAL;
+    }
+    row_signs_[row_idx] = -1;
+  }
+
+  // columns: variables, then slack/surplus, then artificial variables.
+  int num_slacks = 0, num_artificials = 0;
+  for (const Row& row : rows) {
+    if (row.sense != LP_EQUAL) num_slacks++;
+    if (row.sense != LP_LESS_EQUAL) num_artificials++;
+  }
+  int slack_start = num_vars;
+  int artificial_start = slack_start + num_slacks;
+  num_cols_ = artificial_start + num_artificials;
+  tableau_.assign(num_rows_ + 1, vector<double>(num_cols_ + 1, 0.0));
+  basis_.assign(num_rows_, -1);
+  identity_cols_.assign(num_rows_, -1);
+  enterable_.assign(num_cols_, true);
+  var_cols_.resize(num_vars);
+  for (int var = 0; var < num_vars; var++) {
+    var_cols_[var] = var;
+  }
+  vector<double>& cost = tableau_[num_rows_];
+
+  int slack = slack_start, artificial = artificial_start;
+  for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+    const Row& row = rows[row_idx];
+    vector<double>& tableau_row = tableau_[row_idx];
+    for (const auto& var_coef : row.terms) {
+      tableau_row[var_coef.first] += var_coef.second;
+    }
+    tableau_row[num_cols_] = row.rhs;
+    if (row.sense == LP_LESS_EQUAL) {
+      tableau_row[slack] = 1;
+      identity_cols_[row_idx] = slack;
+      basis_[row_idx] = slack++;
+      continue;
+    }
+    if (row.sense == LP_GREATER_EQUAL) {
+      tableau_row[slack++] = -1;
+    }
+    tableau_row[artificial] = 1;
+    identity_cols_[row_idx] = artificial;
+    basis_[row_idx] = artificial++;
+    // phase 1 minimizes the sum of artificial variables.
+    for (int col = 0; col <= num_cols_; col++) {
+      cost[col] -= tableau_row[col];
+    }
+    cost[basis_[row_idx]] = 0;
+  }
+
+  // phase 1: look for a feasible basis.
+  if (num_artificials > 0) {
+    Status status = Minimize();
+    if (status == LP_ERROR) return status;
+    double infeasibility = -cost[num_cols_];
+    if (infeasibility > 1e-7) {
+      if (debug_level_ >= 3) {
+        cout << "[SimplexLpSolver::Build] infeasible by "
+             << infeasibility << endl;
+      }
+      return LP_INFEASIBLE;
+    }
+    // drive artificial variables (at zero) out of the basis where possible.
+    // Rows left with an artificial variable are redundant.
+    for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+      if (basis_[row_idx] < artificial_start) continue;
+      for (int col = 0; col < artificial_start; col++) {
+        if (fabs(tableau_[row_idx][col]) > EPSILON_) {
+          Pivot(row_idx, col);
+          break;
+        }
+      }
+    }
+    for (int col = artificial_start; col < num_cols_; col++) {
+      enterable_[col] = false;
+    }
+  }
+  built_ = true;
+  num_built_vars_ = num_vars;
+  built_rhs_.resize(rows_.size());
+  for (int row_idx = 0; row_idx < (int) rows_.size(); row_idx++) {
+    built_rhs_[row_idx] = rows_[row_idx].rhs;
+  }
+  return LP_OPTIMAL;
+}
+
+void SimplexLpSolver::AppendNewColumns() {
+  int num_vars = (int) lb_.size();
+  if (num_built_vars_ == num_vars) return;
+  // columns of the new variables on the rows.
+  vector<vector<double>> columns(num_vars - num_built_vars_,
+                                 vector<double>(num_rows_, 0.0));
+  for (int row_idx = 0; row_idx < (int) rows_.size(); row_idx++) {
+    for (const auto& var_coef : rows_[row_idx].terms) {
+      if (var_coef.first < num_built_vars_) continue;
+      columns[var_coef.first - num_built_vars_][row_idx] +=
+          var_coef.second * row_signs_[row_idx];
+    }
+  }
+  // The identity columns hold the inverse of the basis, so the new column
+  // in the tableau is the combination of them.
+  for (int var = num_built_vars_; var < num_vars; var++) {
+    const vector<double>& column = columns[var - num_built_vars_];
+    vector<double> tableau_column(num_rows_ + 1, 0.0);
+    for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+      if (column[row_idx] == 0) continue;
+      int identity_col = identity_cols_[row_idx];
+      for (int r = 0; r <= num_rows_; r++) {
+        tableau_column[r] += column[row_idx] * tableau_[r][identity_col];
+      }
+    }
+    for (int r = 0; r <= num_rows_; r++) {
+      tableau_[r].insert(tableau_[r].end() - 1, tableau_column[r]);
+    }
+    var_cols_.push_back(num_cols_++);
+    enterable_.push_back(true);
+  }
+  num_built_vars_ = num_vars;
+}
+
+bool SimplexLpSolver::UpdateRhs() {
+  // As in AppendNewColumns(), the change of the right-hand side in the
+  // tableau is the combination of the identity columns.
+  for (int row_idx = 0; row_idx < (int) rows_.size(); row_idx++) {
+    double delta = rows_[row_idx].rhs - built_rhs_[row_idx];
+    if (delta == 0) continue;
+    built_rhs_[row_idx] = rows_[row_idx].rhs;
+    delta *= row_signs_[row_idx];
+    int identity_col = identity_cols_[row_idx];
+    for (int r = 0; r < num_rows_; r++) {
+      tableau_[r][num_cols_] += delta * tableau_[r][identity_col];
+    }
+  }
+  // artificial variables left in the basis must stay at zero.
+  for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+    if (!enterable_[basis_[row_idx]]
+        && fabs(tableau_[row_idx][num_cols_]) > EPSILON_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SimplexLpSolver::SetPhase2Cost() {
+  vector<double>& cost = tableau_[num_rows_];
+  std::fill(cost.begin(), cost.end(), 0.0);
+  for (int var = 0; var < (int) obj_.size(); var++) {
+    cost[var_cols_[var]] = maximize_ ? -obj_[var] : obj_[var];
+  }
+  for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+    int basic = basis_[row_idx];
+    double basic_cost = cost[basic];
+    if (basic_cost == 0) continue;
+    const vector<double>& tableau_row = tableau_[row_idx];
+    for (int col = 0; col <= num_cols_; col++) {
+      cost[col] -= basic_cost * tableau_row[col];
+    }
+    cost[basic] = 0;
+  }
+}
+
+LpSolver::Status SimplexLpSolver::Minimize() {
+  // Use the most negative reduced cost, unless stalled on degenerate pivots,
+  // where we fall back to Bland's rule which never cycles.
+  const int MAX_DEGENERATE_PIVOTS = 50;
+  long max_iterations = 50L * (num_rows_ + num_cols_) + 1000;
+  vector<double>& cost = tableau_[num_rows_];
+  int num_degenerate = 0;
+  for (long iteration = 0; iteration < max_iterations; iteration++) {
+    bool bland = num_degenerate >= MAX_DEGENERATE_PIVOTS;
+    int enter_col = -1;
+    for (int col = 0; col < num_cols_; col++) {
+      if (cost[col] >= -EPSILON_ || !enterable_[col]) continue;
+      if (enter_col < 0 || cost[col] < cost[enter_col]) {
+        enter_col = col;
+        if (bland) break;
+      }
+    }
+    if (enter_col < 0) return LP_OPTIMAL;
+
+    int leave_row = -1;
+    double min_ratio = DBL_MAX;
+    for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+      double coef = tableau_[row_idx][enter_col];
+      if (coef <= EPSILON_) continue;
+      double ratio = tableau_[row_idx][num_cols_] / coef;
+      if (leave_row < 0 || ratio < min_ratio - EPSILON_
+          || (ratio < min_ratio + EPSILON_
+              && basis_[row_idx] < basis_[leave_row])) {
+        leave_row = row_idx;
+        min_ratio = ratio;
+      }
+    }
+    if (leave_row < 0) return LP_UNBOUNDED;
+
+    num_degenerate = min_ratio <= EPSILON_ ? num_degenerate + 1 : 0;
+    Pivot(leave_row, enter_col);
+  }
+  cerr << "[SimplexLpSolver::Minimize] ERROR: no optimum after "
+       << max_iterations << " iterations" << endl;
+  return LP_ERROR;
+}
+
+LpSolver::Status SimplexLpSolver::DualMinimize() {
+  // Leave on the most negative right-hand side, and enter on the least ratio
+  // of the reduced cost, breaking ties by the lowest column.
+  long max_iterations = 50L * (num_rows_ + num_cols_) + 1000;
+  const vector<double>& cost = tableau_[num_rows_];
+  for (long iteration = 0; iteration < max_iterations; iteration++) {
+    int leave_row = -1;
+    for (int row_idx = 0; row_idx < num_rows_; row_idx++) {
+      double rhs = tableau_[row_idx][num_cols_];
+      if (rhs >= -EPSILON_) continue;
+      if (leave_row < 0 || rhs < tableau_[leave_row][num_cols_]) {
+        leave_row = row_idx;
+      }
+    }
+    if (leave_row < 0) return LP_OPTIMAL;
+
+    int enter_col = -1;
+    double min_ratio = DBL_MAX;
+    for (int col = 0; col < num_cols_; col++) {
+      double coef = tableau_[leave_row][col];
+      if (coef >= -EPSILON_ || !enterable_[col]) continue;
+      double ratio = max(cost[col], 0.0) / -coef;
+      if (enter_col < 0 || ratio < min_ratio - EPSILON_) {
+        enter_col = col;
+        min_ratio = ratio;
+      }
+    }
+    // the row sums non-negative terms to a negative value.
+    if (enter_col < 0) return LP_INFEASIBLE;
+
+    Pivot(leave_row, enter_col);
+  }
+  cerr << "[SimplexLpSolver::DualMinimize] ERROR: no feasible basis after "
+       << max_iterations << " iterations" << endl;
+  return LP_ERROR;
+}
+
+void SimplexLpSolver::Pivot(int row, int col) {
+  vector<double>& pivot_row = tableau_[row];
+  double pivot = pivot_row[col];
+  vector<int> nonzero_cols;
+  for (int c = 0; c <= num_cols_; c++) {
+    if (pivot_row[c] == 0) continue;
+    pivot_row[c] /= pivot;
+    nonzero_cols.push_back(c);
+  }
+  pivot_row[col] = 1;
+  for (int r = 0; r <= num_rows_; r++) {
+    if (r == row) continue;
+    vector<double>& tableau_row = tableau_[r];
+    double factor = tableau_row[col];
+    if (factor == 0) continue;
+    for (int c : nonzero_cols) {
+      tableau_row[c] -= factor * pivot_row[c];
+      if (fabs(tableau_row[c]) < 1e-12) tableau_row[c] = 0;
+    }
+    tableau_row[col] = 0;
+  }
+  basis_[row] = col;
+}
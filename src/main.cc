@@ -33,6 +33,9 @@ int main(int argc, const char* argv[]) {
   // 1. {weaver, prandom, infocom}_Nnet_{varys, aalo}_ratioA_ratioB, or
   // 2. {weaver, prandom, infocom}_ratioAscheduler_ratioBscheduler, where
   // `scheduler` is the name of BA and can be {varys, aalo}
+  // Each child may be followed by its computation time model, {measured,
+  // cost}, instead of -compmodel, e.g. weaver_20varys_cost_80aalo_measured
+  // or weaver_2net_varys_20_cost_80.
 
   // For `infocom`, the BA names of {varys, aalo} have no actual effects as
   // Repier would manage bandwidth allocation.
@@ -71,15 +74,55 @@ int main(int argc, const char* argv[]) {
         trafficProducerName = string(argv[i + 1]);
       } else if (strFlag == "-ftrace") {
         TRAFFIC_TRACE_FILE_NAME = string(argv[i + 1]);
+      } else if (strFlag == "-tracestart") {
+        string content(argv[i + 1]);
+        TRACE_START_MS = stod(content);
+      } else if (strFlag == "-tracestartjob") {
+        string content(argv[i + 1]);
+        TRACE_START_JOB_ID = stoi(content);
+      } else if (strFlag == "-racks") {
+        string content(argv[i + 1]);
+        NUM_RACKS = stoi(content);
+      } else if (strFlag == "-scaletrace") {
+        TRACE_SCALE = string(argv[i + 1]);
+      } else if (strFlag == "-flowgroups") {
+        string content(argv[i + 1]);
+        FLOW_GROUPS = (ToLower(content) == "true");
+      } else if (strFlag == "-aggregate") {
+        string content(argv[i + 1]);
+        AGGREGATE_RACK_PAIRS = (ToLower(content) == "true");
+      } else if (strFlag == "-prefetch") {
+        string content(argv[i + 1]);
+        TRACE_PREFETCH_WINDOW_SEC = stod(content);
       } else if (strFlag == "-cctaudit") {
         CCT_AUDIT_FILE_NAME = string(argv[i + 1]);
       } else if (strFlag == "-fctaudit") {
         FCT_AUDIT_FILE_NAME = string(argv[i + 1]);
       } else if (strFlag == "-compaudit") {
         COMPTIME_AUDIT_FILE_NAME = string(argv[i + 1]);
+      } else if (strFlag == "-fcapacity") {
+        CAPACITY_EVENT_FILE_NAME = string(argv[i + 1]);
+      } else if (strFlag == "-fport") {
+        PORT_CAPACITY_FILE_NAME = string(argv[i + 1]);
       } else if (strFlag == "-zc") {
         string content(argv[i + 1]);
         ZERO_COMP_TIME = (ToLower(content) == "true");
+      } else if (strFlag == "-compstat") {
+        string content(argv[i + 1]);
+        LOG_COMP_STAT = (ToLower(content) == "true");
+      } else if (strFlag == "-compmodel") {
+        COMP_TIME_MODEL_NAME = string(argv[i + 1]);
+      } else if (strFlag == "-threads") {
+        string content(argv[i + 1]);
+        NUM_SCHEDULER_THREADS = stoi(content);
+      } else if (strFlag == "-trafficthreads") {
+        string content(argv[i + 1]);
+        NUM_TRAFFIC_THREADS = stoi(content);
+      } else if (strFlag == "-lp") {
+        LP_SOLVER_NAME = string(argv[i + 1]);
+      } else if (strFlag == "-sticky") {
+        string content(argv[i + 1]);
+        INFOCOM_STICKY_ROUTING = (ToLower(content) == "true");
       } else {
         cout << "invalid arguments " << strFlag << " \n";
         exit(0);
@@ -114,11 +157,17 @@ int main(int argc, const char* argv[]) {
   cout << "REMOTE_IN_OUT_PORTS = " << std::boolalpha << REMOTE_IN_OUT_PORTS
        << endl;
   cout << "ZERO_COMP_TIME = " << std::boolalpha << ZERO_COMP_TIME << endl;
+  cout << "COMP_TIME_MODEL_NAME = " << COMP_TIME_MODEL_NAME << endl;
+  cout << "NUM_SCHEDULER_THREADS = " << NUM_SCHEDULER_THREADS << endl;
+  cout << "NUM_TRAFFIC_THREADS = " << NUM_TRAFFIC_THREADS << endl;
   cout << "NUM_RACKS = " << NUM_RACKS << " * "
        << "NUM_LINK_PER_RACK = " << NUM_LINK_PER_RACK << endl;
   cout << " *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  * \n";
   cout << "ENABLE_PERTURB_IN_PLAY = " << std::boolalpha
        << ENABLE_PERTURB_IN_PLAY << endl;
+  cout << "FLOW_GROUPS = " << std::boolalpha << FLOW_GROUPS << endl;
+  cout << "AGGREGATE_RACK_PAIRS = " << std::boolalpha << AGGREGATE_RACK_PAIRS
+       << endl;
   cout << "LOG_COMP_STAT = " << std::boolalpha << LOG_COMP_STAT << endl;
   cout << " *  *  " << endl;
   cout << " *  *  " << endl;
@@ -126,6 +175,10 @@ int main(int argc, const char* argv[]) {
   if (file_name_cutoff < 0) file_name_cutoff = 0;
   cout << "TRAFFIC_TRACE_FILE_NAME = "
        << TRAFFIC_TRACE_FILE_NAME.substr(file_name_cutoff) << endl;
+  cout << "TRACE_START_MS = " << TRACE_START_MS << endl;
+  cout << "TRACE_START_JOB_ID = " << TRACE_START_JOB_ID << endl;
+  cout << "TRACE_PREFETCH_WINDOW_SEC = " << TRACE_PREFETCH_WINDOW_SEC << endl;
+  cout << "TRACE_SCALE = " << TRACE_SCALE << endl;
 
   cout << " *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  * \n";
   cout << " *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  *  * \n";
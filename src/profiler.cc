@@ -0,0 +1,130 @@
+//
+//  profiler.cc
+//  Ximulator
+//
+
+#include <cmath>
+#include <iomanip>
+
+#include "global.h"
+#include "profiler.h"
+
+namespace {
+// path of the innermost running timer of each thread.
+thread_local string current_path;
+}
+
+Profiler& Profiler::Get() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::Histogram::Add(double seconds) {
+  count++;
+  total_seconds += seconds;
+  if (seconds > max_seconds) max_seconds = seconds;
+  double ns = seconds * 1e9;
+  int idx = ns < 1 ? 0 : 1 + (int) floor(4 * log2(ns));
+  if (idx >= buckets.size()) buckets.resize(idx + 1, 0);
+  buckets[idx]++;
+}
+
+double Profiler::Histogram::Quantile(double q) const {
+  long rank = (long) ceil(q * count);
+  if (rank < 1) rank = 1;
+  long seen = 0;
+  for (int idx = 0; idx < buckets.size(); idx++) {
+    seen += buckets[idx];
+    if (seen >= rank) {
+      double upper_seconds = pow(2.0, idx / 4.0) / 1e9;
+      return upper_seconds < max_seconds ? upper_seconds : max_seconds;
+    }
+  }
+  return max_seconds;
+}
+
+void Profiler::Record(const string& path, double seconds) {
+  lock_guard<mutex> lock(mtx_);
+  histograms_[path].Add(seconds);
+}
+
+void Profiler::Clear() {
+  lock_guard<mutex> lock(mtx_);
+  histograms_.clear();
+}
+
+void Profiler::Report(ostream& out) {
+  lock_guard<mutex> lock(mtx_);
+  ios_base::fmtflags flags = out.flags();
+  streamsize precision = out.precision();
+  out << "[Profiler] " << histograms_.size() << " phases" << endl;
+  out << "path" << '\t' << "count" << '\t' << "total(s)" << '\t'
+      << "p50(s)" << '\t' << "p99(s)" << '\t' << "max(s)" << endl;
+  for (const auto& path_histogram : histograms_) {
+    const Histogram& histogram = path_histogram.second;
+    out << path_histogram.first << '\t'
+        << histogram.count << '\t'
+        << scientific << setprecision(3)
+        << histogram.total_seconds << '\t'
+        << histogram.Quantile(0.5) << '\t'
+        << histogram.Quantile(0.99) << '\t'
+        << histogram.max_seconds << endl;
+    out.flags(flags);
+  }
+  out.precision(precision);
+}
+
+long Profiler::GetCount(const string& path) {
+  lock_guard<mutex> lock(mtx_);
+  auto it = histograms_.find(path);
+  return it == histograms_.end() ? 0 : it->second.count;
+}
+
+double Profiler::GetTotalSeconds(const string& path) {
+  lock_guard<mutex> lock(mtx_);
+  auto it = histograms_.find(path);
+  return it == histograms_.end() ? 0 : it->second.total_seconds;
+}
+
+double Profiler::GetQuantileSeconds(const string& path, double q) {
+  lock_guard<mutex> lock(mtx_);
+  auto it = histograms_.find(path);
+  return it == histograms_.end() ? 0 : it->second.Quantile(q);
+}
+
+vector<string> Profiler::GetPaths() {
+  lock_guard<mutex> lock(mtx_);
+  vector<string> paths;
+  for (const auto& path_histogram : histograms_) {
+    paths.push_back(path_histogram.first);
+  }
+  return paths;
+}
+
+// static
+string Profiler::CurrentPath() {
+  return current_path;
+}
+
+ScopedTimer::ScopedTimer(const string& phase) : enabled_(LOG_COMP_STAT) {
+  if (enabled_) Start(current_path, phase);
+}
+
+ScopedTimer::ScopedTimer(const string& parent_path, const string& phase)
+    : enabled_(LOG_COMP_STAT) {
+  if (enabled_) Start(parent_path, phase);
+}
+
+void ScopedTimer::Start(const string& parent_path, const string& phase) {
+  outer_path_ = current_path;
+  current_path = parent_path.empty() ? phase : parent_path + "/" + phase;
+  start_time_ = chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer() {
+  if (!enabled_) return;
+  chrono::duration<double> seconds =
+      chrono::steady_clock::now() - start_time_;
+  Profiler::Get().Record(current_path, seconds.count());
+  current_path = outer_path_;
+}
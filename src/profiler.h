@@ -0,0 +1,82 @@
+//
+//  profiler.h
+//  Ximulator
+//
+//  Wall time of the phases of the schedulers, e.g. sort, rate control, work
+//  conservation, weaver split, LP build and LP solve, recorded by scoped
+//  timers on a monotonic clock if LOG_COMP_STAT. Timers nest: a phase is
+//  recorded under the path of the enclosing timers of the same thread, e.g.
+//  "3varys1000Mbps/rate_control/sort", where the root is the name of a
+//  scheduler instance. Each path keeps a log-bucketed histogram, reported by
+//  the simulator at the end of the simulation.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Profiler {
+ public:
+  static Profiler& Get();
+
+  // thread safe.
+  void Record(const string& path, double seconds);
+  void Clear();
+  // one line per path: count, total, p50, p99 and max in seconds.
+  void Report(ostream& out);
+
+  long GetCount(const string& path);
+  double GetTotalSeconds(const string& path);
+  // upper bound of the bucket of the q-quantile, capped at the max.
+  double GetQuantileSeconds(const string& path, double q);
+  vector<string> GetPaths();
+
+  // path of the innermost running timer of the calling thread, to pass to
+  // tasks run on other threads, e.g. on the WorkerPool.
+  static string CurrentPath();
+
+ private:
+  // buckets of a quarter octave, i.e. bucket i > 0 counts times of
+  // [2^((i-1)/4), 2^(i/4)) ns, and bucket 0 counts times below 1 ns.
+  struct Histogram {
+    long count = 0;
+    double total_seconds = 0;
+    double max_seconds = 0;
+    vector<long> buckets;
+
+    void Add(double seconds);
+    double Quantile(double q) const;
+  };
+
+  mutex mtx_;
+  // ordered, so that phases follow their parents in the report.
+  map<string, Histogram> histograms_;
+};
+
+// Record the time from construction to destruction under the path of the
+// enclosing timer of the thread, or under parent_path. A no-op unless
+// LOG_COMP_STAT.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const string& phase);
+  // e.g. ScopedTimer("", name_) at the root of a scheduler.
+  ScopedTimer(const string& parent_path, const string& phase);
+  ~ScopedTimer();
+
+ private:
+  void Start(const string& parent_path, const string& phase);
+
+  bool enabled_;
+  string outer_path_;
+  chrono::steady_clock::time_point start_time_;
+};
+
+#endif //PROFILER_H
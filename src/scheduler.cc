@@ -26,9 +26,11 @@ using namespace std;
 ///////////////////////////////////////////////////////
 int Scheduler::instance_count_ = 0;
 const double Scheduler::INVALID_RATE_ = DBL_MAX;
+const int Scheduler::MAX_DEFERRED_SYNCS_ = 32;
 
 Scheduler::Scheduler(long scheduler_link_rate) :
-    SCHEDULER_LINK_RATE_BPS_(scheduler_link_rate) {
+    SCHEDULER_LINK_RATE_BPS_(scheduler_link_rate),
+    INIT_LINK_RATE_BPS_(scheduler_link_rate) {
 
   instance_count_++;
 
@@ -40,6 +42,9 @@ Scheduler::Scheduler(long scheduler_link_rate) :
 
   m_nextElecRate = map<long, long>();
   m_nextOptcRate = map<long, long>();
+
+  lazy_sync_horizon_ = 0;
+  lazy_sync_horizon_valid_ = false;
 }
 
 Scheduler::~Scheduler() {
@@ -89,6 +94,8 @@ bool Scheduler::Transmit(double startTime, double endTime,
                          bool basic, bool local, bool salvage) {
   // cout << "[Scheduler::Transmit] TX " << startTime << "->" << endTime << endl;
 
+  lazy_sync_horizon_valid_ = false;
+
   bool hasCoflowFinish = false;
   bool hasFlowFinish = false;
   bool hasFakeCoflowFinish = false;
@@ -126,18 +133,31 @@ bool Scheduler::Transmit(double startTime, double endTime,
         flow->TxSalvage();
       }
       // ********* end tx ********************
-      validate_tx_src_bits[flow->GetSrc()] += validate_tx_this_flow_bits;
-      validate_tx_dst_bits[flow->GetDest()] += validate_tx_this_flow_bits;
+      // each member of a flow group sends as much on its own src.
+      int num_members = flow->GetNumMembers();
+      for (int member_idx = 0; member_idx < num_members; member_idx++) {
+        int src = flow->GetMemberSrc(member_idx);
+        validate_tx_src_bits[src] += validate_tx_this_flow_bits;
+        if (validate_tx_this_flow_bits > 0) validate_src_flow_num[src]++;
+      }
+      validate_tx_dst_bits[flow->GetDest()] +=
+          validate_tx_this_flow_bits * num_members;
       if (validate_tx_this_flow_bits > 0) {
-        validate_src_flow_num[flow->GetSrc()]++;
-        validate_dst_flow_num[flow->GetDest()]++;
+        validate_dst_flow_num[flow->GetDest()] += num_members;
       }
 
       if (flow->GetBitsLeft() == 0) {
         hasFlowFinish = true;
-        (*cfIt)->NumFlowFinishInc();
+        bool parent_flow_done = (*cfIt)->NumFlowFinishInc(flow);
         flow->SetEndTime(endTime);
-        finished_flows.push_back(flow);
+        if (!flow->IsSubFlow()) {
+          finished_flows.push_back(flow);
+        } else if (parent_flow_done) {
+          // only report the parent flow once its last sub-flow is done, as
+          // sub-flows are deleted together with the child coflow.
+          flow->GetParentFlow()->SetEndTime(endTime);
+          finished_flows.push_back(flow->GetParentFlow());
+        }
 
         // debug for coflow progress
         if (DEBUG_LEVEL >= 4) {
@@ -148,7 +168,7 @@ bool Scheduler::Transmit(double startTime, double endTime,
       }
 
       // update coflow account on bytes sent.
-      (*cfIt)->AddTxBit(validate_tx_this_flow_bits);
+      (*cfIt)->AddTxBit(validate_tx_this_flow_bits * num_members);
     }
 
     if ((*cfIt)->IsComplete()) {
@@ -197,10 +217,8 @@ bool Scheduler::Transmit(double startTime, double endTime,
   // Therefore we allow a larger slack for tx constraint check, based on the
   // number of  concurrent flows at a port . In optical net, the number of
   // concurrent flows are less. So a smaller slack is sufficient.
-  long bound =
-      10 + SCHEDULER_LINK_RATE_BPS_ * NUM_LINK_PER_RACK * (endTime - startTime);
   if (!ValidateLastTxMeetConstraints(
-      bound, validate_tx_src_bits, validate_tx_dst_bits,
+      endTime - startTime, validate_tx_src_bits, validate_tx_dst_bits,
       validate_src_flow_num, validate_dst_flow_num)) {
     cerr << startTime << "  Warming: Fail to meet tx bound!!!" <<
          endl;
@@ -323,6 +341,74 @@ Scheduler::NotifyAddCoflows(double alarmTime, vector<Coflow *> *cfVecPtr) {
   UpdateAlarm();
 }
 
+void
+Scheduler::NotifyCapacityChange(double time, int net_idx,
+                                long link_rate_bps) {
+  if (net_idx != 0) {
+    cerr << "[Scheduler::NotifyCapacityChange] ERROR: " << name_
+         << " has no network #" << net_idx << endl;
+    return;
+  }
+  m_myTimeLine->AddEvent(new EventCapacityChange(time, link_rate_bps));
+  UpdateAlarm();
+}
+
+void
+Scheduler::SetPortCapacity(int net_idx, int port,
+                           long src_port_bps, long dst_port_bps) {
+  if (net_idx != 0) {
+    cerr << "[Scheduler::SetPortCapacity] ERROR: " << name_
+         << " has no network #" << net_idx << endl;
+    return;
+  }
+  if (port < 0) {
+    cerr << "[Scheduler::SetPortCapacity] ERROR: invalid port " << port
+         << endl;
+    exit(-1);
+  }
+  if (port >= init_src_port_bps_.size()) {
+    init_src_port_bps_.resize(port + 1, INIT_LINK_RATE_BPS_);
+    init_dst_port_bps_.resize(port + 1, INIT_LINK_RATE_BPS_);
+  }
+  init_src_port_bps_[port] = src_port_bps;
+  init_dst_port_bps_[port] = dst_port_bps;
+  ScalePortCapacity();
+}
+
+void
+Scheduler::ScalePortCapacity() {
+  double scale = INIT_LINK_RATE_BPS_ > 0 ?
+                 SCHEDULER_LINK_RATE_BPS_ / (double) INIT_LINK_RATE_BPS_ : 0.0;
+  src_port_bps_.resize(init_src_port_bps_.size());
+  dst_port_bps_.resize(init_dst_port_bps_.size());
+  for (int port = 0; port < init_src_port_bps_.size(); port++) {
+    src_port_bps_[port] = (long) (init_src_port_bps_[port] * scale);
+    dst_port_bps_[port] = (long) (init_dst_port_bps_[port] * scale);
+  }
+}
+
+void
+Scheduler::SetLinkRate(long link_rate_bps) {
+  long old_link_rate_bps = SCHEDULER_LINK_RATE_BPS_;
+  SCHEDULER_LINK_RATE_BPS_ = link_rate_bps;
+  // all ports change at the same ratio.
+  ScalePortCapacity();
+  lazy_sync_horizon_valid_ = false;
+  double scale = old_link_rate_bps > 0 ?
+                 link_rate_bps / (double) old_link_rate_bps : 0.0;
+  if (scale >= 1.0) {
+    // current rates remain feasible; wait for the reschedule.
+    return;
+  }
+  for (Coflow *coflow : m_coflowPtrVector) {
+    for (Flow *flow : *coflow->GetFlows()) {
+      if (flow->GetBitsLeft() <= 0) continue;
+      flow->SetRate((long) (flow->GetElecRate() * scale),
+                    (long) (flow->GetOptcRate() * scale));
+    }
+  }
+}
+
 double
 Scheduler::SecureFinishTime(long bits, long rate) {
   if (rate == 0) {
@@ -367,6 +453,7 @@ Scheduler::Print(void) {
 // and reflect the rate on flow record.
 void
 Scheduler::SetFlowRate() {
+  lazy_sync_horizon_valid_ = false;
   for (vector<Coflow *>::iterator cfIt = m_coflowPtrVector.begin();
        cfIt != m_coflowPtrVector.end(); cfIt++) {
     vector<Flow *> *flowVecPtr = (*cfIt)->GetFlows();
@@ -381,11 +468,71 @@ Scheduler::SetFlowRate() {
   }
 }
 
+bool Scheduler::DeferSyncTo(double alarm_time) {
+  if (deferred_sync_times_.size() >= MAX_DEFERRED_SYNCS_) {
+    return false;
+  }
+  if (!lazy_sync_horizon_valid_) {
+    // the horizon is only known for flow states at m_currentTime.
+    if (!deferred_sync_times_.empty()) return false;
+    lazy_sync_horizon_ = CalcLazySyncHorizon();
+    lazy_sync_horizon_valid_ = true;
+  }
+  if (alarm_time >= lazy_sync_horizon_) {
+    return false;
+  }
+  deferred_sync_times_.push_back(alarm_time);
+  return true;
+}
+
+void Scheduler::CatchUpDeferredSync() {
+  lazy_sync_horizon_valid_ = false;
+  if (deferred_sync_times_.empty()) return;
+
+  for (Coflow *coflow : m_coflowPtrVector) {
+    for (Flow *flow : *coflow->GetFlows()) {
+      if (flow->GetBitsLeft() <= 0) {
+        // such flow has finished
+        continue;
+      }
+      long tx_bits = flow->TransmitDeferred(m_currentTime,
+                                            deferred_sync_times_);
+      if (tx_bits < 0) {
+        cerr << "[Scheduler::CatchUpDeferredSync] ERROR: "
+             << flow->toString() << " would finish before "
+             << deferred_sync_times_.back() << endl;
+        exit(-1);
+      }
+      coflow->AddTxBit(tx_bits * flow->GetNumMembers());
+    }
+  }
+  m_currentTime = deferred_sync_times_.back();
+  deferred_sync_times_.clear();
+}
+
+double Scheduler::CalcLazySyncHorizon() {
+  // each deferred transmission may round up by one bit, so keep a margin.
+  const long margin_bits = 2 * (MAX_DEFERRED_SYNCS_ + 1);
+  double horizon = DBL_MAX;
+  for (Coflow *coflow : m_coflowPtrVector) {
+    for (Flow *flow : *coflow->GetFlows()) {
+      long bps = flow->isThruOptic() ? flow->GetOptcRate()
+                                     : flow->GetElecRate();
+      if (flow->GetBitsLeft() <= 0 || bps <= 0) continue;
+      horizon = min(horizon, m_currentTime
+          + (flow->GetBitsLeft() - margin_bits) / (double) bps);
+    }
+  }
+  return horizon;
+}
+
 bool Scheduler::ValidateLastTxMeetConstraints(
-    long port_bound_bits,
+    double tx_seconds,
     const map<int, long> &src_tx_bits, const map<int, long> &dst_tx_bits,
     const map<int, int> &src_flow_num, const map<int, int> &dst_flow_num) {
   for (const auto &src_kv_pair : src_tx_bits) {
+    long port_bound_bits = 10 + GetSrcPortBps(src_kv_pair.first)
+        * NUM_LINK_PER_RACK * tx_seconds;
     long buget = port_bound_bits
         + FindWithDef(src_flow_num, src_kv_pair.first, 0);
     if (src_kv_pair.second > buget) {
@@ -401,6 +548,8 @@ bool Scheduler::ValidateLastTxMeetConstraints(
   }
 
   for (const auto &dst_kv_pair : dst_tx_bits) {
+    long port_bound_bits = 10 + GetDstPortBps(dst_kv_pair.first)
+        * NUM_LINK_PER_RACK * tx_seconds;
     long buget = port_bound_bits
         + FindWithDef(dst_flow_num, dst_kv_pair.first, 0);
     if (dst_kv_pair.second > buget) {
@@ -19,18 +19,23 @@
 #include <vector>
 
 #include "coflow.h"
+#include "comp_time_model.h"
 #include "db_logger.h"
+#include "worker_pool.h"
 
 extern long DEFAULT_LINK_RATE_BPS;
 extern long ELEC_BPS;
+extern int DEBUG_LEVEL;
+extern string COMP_TIME_MODEL_NAME;
+extern bool FLOW_GROUPS;
 
 using namespace std;
 
 class Flow;
 class Coflow;
-class CompTimeBreakdown;
 class Simulator;
 class SchedulerTimeLine;
+class MinCCTCache;
 
 class Scheduler {
  public:
@@ -38,13 +43,53 @@ class Scheduler {
   virtual ~Scheduler();
   virtual void InstallSimulator(Simulator* simPtr) { m_simPtr = simPtr; }
   virtual void SchedulerAlarmPortal(double) = 0;
-  void NotifySimEnd();
+  virtual void NotifySimEnd();
 
   virtual void NotifyAddCoflows(double, vector<Coflow*>*);
   virtual void NotifyAddFlows(double);
 
+  // Used by the simulator to reschedule several schedulers woken up at the
+  // same time concurrently. Only schedulers whose rate control touches
+  // nothing but their own coflows shall support it.
+  virtual bool SupportsConcurrentSchedule() { return false; }
+  // Process events up to alarm_time as SchedulerAlarmPortal(), but stop right
+  // before rescheduling and return true. SchedulerAlarmPortal() shall be
+  // called later to resume.
+  virtual bool AlarmPortalUntilSchedule(double alarm_time) { return false; }
+  // Compute rates for the upcoming reschedule. Thread-safe among schedulers.
+  virtual void PrecomputeSchedule() {}
+
+  // Change the link rate of the net_idx-th network at time. A simple
+  // scheduler only manages network 0.
+  virtual void NotifyCapacityChange(double time, int net_idx,
+                                    long link_rate_bps);
+
+  // Set the capacity of a src and dst port of the net_idx-th network, when
+  // the network runs at its initial link rate. A simple scheduler only
+  // manages network 0.
+  virtual void SetPortCapacity(int net_idx, int port,
+                               long src_port_bps, long dst_port_bps);
+  // Capacity of each port. Ports without a specific capacity run at
+  // SCHEDULER_LINK_RATE_BPS_.
+  long GetSrcPortBps(int port) {
+    return port < src_port_bps_.size() ? src_port_bps_[port]
+                                       : SCHEDULER_LINK_RATE_BPS_;
+  }
+  long GetDstPortBps(int port) {
+    return port < dst_port_bps_.size() ? dst_port_bps_[port]
+                                       : SCHEDULER_LINK_RATE_BPS_;
+  }
+  // Capacity of each port if the network ran at link_rate_bps instead.
+  long GetSrcPortBps(int port, long link_rate_bps) {
+    return ScalePortBps(GetSrcPortBps(port), link_rate_bps);
+  }
+  long GetDstPortBps(int port, long link_rate_bps) {
+    return ScalePortBps(GetDstPortBps(port), link_rate_bps);
+  }
+
   std::string name_;
-  const long SCHEDULER_LINK_RATE_BPS_;
+  // may be changed at run time by capacity change events.
+  long SCHEDULER_LINK_RATE_BPS_;
 
   static const double INVALID_RATE_;
 
@@ -73,13 +118,16 @@ class Scheduler {
   virtual void CoflowFinishCallBack(double finishtime) = 0;
   virtual void FlowFinishCallBack(double finishTime) = 0;
 
-  bool ValidateLastTxMeetConstraints(long port_bound_bits,
+  bool ValidateLastTxMeetConstraints(double tx_seconds,
                                      const map<int, long>& src_tx_bits,
                                      const map<int, long>& dst_tx_bits,
                                      const map<int, int>& src_flow_num,
                                      const map<int, int>& dst_flow_num);
 
   void SetFlowRate();
+  // Apply the new link rate. Rates of all flows are scaled down (or up)
+  // proportionally, so that they stay feasible until the next schedule.
+  void SetLinkRate(long link_rate_bps);
 
   virtual void UpdateAlarm();
   void UpdateRescheduleEvent(double reScheduleTime);
@@ -88,10 +136,42 @@ class Scheduler {
   double SecureFinishTime(long bits, long rate);
   double CalcTime2FirstFlowEnd();
   void Print(void);
+
+  // Lazy synchronization with the hybrid (parent) scheduler. Instead of
+  // transmitting a child to every alarm time of the parent, the parent only
+  // records the alarm times as long as no flow of the child may finish by
+  // then, and the child replays them once it is woken up itself.
+  // Returns false if the child has to be transmitted to alarm_time now.
+  bool DeferSyncTo(double alarm_time);
+  // Bring flows up to date with all deferred alarm times, with the same
+  // transmission as if the child were transmitted at each alarm time.
+  void CatchUpDeferredSync();
  private:
+  // Port capacities at the current link rate, indexed by port, and those
+  // at the initial link rate. Empty if all ports run at the link rate.
+  vector<long> src_port_bps_, dst_port_bps_;
+  vector<long> init_src_port_bps_, init_dst_port_bps_;
+  const long INIT_LINK_RATE_BPS_;
+  void ScalePortCapacity();
+  long ScalePortBps(long port_bps, long link_rate_bps) {
+    if (link_rate_bps == SCHEDULER_LINK_RATE_BPS_) return port_bps;
+    if (SCHEDULER_LINK_RATE_BPS_ <= 0) return 0;
+    return (long) (port_bps * (link_rate_bps
+        / (double) SCHEDULER_LINK_RATE_BPS_));
+  }
+
+  // Alarm times from the parent not transmitted yet, in ascending order.
+  vector<double> deferred_sync_times_;
+  // No flow may finish before this time under the current rates, even with
+  // rounding from MAX_DEFERRED_SYNCS_ deferred transmissions.
+  double lazy_sync_horizon_;
+  bool lazy_sync_horizon_valid_;
+  static const int MAX_DEFERRED_SYNCS_;
+  double CalcLazySyncHorizon();
 
   friend class SchedulerHybrid;
   friend class SchedulerWeaver;
+  friend class SchedulerInfocom;
 };
 
 class SchedulerHybrid : public Scheduler {
@@ -100,6 +180,10 @@ class SchedulerHybrid : public Scheduler {
   virtual ~SchedulerHybrid() {}
   virtual void SchedulerAlarmPortal(double alarm_time);
   virtual void InstallSimulator(Simulator* simulator);
+  virtual void NotifyCapacityChange(double time, int net_idx,
+                                    long link_rate_bps);
+  virtual void SetPortCapacity(int net_idx, int port,
+                               long src_port_bps, long dst_port_bps);
 
   virtual void CoflowFinishCallBack(double finish_time);
   virtual void FlowFinishCallBack(double finish_time);
@@ -157,10 +241,13 @@ class SchedulerWeaver : public SchedulerSplit {
     NON_CRITICAL_RANDOM,
   } NonCriticalMode;
 
+  // If split_flow, a critical flow may be split into sub-flows across
+  // networks when doing so reduces the projected CCT of its coflow.
   SchedulerWeaver(
       vector<Scheduler*>& schedulers,
       FlowOrderMode flow_order_mode = FlowOrderMode::FLOW_SIZE_LARGE_FIRST,
-      NonCriticalMode non_critical_mode = NonCriticalMode::NON_CRITICAL_RATIO_LB
+      NonCriticalMode non_critical_mode = NonCriticalMode::NON_CRITICAL_RATIO_LB,
+      bool split_flow = false
   );
   virtual ~SchedulerWeaver() {}
   static SchedulerWeaver* Factory(
@@ -179,11 +266,35 @@ class SchedulerWeaver : public SchedulerSplit {
   void SortAndRangeShuffle(Coflow* parent,
                            vector<Flow*>* sorted_flows,
                            Comparator compare);
+
+  // Load profile of one scheduler (network) when assigning a coflow's flows.
+  // max_*_sum_sec is the max time to drain the load of a port at its capacity.
+  typedef struct Scheduler_Profile {
+    Scheduler_Profile() : max_src_sum_sec(0), max_dst_sum_sec(0) {}
+    map<int, double> src_sum_bit, dst_sum_bit;
+    double max_src_sum_sec, max_dst_sum_sec;
+    vector<Flow*> assigned_flows; // to be added
+  } Profile;
+  // add bits of flow to the load on the flow's ports in profile.
+  void AddBitsToProfile(Scheduler* scheduler, Flow* flow, long bits,
+                        Profile* profile);
+
+  // Split-flow mode: water-fill flow's bits over schedulers on the flow's
+  // src/dst ports. If the projected CCT of the coflow is less than
+  // single_path_cct, create sub-flows, add them to the profiles and return
+  // true; otherwise leave everything untouched and return false.
+  bool SplitFlowIfBetter(Flow* flow, double single_path_cct,
+                         const vector<Scheduler*>& schedulers,
+                         map<Scheduler*, Profile>* scheduler_profile);
   int debug_level_;
 
+  // sub-flows are no smaller than 1MB, the same as the smallest flow.
+  static const long MIN_SUB_FLOW_BITS_;
+
  private:
   FlowOrderMode flow_order_mode_;
   NonCriticalMode non_critical_mode_;
+  bool split_flow_;
 
   friend class SolverTest_Weaver_ManyCoflow_Test;
   friend class SolverTest_Weaver_Example_Test;
@@ -209,23 +320,53 @@ class SchedulerWeightedRandom : public SchedulerWeaver {
 
 class SchedulerVarys : public Scheduler {
  public:
-  SchedulerVarys(long scheduler_link_rate_bps = ELEC_BPS)
-      : Scheduler(scheduler_link_rate_bps) {
+  // no computation time model if comp_time_model_name is empty.
+  SchedulerVarys(long scheduler_link_rate_bps = ELEC_BPS,
+                 const string& comp_time_model_name = COMP_TIME_MODEL_NAME)
+      : Scheduler(scheduler_link_rate_bps),
+        has_precomputed_rates_(false), precomputed_comp_seconds_(0),
+        comp_time_model_(comp_time_model_name.empty() ? nullptr :
+                         CompTimeModel::Create(comp_time_model_name)) {
     name_ = to_string(instance_count_) + "varys"
         + to_string(int(SCHEDULER_LINK_RATE_BPS_ / 1e6)) + "Mbps";
   }
   virtual ~SchedulerVarys();
   void SchedulerAlarmPortal(double currentTime);
+  CompTimeModel* GetCompTimeModel() { return comp_time_model_.get(); }
+
+  // rate control debug strings would interleave if run concurrently.
+  virtual bool SupportsConcurrentSchedule() { return DEBUG_LEVEL < 5; }
+  virtual bool AlarmPortalUntilSchedule(double alarmTime);
+  virtual void PrecomputeSchedule();
  protected:
   // override by Varys-Deadline.
   virtual void CoflowArrive();
 
+  // Rates for the next Schedule(), either precomputed or computed now.
+  // Returns the computation time in seconds.
+  double TakeOrComputeRates();
+  // Called around the rate control in ComputeRates(). EndRateControl()
+  // returns the computation time in seconds given by the model.
+  void StartRateControl() { comp_time_model_->Start(); }
+  double EndRateControl();
+
  private:
   virtual void Schedule(void) = 0;
+  // Rate control part of Schedule(), which computes m_nextElecRate (and
+  // m_nextOptcRate). Returns the computation time in seconds.
+  virtual double ComputeRates() { return 0; }
+  bool has_precomputed_rates_;
+  double precomputed_comp_seconds_;
+  unique_ptr<CompTimeModel> comp_time_model_;
+
+  // returns true if stopped right before a RESCHEDULE event.
+  bool ProcessEvents(double alarmTime, bool stop_before_schedule);
   // override by Aalo.
   virtual void AddCoflows(vector<Coflow*>* cfVecPtr);
 
   void ApplyNewSchedule(void);
+  // override by Infocom.
+  virtual void CapacityChange(void);
   void AddFlows();
   void FlowArrive();
   void FlowFinishCallBack(double finishTime);
@@ -234,21 +375,42 @@ class SchedulerVarys : public Scheduler {
 
 class SchedulerInfocom : public SchedulerVarys {
  public:
-  SchedulerInfocom(vector<Scheduler*> schedulers)
-      : SchedulerVarys(), schedulers_(schedulers) {}
-  virtual ~SchedulerInfocom() { for (Scheduler* s:schedulers_) delete s; }
+  // routes are solved exactly, or within a factor of (1 - approx_epsilon)
+  // by SolverInfocom's approximate solver if approx_epsilon > 0.
+  SchedulerInfocom(vector<Scheduler*> schedulers, double approx_epsilon = 0);
+  virtual ~SchedulerInfocom();
+  // report the MinCCT cache.
+  virtual void NotifySimEnd();
+  virtual void SetPortCapacity(int net_idx, int port,
+                               long src_port_bps, long dst_port_bps);
+  virtual void NotifyCapacityChange(double time, int net_idx,
+                                    long link_rate_bps);
+  // Coflows are evaluated concurrently on worker_pool_ instead.
+  virtual bool SupportsConcurrentSchedule() { return false; }
  private:
   virtual void Schedule(void);
+  virtual void CapacityChange(void);
+  // port capacities are the sums over all networks.
+  void SumPortCapacity();
+  const double approx_epsilon_;
+  // created on the first Schedule() if NUM_SCHEDULER_THREADS > 1.
+  unique_ptr<WorkerPool> worker_pool_;
+  // MinCCT results kept across reschedules.
+  unique_ptr<MinCCTCache> min_cct_cache_;
  protected:
   vector<Scheduler*> schedulers_;//owned.
 };
 
 class SchedulerAaloImpl : public SchedulerVarys {
  public:
-  SchedulerAaloImpl(long scheduler_link_rate_bps = ELEC_BPS);
+  SchedulerAaloImpl(long scheduler_link_rate_bps = ELEC_BPS,
+                    const string& comp_time_model_name = COMP_TIME_MODEL_NAME);
   virtual ~SchedulerAaloImpl() {}
+  // the rate control logs queue moves from DEBUG_LEVEL 1 on.
+  virtual bool SupportsConcurrentSchedule() { return DEBUG_LEVEL < 1; }
  private:
   virtual void Schedule(void);
+  virtual double ComputeRates();
 
   virtual void AddCoflows(vector<Coflow*>* cfVecPtr);
 
@@ -266,8 +428,9 @@ class SchedulerAaloImpl : public SchedulerVarys {
 
 class SchedulerVarysImpl : public SchedulerVarys {
  public:
-  SchedulerVarysImpl(long scheduler_link_rate_bps = ELEC_BPS)
-      : SchedulerVarys(scheduler_link_rate_bps) {}
+  SchedulerVarysImpl(long scheduler_link_rate_bps = ELEC_BPS,
+                     const string& comp_time_model_name = COMP_TIME_MODEL_NAME)
+      : SchedulerVarys(scheduler_link_rate_bps, comp_time_model_name) {}
   virtual ~SchedulerVarysImpl() {}
  private:
 
@@ -277,6 +440,7 @@ class SchedulerVarysImpl : public SchedulerVarys {
   // map<int, long> *control_rates_;
 
   virtual void Schedule(void);
+  virtual double ComputeRates();
 
   // Varys implemented in Github!
   // rate control based on selfish coflow
@@ -298,6 +462,11 @@ class SchedulerVarysImpl : public SchedulerVarys {
                                        map<int, long>& sBpsFree,
                                        map<int, long>& rBpsFree,
                                        long LINK_RATE_BPS);
+  // Members of a flow group of coflow with free bandwidth, as of sBpsFree and
+  // rBps of the dst, unlike that of the first member are split off into
+  // flow groups of their own, so that all members of each take one rate.
+  void SplitFlowGroupOnFreeBps(Coflow* coflow, Flow* group, long rBps,
+                               map<int, long>& sBpsFree, long LINK_RATE_BPS);
 
   friend class SolverTest_Varys_ManyCoflow_Test;
   friend class SolverTest_Weaver_ManyCoflow_Test;
@@ -306,6 +475,12 @@ class SchedulerVarysImpl : public SchedulerVarys {
 class SchedulerFactory {
  public:
   static Scheduler* Get(const std::string& scheduler_name) {
+    if (FLOW_GROUPS && scheduler_name != "varysImpl") {
+      // other schedulers rate flows one src at a time.
+      cerr << "Flow groups are only supported by 'varysImpl', not '"
+           << scheduler_name << "'\n";
+      return nullptr;
+    }
     if (scheduler_name.substr(0, 6) == "weaver") {
       vector<Scheduler*>
           schedulers = GenerateChildrenSchedulers(scheduler_name);
@@ -322,6 +497,23 @@ class SchedulerFactory {
         run_seed = stoi(scheduler_name.substr(digit_idx));
       }
       return new SchedulerWeightedRandom(schedulers, run_seed);
+    } else if (scheduler_name.substr(0, 13) == "infocomApprox") {
+      vector<Scheduler*>
+          schedulers = GenerateChildrenSchedulers(scheduler_name);
+      // extract epsilon in percent if any, e.g. "infocomApprox5_..."
+      double approx_epsilon = 0.1;
+      std::string name_no_config =
+          scheduler_name.substr(0, scheduler_name.find_first_of("_"));
+      std::size_t const digit_idx = name_no_config.find_first_of("0123456789");
+      if (digit_idx != std::string::npos) {
+        approx_epsilon = stoi(scheduler_name.substr(digit_idx)) / 100.0;
+      }
+      if (approx_epsilon <= 0 || approx_epsilon >= 1) {
+        cerr << "Approximation epsilon out of (0, 1) in '"
+             << scheduler_name << "'\n";
+        return nullptr;
+      }
+      return new SchedulerInfocom(schedulers, approx_epsilon);
     } else if (scheduler_name.substr(0, 7) == "infocom") {
       vector<Scheduler*>
           schedulers = GenerateChildrenSchedulers(scheduler_name);
@@ -335,13 +527,15 @@ class SchedulerFactory {
     return nullptr;
   }
 
-  // used to customize individual scheduler's link rate
+  // used to customize individual scheduler's link rate and computation
+  // time model.
   static Scheduler* GetChild(const std::string& scheduler_name,
-                             long link_rate_bps) {
+                             long link_rate_bps,
+                             const std::string& comp_time_model_name) {
     if (scheduler_name == "varys") {
-      return new SchedulerVarysImpl(link_rate_bps);
+      return new SchedulerVarysImpl(link_rate_bps, comp_time_model_name);
     } else if (scheduler_name == "aalo") {
-      return new SchedulerAaloImpl(link_rate_bps);
+      return new SchedulerAaloImpl(link_rate_bps, comp_time_model_name);
     }
 
     cerr << "No scheduler found with name '" << scheduler_name << "'\n";
@@ -352,6 +546,8 @@ class SchedulerFactory {
   // two format of scheduler_name are accepted:
   // "weaver_ratioAscheduler_ratioBscheduler...",
   // or "weaver_Nnet_scheduler_ratioA_ratioB..."
+  // where each child may be followed by its computation time model, e.g.
+  // "weaver_20varys_cost_80varys_measured", or COMP_TIME_MODEL_NAME if not.
   static vector<Scheduler*> GenerateChildrenSchedulers(
       const std::string& scheduler_name) {
     std::string canonical_name = scheduler_name;
@@ -362,33 +558,44 @@ class SchedulerFactory {
     string weaver_name;
     line_stream >> weaver_name;
     // assert(weaver_name == "weaver");
+    vector<string> fields;
+    for (string field; line_stream >> field;) fields.push_back(field);
 
     int ratio_sum = 0;
     std::string default_scheduler_name;
     vector<Scheduler*> schedulers;
-    while (!line_stream.eof()) {
+    for (int field_idx = 0; field_idx < fields.size(); field_idx++) {
+      std::istringstream field_stream(fields[field_idx]);
       std::string name;
       int ratio;
       if (default_scheduler_name != "") {
         // using format "weaver_Nnet_scheduler_ratioA_ratioB..."
-        line_stream >> ratio;
+        field_stream >> ratio;
         name = default_scheduler_name;
       } else {
         // using format "weaver_ratioAscheduler_ratioBscheduler..."
-        line_stream >> ratio >> name;
+        field_stream >> ratio >> name;
       }
       // cout << ratio << "  " << name << endl;
       if (name == "net") {
-        line_stream >> default_scheduler_name;
+        if (field_idx + 1 < fields.size()) {
+          default_scheduler_name = fields[++field_idx];
+        }
         if (default_scheduler_name == "") {
           cout << "Must specify default scheduler name after Nnet config\n";
           exit(-1);
         }
         continue; // with ratios
       }
+      std::string comp_time_model_name = COMP_TIME_MODEL_NAME;
+      if (field_idx + 1 < fields.size()
+          && (fields[field_idx + 1] == "measured"
+              || fields[field_idx + 1] == "cost")) {
+        comp_time_model_name = fields[++field_idx];
+      }
 
-      Scheduler* new_scheduler =
-          SchedulerFactory::GetChild(name, ELEC_BPS / 100 * ratio);
+      Scheduler* new_scheduler = SchedulerFactory::GetChild(
+          name, ELEC_BPS / 100 * ratio, comp_time_model_name);
       if (new_scheduler) {
         schedulers.push_back(new_scheduler);
         ratio_sum += ratio;
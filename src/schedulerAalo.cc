@@ -7,16 +7,17 @@
 
 #include <algorithm>
 #include <iomanip>
-#include <sys/time.h>
 
 #include "scheduler.h"
 #include "events.h"
 #include "global.h"
+#include "profiler.h"
 #include "util.h"
 #include "coflow.h"
 
-SchedulerAaloImpl::SchedulerAaloImpl(long scheduler_link_rate_bps)
-    : SchedulerVarys(scheduler_link_rate_bps) {
+SchedulerAaloImpl::SchedulerAaloImpl(long scheduler_link_rate_bps,
+                                     const string& comp_time_model_name)
+    : SchedulerVarys(scheduler_link_rate_bps, comp_time_model_name) {
   m_coflow_jid_queues.resize(AALO_Q_NUM);
   name_ = to_string(instance_count_) + "aalo"
       + to_string(int(SCHEDULER_LINK_RATE_BPS_ / 1e6)) + "Mbps";
@@ -47,8 +48,22 @@ SchedulerAaloImpl::Schedule() {
 
   Print();
 
-  struct timeval start_time;
-  gettimeofday(&start_time, NULL);
+  double ComputationSeconds = TakeOrComputeRates();
+  // test of pattern computation delay
+  if (ZERO_COMP_TIME) {
+    ComputationSeconds = 0.0;
+  }
+
+  m_myTimeLine->RemoveSingularEvent(APPLY_NEW_SCHEDULE);
+  double activateTime = m_currentTime + ComputationSeconds;
+  Event* applyScheduleEventPtr = new Event(APPLY_NEW_SCHEDULE, activateTime);
+  m_myTimeLine->AddEvent(applyScheduleEventPtr);
+}
+
+double
+SchedulerAaloImpl::ComputeRates() {
+  ScopedTimer timer("", name_);
+  StartRateControl();
   /////////////// Aalo //////////////////////////
 
   // STEP 1: Initialize next rate for all flows to (0,0)
@@ -59,19 +74,7 @@ SchedulerAaloImpl::Schedule() {
   RateControlAaloImpl(m_coflowPtrVector, m_coflow_jid_queues,
                       m_nextElecRate, SCHEDULER_LINK_RATE_BPS_);
 
-  struct timeval end_time;
-  gettimeofday(&end_time, NULL);
-
-  double ComputationSeconds = secondPass(end_time, start_time);
-  // test of pattern computation delay
-  if (ZERO_COMP_TIME) {
-    ComputationSeconds = 0.0;
-  }
-
-  m_myTimeLine->RemoveSingularEvent(APPLY_NEW_SCHEDULE);
-  double activateTime = m_currentTime + ComputationSeconds;
-  Event* applyScheduleEventPtr = new Event(APPLY_NEW_SCHEDULE, activateTime);
-  m_myTimeLine->AddEvent(applyScheduleEventPtr);
+  return EndRateControl();
 }
 
 // perform aalo based rate control - as seen in Github.
@@ -91,12 +94,16 @@ SchedulerAaloImpl::RateControlAaloImpl(vector<Coflow*>& coflows,
     return;
   }
 
+  ScopedTimer timer("rate_control");
   rates.clear();
 
   map<int, Coflow*> coflow_id_ptr_map;
-  // update Coflow piority/queue.
-  // coflow are sorted by
-  UpdateCoflowQueue(coflows, coflow_id_queues, coflow_id_ptr_map);
+  {
+    // update Coflow piority/queue.
+    // coflow are sorted by
+    ScopedTimer sort_timer("sort");
+    UpdateCoflowQueue(coflows, coflow_id_queues, coflow_id_ptr_map);
+  }
 
   // initialize.
   map<int, long> sBpsFree, rBpsFree;
@@ -149,8 +156,8 @@ SchedulerAaloImpl::RateControlAaloImpl(vector<Coflow*>& coflows,
         int src = (*fpIt)->GetSrc();
         int dst = (*fpIt)->GetDest();
 
-        long sBps = MapWithDef(sBpsFree, src, LINK_RATE_BPS);
-        long rBps = MapWithDef(rBpsFree, dst, LINK_RATE_BPS);
+        long sBps = MapWithDef(sBpsFree, src, GetSrcPortBps(src, LINK_RATE_BPS));
+        long rBps = MapWithDef(rBpsFree, dst, GetDstPortBps(dst, LINK_RATE_BPS));
 
         if (sBps <= 0 || rBps <= 0) {
           // no more bandwidth left.
@@ -173,12 +180,14 @@ SchedulerAaloImpl::RateControlAaloImpl(vector<Coflow*>& coflows,
       // Remove capacity from ALL sources and destination for this coflow
       for (map<int, long>::iterator sUsedIt = sBpsUsed.begin();
            sUsedIt != sBpsUsed.end(); sUsedIt++) {
-        MapWithDef(sBpsFree, sUsedIt->first, LINK_RATE_BPS);
+        MapWithDef(sBpsFree, sUsedIt->first,
+                   GetSrcPortBps(sUsedIt->first, LINK_RATE_BPS));
         sBpsFree[sUsedIt->first] -= sUsedIt->second;
       }
       for (map<int, long>::iterator rUsedIt = rBpsUsed.begin();
            rUsedIt != rBpsUsed.end(); rUsedIt++) {
-        MapWithDef(rBpsFree, rUsedIt->first, LINK_RATE_BPS);
+        MapWithDef(rBpsFree, rUsedIt->first,
+                   GetDstPortBps(rUsedIt->first, LINK_RATE_BPS));
         rBpsFree[rUsedIt->first] -= rUsedIt->second;
       }
     } // for each coflow
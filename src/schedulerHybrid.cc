@@ -27,6 +27,29 @@ void SchedulerHybrid::InstallSimulator(Simulator* simulator) {
   }
 }
 
+void SchedulerHybrid::NotifyCapacityChange(double time, int net_idx,
+                                           long link_rate_bps) {
+  if (net_idx < 0 || net_idx >= schedulers_.size()) {
+    cerr << "[SchedulerHybrid::NotifyCapacityChange] ERROR: "
+         << "no network #" << net_idx << " among "
+         << schedulers_.size() << " networks" << endl;
+    return;
+  }
+  // the child scheduler reschedules upon the change.
+  schedulers_[net_idx]->NotifyCapacityChange(time, 0, link_rate_bps);
+}
+
+void SchedulerHybrid::SetPortCapacity(int net_idx, int port,
+                                      long src_port_bps, long dst_port_bps) {
+  if (net_idx < 0 || net_idx >= schedulers_.size()) {
+    cerr << "[SchedulerHybrid::SetPortCapacity] ERROR: "
+         << "no network #" << net_idx << " among "
+         << schedulers_.size() << " networks" << endl;
+    return;
+  }
+  schedulers_[net_idx]->SetPortCapacity(0, port, src_port_bps, dst_port_bps);
+}
+
 void SchedulerHybrid::SchedulerAlarmPortal(double alarm_time) {
 
   if (m_currentTime > alarm_time) {
@@ -42,7 +65,7 @@ void SchedulerHybrid::SchedulerAlarmPortal(double alarm_time) {
            << " scheduler's time " << scheduler->m_currentTime
            << " ahead of alarm time " << alarm_time << endl;
       // exit(-1);
-    } else {
+    } else if (!scheduler->DeferSyncTo(alarm_time)) {
       //      cout << "[SchedulerHybrid::SchedulerAlarmPortal] calling TX "
       //           << scheduler->m_currentTime << "->" << alarm_time << endl;
 
@@ -50,6 +73,9 @@ void SchedulerHybrid::SchedulerAlarmPortal(double alarm_time) {
       // transmission here to synchronize all scheduler's time. We don't bother
       // to peek into each scheduler to see whether salvage transmission is
       // needed. It is possible to do so to avoid scheduling glitches.
+      // Most of the time no flow of the child finishes before alarm_time, and
+      // the transmission is deferred until the child wakes up by itself.
+      scheduler->CatchUpDeferredSync();
       bool has_flow_finished = scheduler->Transmit(
           scheduler->m_currentTime, alarm_time,
           /*basic = */true, /*local = */false, /*salvage = */false);
@@ -6,19 +6,111 @@
 
 #include "events.h"
 #include "global.h"
+#include "profiler.h"
 #include "scheduler.h"
 #include "solver_infocom.h"
 
+SchedulerInfocom::SchedulerInfocom(vector<Scheduler*> schedulers,
+                                   double approx_epsilon)
+    // routing is not timed by a computation time model.
+    : SchedulerVarys(ELEC_BPS, /*comp_time_model_name=*/""),
+      approx_epsilon_(approx_epsilon),
+      min_cct_cache_(new MinCCTCache()), schedulers_(schedulers) {}
+
+SchedulerInfocom::~SchedulerInfocom() {
+  for (Scheduler* s:schedulers_) delete s;
+}
+
+void SchedulerInfocom::NotifySimEnd() {
+  Scheduler::NotifySimEnd();
+  min_cct_cache_->Report(cout);
+}
+
+void SchedulerInfocom::SetPortCapacity(int net_idx, int port,
+                                       long src_port_bps, long dst_port_bps) {
+  if (net_idx < 0 || net_idx >= schedulers_.size()) {
+    cerr << "[SchedulerInfocom::SetPortCapacity] ERROR: "
+         << "no network #" << net_idx << " among "
+         << schedulers_.size() << " networks" << endl;
+    return;
+  }
+  schedulers_[net_idx]->SetPortCapacity(0, port, src_port_bps, dst_port_bps);
+  SumPortCapacity();
+}
+
+void SchedulerInfocom::NotifyCapacityChange(double time, int net_idx,
+                                            long link_rate_bps) {
+  if (net_idx < 0 || net_idx >= schedulers_.size()) {
+    cerr << "[SchedulerInfocom::NotifyCapacityChange] ERROR: "
+         << "no network #" << net_idx << " among "
+         << schedulers_.size() << " networks" << endl;
+    return;
+  }
+  // applied in CapacityChange(), after flows are transmitted up to time.
+  m_myTimeLine->AddEvent(
+      new EventCapacityChange(time, link_rate_bps, net_idx));
+  UpdateAlarm();
+}
+
+void SchedulerInfocom::CapacityChange() {
+  EventCapacityChange
+      * capacityChangeEvent = (EventCapacityChange*) m_myTimeLine->PeekNext();
+  if (capacityChangeEvent->GetEventType() != CAPACITY_CHANGE) {
+    cout << "[SchedulerInfocom::CapacityChange] error: "
+         << " the event type is not CAPACITY_CHANGE!" << endl;
+    return;
+  }
+  Scheduler* network = schedulers_[capacityChangeEvent->net_idx];
+  cout << fixed << setw(FLOAT_TIME_WIDTH) << m_currentTime << "s "
+       << "[SchedulerInfocom::CapacityChange] " << network->name_
+       << " link rate " << network->SCHEDULER_LINK_RATE_BPS_ << " -> "
+       << capacityChangeEvent->link_rate_bps << " bps" << endl;
+  // SolverInfocom routes over the port capacities of the networks.
+  network->SetLinkRate(capacityChangeEvent->link_rate_bps);
+  long link_rate_sum_bps = 0;
+  for (Scheduler* scheduler : schedulers_) {
+    link_rate_sum_bps += scheduler->SCHEDULER_LINK_RATE_BPS_;
+  }
+  // current rates are scaled down by the aggregate ratio until the
+  // reschedule below routes flows again.
+  Scheduler::SetLinkRate(link_rate_sum_bps);
+  SumPortCapacity();
+  Scheduler::UpdateFlowFinishEvent(m_currentTime);
+  Scheduler::UpdateRescheduleEvent(m_currentTime);
+}
+
+void SchedulerInfocom::SumPortCapacity() {
+  size_t num_ports = 0;
+  for (Scheduler* scheduler : schedulers_) {
+    num_ports = max(num_ports, scheduler->src_port_bps_.size());
+  }
+  // flows of a port may go through all networks at the same time.
+  src_port_bps_.assign(num_ports, 0);
+  dst_port_bps_.assign(num_ports, 0);
+  for (int port = 0; port < num_ports; port++) {
+    for (Scheduler* scheduler : schedulers_) {
+      src_port_bps_[port] += scheduler->GetSrcPortBps(port);
+      dst_port_bps_[port] += scheduler->GetDstPortBps(port);
+    }
+  }
+}
+
 void SchedulerInfocom::Schedule(void) {
   //  cout << fixed << setw(FLOAT_TIME_WIDTH)
   //       << m_currentTime << "s "
   //       << "[SchedulerInfocom::schedule] Infocom scheduling START" << endl;
 
+  ScopedTimer timer("", name_);
   // STEP 1: Initialize next rate for all flows to (0,0)
   m_nextElecRate.clear();
 
   // STEP 2: Perform rate control, as well as routing if needed.
-  SolverInfocom solver_infocom(schedulers_);
+  if (NUM_SCHEDULER_THREADS > 1 && !worker_pool_) {
+    worker_pool_.reset(new WorkerPool(NUM_SCHEDULER_THREADS));
+  }
+  SolverInfocom solver_infocom(schedulers_, /*debug_level=*/0,
+                               worker_pool_.get(), min_cct_cache_.get(),
+                               approx_epsilon_);
   solver_infocom.ComputeRouteAndRate(m_coflowPtrVector, &m_nextElecRate);
 
   cout << fixed << setw(FLOAT_TIME_WIDTH)
@@ -8,11 +8,11 @@
 
 #include <algorithm>
 #include <iomanip>
-#include <sys/time.h>
 
 #include "coflow.h"
 #include "events.h"
 #include "global.h"
+#include "profiler.h"
 #include "scheduler.h"
 #include "util.h"
 
@@ -24,7 +24,62 @@ SchedulerVarys::~SchedulerVarys() {}
 
 void
 SchedulerVarys::SchedulerAlarmPortal(double alarmTime) {
+  // catch up with transmissions deferred by the hybrid scheduler, if any.
+  CatchUpDeferredSync();
+  ProcessEvents(alarmTime, /*stop_before_schedule = */false);
+  UpdateAlarm();
+}
+
+bool
+SchedulerVarys::AlarmPortalUntilSchedule(double alarmTime) {
+  CatchUpDeferredSync();
+  if (ProcessEvents(alarmTime, /*stop_before_schedule = */true)) {
+    return true;
+  }
+  UpdateAlarm();
+  return false;
+}
+
+void
+SchedulerVarys::PrecomputeSchedule() {
+  precomputed_comp_seconds_ = ComputeRates();
+  has_precomputed_rates_ = true;
+}
 
+double
+SchedulerVarys::TakeOrComputeRates() {
+  if (has_precomputed_rates_) {
+    has_precomputed_rates_ = false;
+    return precomputed_comp_seconds_;
+  }
+  return ComputeRates();
+}
+
+double
+SchedulerVarys::EndRateControl() {
+  CompTimeCounters counters;
+  if (comp_time_model_->UsesCounters()) {
+    set<int> ports;
+    for (Coflow* coflow : m_coflowPtrVector) {
+      counters.num_coflows++;
+      for (Flow* flow : *coflow->GetFlows()) {
+        if (!flow->HasDemand()) continue;
+        counters.num_flows++;
+        // src and dst ports are counted apart.
+        for (int member_idx = 0; member_idx < flow->GetNumMembers();
+             member_idx++) {
+          ports.insert(2 * flow->GetMemberSrc(member_idx));
+        }
+        ports.insert(2 * flow->GetDest() + 1);
+      }
+    }
+    counters.num_ports = ports.size();
+  }
+  return comp_time_model_->Stop(counters);
+}
+
+bool
+SchedulerVarys::ProcessEvents(double alarmTime, bool stop_before_schedule) {
   while (!m_myTimeLine->isEmpty()) {
 
     if (m_currentTime > alarmTime) {
@@ -48,6 +103,9 @@ SchedulerVarys::SchedulerAlarmPortal(double alarmTime) {
     if (currentEventTime > alarmTime) {
       break; // while
     }
+    if (stop_before_schedule && currentEvent->GetEventType() == RESCHEDULE) {
+      return true;
+    }
 
 //    cout << fixed << setw(FLOAT_TIME_WIDTH) << currentEventTime << "s "
 //         << "[SchedulerVarys::SchedulerAlarmPortal] "
@@ -68,6 +126,8 @@ SchedulerVarys::SchedulerAlarmPortal(double alarmTime) {
         break;
       case APPLY_NEW_SCHEDULE:ApplyNewSchedule();
         break;
+      case CAPACITY_CHANGE:CapacityChange();
+        break;
       case FLOW_FINISH:break;
       default:break;
     }
@@ -78,8 +138,7 @@ SchedulerVarys::SchedulerAlarmPortal(double alarmTime) {
     }
     delete currentEvent;
   }
-
-  UpdateAlarm();
+  return false;
 }
 
 void
@@ -97,6 +156,25 @@ SchedulerVarys::ApplyNewSchedule() {
   //     << "Next time to finish flow " << flow_finish_ts << endl;
 }
 
+void
+SchedulerVarys::CapacityChange() {
+  EventCapacityChange
+      * capacityChangeEvent = (EventCapacityChange*) m_myTimeLine->PeekNext();
+  if (capacityChangeEvent->GetEventType() != CAPACITY_CHANGE) {
+    cout << "[SchedulerVarys::CapacityChange] error: "
+         << " the event type is not CAPACITY_CHANGE!" << endl;
+    return;
+  }
+  cout << fixed << setw(FLOAT_TIME_WIDTH) << m_currentTime << "s "
+       << "[SchedulerVarys::CapacityChange] " << name_ << " link rate "
+       << SCHEDULER_LINK_RATE_BPS_ << " -> "
+       << capacityChangeEvent->link_rate_bps << " bps" << endl;
+  Scheduler::SetLinkRate(capacityChangeEvent->link_rate_bps);
+  // flows may be slowed down, and a new schedule is needed anyway.
+  Scheduler::UpdateFlowFinishEvent(m_currentTime);
+  Scheduler::UpdateRescheduleEvent(m_currentTime);
+}
+
 void
 SchedulerVarys::CoflowArrive() {
   // unbox coflow vector pointer
@@ -141,6 +219,21 @@ SchedulerVarys::CoflowFinishCallBack(double finishTime) {
 
 void
 SchedulerVarys::FlowFinishCallBack(double finishTime) {
+  // rates are only renewed upon coflow arrival/departure. Should the flow
+  // groups left all have no rate, e.g. rounded down to 0 bps as they are tiny
+  // to a wide coflow, reschedule now rather than idle until the next coflow.
+  if (!FLOW_GROUPS) return;
+  bool has_demand = false;
+  for (Coflow* coflow : m_coflowPtrVector) {
+    for (Flow* flow : *coflow->GetFlows()) {
+      if (flow->GetBitsLeft() <= 0) continue;
+      if (flow->GetElecRate() > 0) return;
+      has_demand = true;
+    }
+  }
+  if (has_demand) {
+    Scheduler::UpdateRescheduleEvent(finishTime);
+  }
 }
 
 
@@ -158,22 +251,7 @@ SchedulerVarysImpl::Schedule() {
 
   Print();
 
-  struct timeval start_time;
-  gettimeofday(&start_time, NULL);
-  /////////////// varys //////////////////////////
-
-
-  // STEP 1: Initialize next rate for all flows to (0,0)
-  m_nextElecRate.clear();
-
-  // STEP 2: Perform varys rate control
-  RateControlVarysImpl(m_coflowPtrVector, m_nextElecRate,
-                       SCHEDULER_LINK_RATE_BPS_);
-
-  struct timeval end_time;
-  gettimeofday(&end_time, NULL);
-
-  double ComputationSeconds = secondPass(end_time, start_time);
+  double ComputationSeconds = TakeOrComputeRates();
   // test of pattern computation delay
   if (ZERO_COMP_TIME) {
     ComputationSeconds = 0.0;
@@ -201,6 +279,23 @@ SchedulerVarysImpl::Schedule() {
    */
 }
 
+double
+SchedulerVarysImpl::ComputeRates() {
+  ScopedTimer timer("", name_);
+  StartRateControl();
+  /////////////// varys //////////////////////////
+
+
+  // STEP 1: Initialize next rate for all flows to (0,0)
+  m_nextElecRate.clear();
+
+  // STEP 2: Perform varys rate control
+  RateControlVarysImpl(m_coflowPtrVector, m_nextElecRate,
+                       SCHEDULER_LINK_RATE_BPS_);
+
+  return EndRateControl();
+}
+
 // perform varys based rate control, a similar version as seen in Github some
 // time in 2015, which will sort coflows (in place), and record flow rate to
 // rates (in place).
@@ -215,6 +310,7 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
     return;
   }
 
+  ScopedTimer timer("rate_control");
   rates.clear();
 
   // STEP 1: Sort ALL coflows based on different scheduling policies.
@@ -223,7 +319,10 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
 
   // fixed by Sunny : sort Coflows on runtime bottle-neck.
   // The performance is much better than original implementation.
-  SortCoflows(coflows);
+  {
+    ScopedTimer sort_timer("sort");
+    SortCoflows(coflows);
+  }
 
   // initialize.
   map<int, long> sBpsFree, rBpsFree;
@@ -246,10 +345,11 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
 
     map<int, long> sBpsUsed, rBpsUsed;
 
-    for (vector<Flow*>::iterator fpIt = flowVecPtr->begin();
-         fpIt != flowVecPtr->end(); fpIt++) {
+    // flow groups split in the loop are appended, and rated later on.
+    for (size_t flow_idx = 0; flow_idx < flowVecPtr->size(); flow_idx++) {
+      Flow* flow = (*flowVecPtr)[flow_idx];
       // for each flow within the coflow
-      if ((*fpIt)->GetBitsLeft() <= 0) {
+      if (flow->GetBitsLeft() <= 0) {
         //such flow has completed
         continue;
       }
@@ -269,9 +369,22 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
 
       // another proposal - more selfish coflow.
       // this proposal has much better performance.
-      long sBps = MapWithDef(sBpsFree, (*fpIt)->GetSrc(), LINK_RATE_BPS);
-      long rBps = MapWithDef(rBpsFree, (*fpIt)->GetDest(), LINK_RATE_BPS);
-      long minFreeBps = sBps < rBps ? sBps : rBps;
+      // A flow group takes one rate for all its members, once members on
+      // srcs of other free bandwidth are split off.
+      int dst = flow->GetDest();
+      long rBps = MapWithDef(rBpsFree, dst, GetDstPortBps(dst, LINK_RATE_BPS));
+      if (flow->GetNumMembers() > 1) {
+        SplitFlowGroupOnFreeBps(cf_to_be_schedule, flow, rBps, sBpsFree,
+                                LINK_RATE_BPS);
+      }
+      int num_members = flow->GetNumMembers();
+      long minFreeBps = rBps;
+      for (int member_idx = 0; member_idx < num_members; member_idx++) {
+        int src = flow->GetMemberSrc(member_idx);
+        long sBps =
+            MapWithDef(sBpsFree, src, GetSrcPortBps(src, LINK_RATE_BPS));
+        minFreeBps = sBps < minFreeBps ? sBps : minFreeBps;
+      }
       // Intuition is as follows:
       // Assume the current flow is on the bottleneck port.
       // Therefore the bottleneck link rate is minFreeBps.
@@ -280,27 +393,31 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
       // because alpha is the max estimate of the
       // max( sum(src-demand-of-this-coflow),
       //      sum(dst-demand-of-this-coflow))
-      long flowBitps = minFreeBps * ((*fpIt)->GetBitsLeft()
+      long flowBitps = minFreeBps * (flow->GetBitsLeft()
           / (double) cf_to_be_schedule->GetAlpha());
 
 
       // update utilization profile.
       if (flowBitps > 0) {
-        MapWithDef(rates, (*fpIt)->GetFlowId(), flowBitps);
-        MapWithInc(sBpsUsed, (*fpIt)->GetSrc(), flowBitps);
-        MapWithInc(rBpsUsed, (*fpIt)->GetDest(), flowBitps);
+        MapWithDef(rates, flow->GetFlowId(), flowBitps);
+        for (int member_idx = 0; member_idx < num_members; member_idx++) {
+          MapWithInc(sBpsUsed, flow->GetMemberSrc(member_idx), flowBitps);
+        }
+        MapWithInc(rBpsUsed, dst, flowBitps * num_members);
       }
     } // for each flow
 
     // Remove capacity from ALL sources and destination for this coflow
     for (map<int, long>::iterator sUsedIt = sBpsUsed.begin();
          sUsedIt != sBpsUsed.end(); sUsedIt++) {
-      MapWithDef(sBpsFree, sUsedIt->first, LINK_RATE_BPS);
+      MapWithDef(sBpsFree, sUsedIt->first,
+                 GetSrcPortBps(sUsedIt->first, LINK_RATE_BPS));
       sBpsFree[sUsedIt->first] -= sUsedIt->second;
     }
     for (map<int, long>::iterator rUsedIt = rBpsUsed.begin();
          rUsedIt != rBpsUsed.end(); rUsedIt++) {
-      MapWithDef(rBpsFree, rUsedIt->first, LINK_RATE_BPS);
+      MapWithDef(rBpsFree, rUsedIt->first,
+                 GetDstPortBps(rUsedIt->first, LINK_RATE_BPS));
       rBpsFree[rUsedIt->first] -= rUsedIt->second;
     }
   } // for each coflow.
@@ -311,11 +428,33 @@ SchedulerVarysImpl::RateControlVarysImpl(vector<Coflow*>& coflows,
   m_rBpsFree_before_workConserv = rBpsFree;
 
   // STEP2A: Work conservation as seen in Github.
+  ScopedTimer work_conservation_timer("work_conservation");
   RateControlWorkConservationImpl(coflows, rates,
                                   sBpsFree, rBpsFree,
                                   LINK_RATE_BPS);
 }
 
+void
+SchedulerVarysImpl::SplitFlowGroupOnFreeBps(Coflow* coflow, Flow* group,
+                                            long rBps,
+                                            map<int, long>& sBpsFree,
+                                            long LINK_RATE_BPS) {
+  map<long, vector<int>> srcs_on_free_bps;
+  long group_free_bps = -1;
+  for (int member_idx = 0; member_idx < group->GetNumMembers();
+       member_idx++) {
+    int src = group->GetMemberSrc(member_idx);
+    long sBps = MapWithDef(sBpsFree, src, GetSrcPortBps(src, LINK_RATE_BPS));
+    long minFreeBps = sBps < rBps ? sBps : rBps;
+    if (member_idx == 0) group_free_bps = minFreeBps;
+    srcs_on_free_bps[minFreeBps].push_back(src);
+  }
+  for (const auto& free_bps_srcs : srcs_on_free_bps) {
+    if (free_bps_srcs.first == group_free_bps) continue;
+    coflow->SplitFlowGroup(group, free_bps_srcs.second);
+  }
+}
+
 // perform work conservation in the order of coflows, and flows within a coflow.
 // given available src/dst port bandwidth resource left
 // in sBpsFree & rBpsFree.
@@ -342,18 +481,78 @@ SchedulerVarysImpl::RateControlWorkConservationImpl(vector<Coflow*>& coflows,
       //such coflow has completed
       continue;
     }
-    for (Flow* flow:  *coflow->GetFlows()) {
+    vector<Flow*>* flowVecPtr = coflow->GetFlows();
+    // flow groups split in the loop are appended, and already rated.
+    size_t num_flows = flowVecPtr->size();
+    // members of flow groups take the free bandwidth in order, as if they
+    // were flows of their own, i.e. mapper by mapper, as flows without
+    // groups are.
+    vector<pair<int, pair<size_t, int>>> members;
+    for (size_t flow_idx = 0; flow_idx < num_flows; flow_idx++) {
+      Flow* flow = (*flowVecPtr)[flow_idx];
       if (flow->GetBitsLeft() <= 0) {
         //such flow has completed
         continue;
       }
-      long sBps = MapWithDef(sBpsFree, flow->GetSrc(), LINK_RATE_BPS);
-      long rBps = MapWithDef(rBpsFree, flow->GetDest(), LINK_RATE_BPS);
+      for (int member_idx = 0; member_idx < flow->GetNumMembers();
+           member_idx++) {
+        members.push_back(std::make_pair(
+            flow->GetMemberIndexInCoflow(member_idx),
+            std::make_pair(flow_idx, member_idx)));
+      }
+    }
+    if (FLOW_GROUPS) {
+      std::stable_sort(members.begin(), members.end(),
+                       [](const pair<int, pair<size_t, int>>& l,
+                          const pair<int, pair<size_t, int>>& r) {
+                         return l.first < r.first;
+                       });
+    }
+    vector<vector<long>> member_free_bps(num_flows);
+    for (const auto& member : members) {
+      Flow* flow = (*flowVecPtr)[member.second.first];
+      int src = flow->GetMemberSrc(member.second.second);
+      int dst = flow->GetDest();
+      long sBps = MapWithDef(sBpsFree, src, GetSrcPortBps(src, LINK_RATE_BPS));
+      long rBps = MapWithDef(rBpsFree, dst, GetDstPortBps(dst, LINK_RATE_BPS));
       long minFreeBps = sBps < rBps ? sBps : rBps;
       if (minFreeBps > 0) {
-        MapWithInc(rates, flow->GetFlowId(), minFreeBps);
-        sBpsFree[flow->GetSrc()] -= minFreeBps;
-        rBpsFree[flow->GetDest()] -= minFreeBps;
+        sBpsFree[src] -= minFreeBps;
+        rBpsFree[dst] -= minFreeBps;
+      } else {
+        minFreeBps = 0;
+      }
+      vector<long>& free_bps = member_free_bps[member.second.first];
+      free_bps.resize(flow->GetNumMembers());
+      free_bps[member.second.second] = minFreeBps;
+    }
+    // members taking other free bandwidth than the first member are split
+    // off.
+    for (size_t flow_idx = 0; flow_idx < num_flows; flow_idx++) {
+      Flow* flow = (*flowVecPtr)[flow_idx];
+      const vector<long>& free_bps = member_free_bps[flow_idx];
+      if (free_bps.empty()) continue;
+      map<long, vector<int>> srcs_on_free_bps;
+      for (int member_idx = 0; member_idx < flow->GetNumMembers();
+           member_idx++) {
+        srcs_on_free_bps[free_bps[member_idx]].push_back(
+            flow->GetMemberSrc(member_idx));
+      }
+      long group_free_bps = free_bps.front();
+      map<long, long>::const_iterator rate_it = rates.find(flow->GetFlowId());
+      long flowBitps = rate_it == rates.end() ? 0 : rate_it->second;
+      for (const auto& free_bps_srcs : srcs_on_free_bps) {
+        Flow* rated_flow = flow;
+        if (free_bps_srcs.first != group_free_bps) {
+          // split off members keep the rate of the group on top.
+          rated_flow = coflow->SplitFlowGroup(flow, free_bps_srcs.second);
+          if (flowBitps > 0) {
+            MapWithDef(rates, rated_flow->GetFlowId(), flowBitps);
+          }
+        }
+        if (free_bps_srcs.first > 0) {
+          MapWithInc(rates, rated_flow->GetFlowId(), free_bps_srcs.first);
+        }
       }
     }
   }
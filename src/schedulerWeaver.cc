@@ -3,20 +3,25 @@
 //
 
 #include <assert.h>
-#include <random>
 #include <algorithm> // needed for find in stable_sort()
 
 #include "events.h"
 #include "global.h"
+#include "profiler.h"
 #include "scheduler.h"
 #include "util.h"
 #include "coflow.h"
+#include "counter_rng.h"
+
+const long SchedulerWeaver::MIN_SUB_FLOW_BITS_ = 8000000;
 
 SchedulerWeaver::SchedulerWeaver(vector<Scheduler *> &schedulers,
                                      FlowOrderMode flow_order_mode,
-                                     NonCriticalMode non_critical_mode)
-    : SchedulerSplit(schedulers), flow_order_mode_(flow_order_mode),
-      non_critical_mode_(non_critical_mode), debug_level_(0) {} // DEBUG_LEVEL
+                                     NonCriticalMode non_critical_mode,
+                                     bool split_flow)
+    : SchedulerSplit(schedulers), debug_level_(0), // DEBUG_LEVEL
+      flow_order_mode_(flow_order_mode),
+      non_critical_mode_(non_critical_mode), split_flow_(split_flow) {}
 
 // static
 SchedulerWeaver *SchedulerWeaver::Factory(
@@ -48,6 +53,11 @@ SchedulerWeaver *SchedulerWeaver::Factory(
     return new SchedulerWeaver(children_schedulers,
                                  FlowOrderMode::FLOW_SIZE_LARGE_FIRST,
                                  NonCriticalMode::NON_CRITICAL_MIN_BN);
+  } else if (full_name.substr(0, 15) == "weaverSplitFlow") {
+    return new SchedulerWeaver(children_schedulers,
+                                 FlowOrderMode::FLOW_SIZE_LARGE_FIRST,
+                                 NonCriticalMode::NON_CRITICAL_RATIO_LB,
+                                 /*split_flow=*/true);
   }
   return new SchedulerWeaver(children_schedulers);
 }
@@ -80,8 +90,11 @@ void SchedulerWeaver::CoflowArrive() {
                      return l->SCHEDULER_LINK_RATE_BPS_
                          >= r->SCHEDULER_LINK_RATE_BPS_;
                    });
-  AssignCoflowsToSchedulers(parent_coflows, schedulers,
-                            &scheduler_to_children_coflows);
+  {
+    ScopedTimer timer(name_, "weaver_split");
+    AssignCoflowsToSchedulers(parent_coflows, schedulers,
+                              &scheduler_to_children_coflows);
+  }
 
   for (const auto &scheduler_coflows_pair: scheduler_to_children_coflows) {
     vector<Coflow *> *coflows_this_scheduler = scheduler_coflows_pair.second;
@@ -103,6 +116,15 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
     vector<Coflow *> &parent_coflows, vector<Scheduler *> &schedulers,
     map<Scheduler *, vector<Coflow *> *> *scheduler_to_children_coflows) {
 
+  // link rates in Mbps, cumulated for CounterRng::Pick() of
+  // NON_CRITICAL_RANDOM.
+  vector<long> cumulative_mbps;
+  for (Scheduler *scheduler:schedulers) {
+    cumulative_mbps.push_back(
+        (cumulative_mbps.empty() ? 0 : cumulative_mbps.back())
+            + long(scheduler->SCHEDULER_LINK_RATE_BPS_ / 1e6));
+  }
+
   for (Coflow *parent:parent_coflows) {
     vector<Flow *> sorted_flows = *parent->GetFlows();
     switch (flow_order_mode_) {
@@ -135,7 +157,8 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
                          });
         break;
       case FLOW_ORDER_RANDOM: {
-        std::mt19937 engine(parent->coflow_rand_seed_);
+        CounterRng engine(parent->coflow_rand_seed_, parent->GetJobId(),
+                          CounterRng::COFLOW_STREAM);
         std::shuffle(sorted_flows.begin(), sorted_flows.end(), engine);
         break;
       }
@@ -145,18 +168,6 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
       }
     }
     // now begin to assign path
-    typedef struct Scheduler_Profile {
-      Scheduler_Profile() : max_src_sum_bit(0), max_dst_sum_bit(0) {}
-      Scheduler_Profile(const map<int, double> &current_load_src_sum_bit,
-                        const map<int, double> &current_load_dst_sum_bit) :
-          src_sum_bit(current_load_src_sum_bit),
-          dst_sum_bit(current_load_dst_sum_bit),
-          max_src_sum_bit(MaxMap(current_load_src_sum_bit)),
-          max_dst_sum_bit(MaxMap(current_load_dst_sum_bit)) {}
-      map<int, double> src_sum_bit, dst_sum_bit;
-      double max_src_sum_bit, max_dst_sum_bit;
-      vector<Flow *> assigned_flows; // to be added
-    } Profile;
     map<Scheduler *, Profile> scheduler_profile;
     for (Flow *flow: sorted_flows) {
       if (!flow->HasDemand()) {
@@ -175,36 +186,54 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
       // look for a scheduler (switch) for this flow
       for (Scheduler *this_scheduler:schedulers) {
         Profile &profile = scheduler_profile[this_scheduler];
-        double this_sum = max(
-            max(profile.max_src_sum_bit,
-                flow->GetBitsLeft() + profile.src_sum_bit[flow->GetSrc()]),
-            max(profile.max_dst_sum_bit,
-                flow->GetBitsLeft() + profile.dst_sum_bit[flow->GetDest()]));
-        if (this_sum > max(profile.max_src_sum_bit, profile.max_dst_sum_bit)) {
+        double this_cct = max(
+            max(profile.max_src_sum_sec,
+                (flow->GetBitsLeft() + profile.src_sum_bit[flow->GetSrc()])
+                    / this_scheduler->GetSrcPortBps(flow->GetSrc())),
+            max(profile.max_dst_sum_sec,
+                (flow->GetBitsLeft() + profile.dst_sum_bit[flow->GetDest()])
+                    / this_scheduler->GetDstPortBps(flow->GetDest())));
+        if (this_cct > max(profile.max_src_sum_sec, profile.max_dst_sum_sec)) {
           // final cct might be increased when any child coflow's cct is increased.
           is_critical = true;
         }
-        double this_cct = this_sum / this_scheduler->SCHEDULER_LINK_RATE_BPS_;
         if (this_cct < best_cct || !best_scheduler) {
           best_cct = this_cct;
           best_scheduler = this_scheduler;
         }
       }
+      if (split_flow_ && is_critical) {
+        // cct of the coflow if the whole flow goes to best_scheduler.
+        double single_path_cct = best_cct;
+        for (Scheduler *this_scheduler:schedulers) {
+          Profile &profile = scheduler_profile[this_scheduler];
+          single_path_cct = max(single_path_cct,
+                                max(profile.max_src_sum_sec,
+                                    profile.max_dst_sum_sec));
+        }
+        if (SplitFlowIfBetter(flow, single_path_cct, schedulers,
+                              &scheduler_profile)) {
+          continue; // with next flow
+        }
+      }
       if (!is_critical && flow_order_mode_ != FlowOrderMode::FLOW_ORDER_BEST) {
         if (non_critical_mode_ == NON_CRITICAL_MIN_BN) {
           // best_scheduler remain the same, i.e. the switch with min bottleneck
         } else if (non_critical_mode_ == NON_CRITICAL_RATIO_LB) {
           // when this flow is not critical to effectively increase cct
           // regardless of its placement, we pick the switch with the
-          // min max(src_load, dst_load)/capacity on the flow's src and dst.
+          // min max(src_load/src_capacity, dst_load/dst_capacity) on the
+          // flow's src and dst.
           best_scheduler = nullptr;
           double best_ratio = -1;
           for (Scheduler *this_scheduler:schedulers) {
             Profile &profile = scheduler_profile[this_scheduler];
-            double load = max(profile.src_sum_bit[flow->GetSrc()],
-                              profile.dst_sum_bit[flow->GetDest()]);
-            double ratio = (flow->GetBitsLeft() + load) // projected load
-                / this_scheduler->SCHEDULER_LINK_RATE_BPS_;
+            // projected load
+            double ratio = max(
+                (flow->GetBitsLeft() + profile.src_sum_bit[flow->GetSrc()])
+                    / this_scheduler->GetSrcPortBps(flow->GetSrc()),
+                (flow->GetBitsLeft() + profile.dst_sum_bit[flow->GetDest()])
+                    / this_scheduler->GetDstPortBps(flow->GetDest()));
             if (best_ratio > ratio || !best_scheduler) {
               best_ratio = ratio;
               best_scheduler = this_scheduler;
@@ -215,19 +244,10 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
           }
         } else if (non_critical_mode_ == NON_CRITICAL_RANDOM) {
           int run_seed = 12;
-          int flow_unique_rand_seed = flow->GetParentCoflow()->GetJobId()
-              + flow->GetSrc() + flow->GetDest() + run_seed;
-          vector<Scheduler *> rv_values;
-          vector<int> rv_prob;
-          for (Scheduler *scheduler:schedulers) {
-            rv_values.push_back(scheduler);
-            // scale link rate to Mbps to fit in prob range of int
-            rv_prob.push_back(int(scheduler->SCHEDULER_LINK_RATE_BPS_ / 1e6));
-          }
-          std::discrete_distribution<int>
-              distribution(rv_prob.begin(), rv_prob.end());
-          std::mt19937 generator(flow_unique_rand_seed);
-          best_scheduler = rv_values[distribution(generator)];
+          // (parent coflow job id, flow index) is unique for each flow.
+          CounterRng generator(run_seed, flow->GetParentCoflow()->GetJobId(),
+                               flow->GetIndexInCoflow());
+          best_scheduler = schedulers[generator.Pick(cumulative_mbps)];
         } else {
           std::cerr << "WARNING: UNKNOWN non_critical_mode_"
                     << non_critical_mode_ << endl;
@@ -245,12 +265,7 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
       // update load to reflact current assignment
       Profile &profile = scheduler_profile[best_scheduler];
       profile.assigned_flows.push_back(flow);
-      profile.src_sum_bit[flow->GetSrc()] += flow->GetBitsLeft();
-      profile.dst_sum_bit[flow->GetDest()] += flow->GetBitsLeft();
-      profile.max_src_sum_bit = max(profile.max_src_sum_bit,
-                                    profile.src_sum_bit[flow->GetSrc()]);
-      profile.max_dst_sum_bit = max(profile.max_dst_sum_bit,
-                                    profile.dst_sum_bit[flow->GetDest()]);
+      AddBitsToProfile(best_scheduler, flow, flow->GetBitsLeft(), &profile);
       // debug
       if (debug_level_ >= 3) {
         cout << "[SchedulerWeaver::AssignCoflowsToSchedulers] "
@@ -271,29 +286,138 @@ void SchedulerWeaver::AssignCoflowsToSchedulers(
       }
     }
 
-    // perform logging if two nets
-    if (schedulers.size() == 2) {
-      for (auto &scheuler_profile_pair : scheduler_profile) {
-        if (!scheuler_profile_pair.second.assigned_flows.empty()) {
-          Scheduler *scheduler = scheuler_profile_pair.first;
-          bool is_on_main = (scheduler == schedulers_[0].get());
-          for (Flow *flow: scheuler_profile_pair.second.assigned_flows) {
-            long bits_on_main = is_on_main ? flow->GetBitsLeft() : 0L;
-            long bits_on_side = flow->GetBitsLeft() - bits_on_main;
-            flow->SetBitsThruHybrid(bits_on_main, bits_on_side);
-//            cout << flow->GetParentCoflow()->GetName() << " "
-//                 << flow->toString() << " assigned to " << scheduler->name_
-//                 << " bits_on_main " << bits_on_main << " bits_on_side "
-//                 << bits_on_side << endl;
-          }
-        }
+    // perform logging on bits through each net, where nets are indexed by the
+    // order of children schedulers.
+    for (int net_idx = 0; net_idx < schedulers_.size(); net_idx++) {
+      Scheduler *scheduler = schedulers_[net_idx].get();
+      if (!ContainsKey(scheduler_profile, scheduler)) continue;
+      for (Flow *flow: scheduler_profile[scheduler].assigned_flows) {
+        Flow *flow_to_log = flow->IsSubFlow() ? flow->GetParentFlow() : flow;
+        flow_to_log->AddBitsThruNetwork(net_idx, flow->GetBitsLeft());
+//        cout << flow->GetParentCoflow()->GetName() << " "
+//             << flow->toString() << " assigned to " << scheduler->name_
+//             << " net_idx " << net_idx << endl;
       }
-
-    }// if (schedulers.size() == 2)
+    }
 
   } // for parent in parent_coflows
 }
 
+bool SchedulerWeaver::SplitFlowIfBetter(
+    Flow *flow, double single_path_cct, const vector<Scheduler *> &schedulers,
+    map<Scheduler *, Profile> *scheduler_profile) {
+  long bits = flow->GetBitsLeft();
+  if (bits < 2 * MIN_SUB_FLOW_BITS_) return false;
+
+  // load on the flow's src and dst ports, if this flow is split, in bits at
+  // the rate of the slower of the two ports.
+  map<Scheduler *, double> port_load, port_rate;
+  for (Scheduler *scheduler:schedulers) {
+    Profile &profile = scheduler_profile->operator[](scheduler);
+    double src_bits = profile.src_sum_bit[flow->GetSrc()];
+    double dst_bits = profile.dst_sum_bit[flow->GetDest()];
+    long src_bps = scheduler->GetSrcPortBps(flow->GetSrc());
+    long dst_bps = scheduler->GetDstPortBps(flow->GetDest());
+    port_rate[scheduler] = min(src_bps, dst_bps);
+    port_load[scheduler] = src_bps == dst_bps ? max(src_bits, dst_bits)
+        : max(src_bits / src_bps, dst_bits / dst_bps) * port_rate[scheduler];
+  }
+  // water-fill the flow onto the candidate schedulers, in the ascending order
+  // of the time to drain its port load. Drop the candidate with the smallest
+  // share if any share is less than MIN_SUB_FLOW_BITS_.
+  vector<Scheduler *> candidates = schedulers;
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [&port_load, &port_rate](Scheduler *l, Scheduler *r) {
+                     return port_load[l] / port_rate[l]
+                         < port_load[r] / port_rate[r];
+                   });
+  map<Scheduler *, long> split_bits;
+  while (candidates.size() >= 2) {
+    double load_sum = 0, rate_sum = 0, level = 0;
+    int num_filled = 0;
+    for (Scheduler *scheduler:candidates) {
+      double drain_time = port_load[scheduler] / port_rate[scheduler];
+      if (num_filled > 0 && level <= drain_time) break;
+      load_sum += port_load[scheduler];
+      rate_sum += port_rate[scheduler];
+      level = (bits + load_sum) / rate_sum;
+      num_filled++;
+    }
+    split_bits.clear();
+    Scheduler *smallest_share = nullptr;
+    long bits_to_split = bits;
+    for (int idx = 0; idx < num_filled; idx++) {
+      Scheduler *scheduler = candidates[idx];
+      long share = idx == num_filled - 1 ? bits_to_split : min(
+          bits_to_split, long(level * port_rate[scheduler]
+                                  - port_load[scheduler]));
+      bits_to_split -= share;
+      split_bits[scheduler] = share;
+      if (!smallest_share || share < split_bits[smallest_share]) {
+        smallest_share = scheduler;
+      }
+    }
+    if (split_bits.size() < 2) return false;
+    if (split_bits[smallest_share] >= MIN_SUB_FLOW_BITS_) break; // while
+    candidates.erase(std::find(candidates.begin(), candidates.end(),
+                               smallest_share));
+    split_bits.clear();
+  }
+  if (split_bits.size() < 2) return false;
+
+  // cct of the coflow if the flow is split.
+  double split_cct = 0;
+  for (Scheduler *scheduler:schedulers) {
+    Profile &profile = scheduler_profile->operator[](scheduler);
+    double cct = max(profile.max_src_sum_sec, profile.max_dst_sum_sec);
+    if (ContainsKey(split_bits, scheduler)) {
+      long share = split_bits[scheduler];
+      cct = max(cct, max((profile.src_sum_bit[flow->GetSrc()] + share)
+                             / scheduler->GetSrcPortBps(flow->GetSrc()),
+                         (profile.dst_sum_bit[flow->GetDest()] + share)
+                             / scheduler->GetDstPortBps(flow->GetDest())));
+    }
+    split_cct = max(split_cct, cct);
+  }
+  if (split_cct >= single_path_cct) return false;
+
+  flow->assigned_scheduler_ = nullptr;
+  flow->assigned_scheduler_name_ = "";
+  for (Scheduler *scheduler:schedulers) {
+    if (!ContainsKey(split_bits, scheduler)) continue;
+    long share = split_bits[scheduler];
+    Flow *sub_flow = flow->CreateSubFlow(share);
+    sub_flow->assigned_scheduler_ = scheduler;
+    sub_flow->assigned_scheduler_name_ = scheduler->name_;
+    flow->assigned_scheduler_name_ +=
+        (flow->assigned_scheduler_name_.empty() ? "" : "+") + scheduler->name_;
+    Profile &profile = scheduler_profile->operator[](scheduler);
+    profile.assigned_flows.push_back(sub_flow);
+    AddBitsToProfile(scheduler, flow, share, &profile);
+  }
+  if (debug_level_ >= 3) {
+    cout << "[SchedulerWeaver::SplitFlowIfBetter] "
+         << flow->GetParentCoflow()->GetName() << " " << flow->toString()
+         << " split to " << flow->assigned_scheduler_name_
+         << ", cct " << single_path_cct << " -> " << split_cct << endl;
+  }
+  return true;
+}
+
+void SchedulerWeaver::AddBitsToProfile(Scheduler *scheduler, Flow *flow,
+                                       long bits, Profile *profile) {
+  double &src_sum_bit = profile->src_sum_bit[flow->GetSrc()];
+  double &dst_sum_bit = profile->dst_sum_bit[flow->GetDest()];
+  src_sum_bit += bits;
+  dst_sum_bit += bits;
+  profile->max_src_sum_sec =
+      max(profile->max_src_sum_sec,
+          src_sum_bit / scheduler->GetSrcPortBps(flow->GetSrc()));
+  profile->max_dst_sum_sec =
+      max(profile->max_dst_sum_sec,
+          dst_sum_bit / scheduler->GetDstPortBps(flow->GetDest()));
+}
+
 // sort sorted_flows, in place, based on compare, and then shuffle the flows in
 // the same range.
 template<typename Comparator>
@@ -303,7 +427,8 @@ void SchedulerWeaver::SortAndRangeShuffle(Coflow *parent,
   // first sort from
   std::stable_sort(sorted_flows->begin(), sorted_flows->end(), compare);
   // then shuffle each range
-  std::mt19937 engine(parent->coflow_rand_seed_);
+  CounterRng engine(parent->coflow_rand_seed_, parent->GetJobId(),
+                    CounterRng::COFLOW_STREAM);
   for (vector<Flow *>::iterator range_head = sorted_flows->begin();
        range_head != sorted_flows->end();) {
     std::pair<std::vector<Flow *>::iterator, std::vector<Flow *>::iterator>
@@ -341,25 +466,22 @@ void SchedulerWeightedRandom::AssignCoflowsToSchedulers(
     vector<Coflow *> &parent_coflows, vector<Scheduler *> &schedulers,
     map<Scheduler *, vector<Coflow *> *> *scheduler_to_children_coflows) {
 
-  vector<Scheduler *> rv_values;
-  vector<int> rv_prob;
+  // scale link rate to Mbps, cumulated for CounterRng::Pick().
+  vector<long> cumulative_mbps;
   for (Scheduler *scheduler:schedulers) {
-    rv_values.push_back(scheduler);
-    // scale link rate to Mbps to fit in prob range of int
-    rv_prob.push_back(int(scheduler->SCHEDULER_LINK_RATE_BPS_ / 1e6));
+    cumulative_mbps.push_back(
+        (cumulative_mbps.empty() ? 0 : cumulative_mbps.back())
+            + long(scheduler->SCHEDULER_LINK_RATE_BPS_ / 1e6));
   }
 
   for (Coflow *parent:parent_coflows) {
     map<Scheduler *, vector<Flow *>> scheduler_to_flows;
     for (Flow *flow: *parent->GetFlows()) {
       // we pick the switch propitonally to the link capacity.
-      // (parent coflow job id, src, dst) is unique for each coflow
-      int flow_unique_rand_seed = flow->GetParentCoflow()->GetJobId()
-          + flow->GetSrc() + flow->GetDest() + run_seed_;
-      std::mt19937 generator(flow_unique_rand_seed);
-      std::discrete_distribution<int>
-          distribution(rv_prob.begin(), rv_prob.end());
-      Scheduler *target_scheduler = rv_values[distribution(generator)];
+      // (parent coflow job id, flow index) is unique for each flow.
+      CounterRng generator(run_seed_, flow->GetParentCoflow()->GetJobId(),
+                           flow->GetIndexInCoflow());
+      Scheduler *target_scheduler = schedulers[generator.Pick(cumulative_mbps)];
       scheduler_to_flows[target_scheduler].push_back(flow);
       if (debug_level_ >= 2) {
         cout << flow->toString() << " assigned to " << target_scheduler->name_
@@ -2,32 +2,120 @@
 // Created by Xin Sunny Huang on 10/5/17.
 //
 
-#include <algorithm> // stable_sort
+#include <algorithm> // find, sort, stable_sort, unique
+#include <cassert>
+#include <cmath> // fabs, log
+#include <memory>
+#include <sys/time.h>
 
 #include "global.h"
+#include "profiler.h"
 #include "solver_infocom.h"
+#include "util.h"
 
-SolverInfocom::SolverInfocom(vector<Scheduler*>& schedulers, int debug_level)
-    : schedulers_(schedulers), debug_level_(debug_level) {}
+const int SolverInfocom::MAX_DENSE_ROUTE_VARS_ = 4000;
+const int SolverInfocom::MAX_ROUTE_COLUMNS_ = 1000;
+
+void MinCCTCache::Retain(const vector<Coflow*>& coflows) {
+  set<int> coflow_ids;
+  for (Coflow* coflow : coflows) {
+    coflow_ids.insert(coflow->GetCoflowId());
+  }
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (coflow_ids.count(it->first)) {
+      it++;
+    } else {
+      it = entries_.erase(it);
+    }
+  }
+}
+
+void MinCCTCache::Add(const vector<Coflow*>& coflows) {
+  for (Coflow* coflow : coflows) {
+    entries_[coflow->GetCoflowId()];
+  }
+}
+
+void MinCCTCache::Report(ostream& out) const {
+  long num_lookups = num_hits_ + num_misses_;
+  out << "[MinCCTCache] " << num_hits_ << " hits in " << num_lookups
+      << " lookups (" << (num_lookups > 0 ? 100.0 * num_hits_ / num_lookups : 0)
+      << "%), saved " << usec_saved_ / 1e6 << "s" << endl;
+}
+
+vector<long>& ReservationTable::MutableRow(int scheduler_idx, int port) {
+  shared_ptr<vector<long>>& row = rows_[scheduler_idx];
+  if (!row) {
+    row = std::make_shared<vector<long>>();
+  } else if (row.use_count() > 1) {
+    // shared with a snapshot.
+    row = std::make_shared<vector<long>>(*row);
+  }
+  if (port >= row->size()) {
+    row->resize(port + 1, 0L);
+  }
+  return *row;
+}
+
+SolverInfocom::SolverInfocom(vector<Scheduler*>& schedulers, int debug_level,
+                             WorkerPool* worker_pool,
+                             MinCCTCache* min_cct_cache,
+                             double approx_epsilon)
+    : schedulers_(schedulers), debug_level_(debug_level),
+      worker_pool_(worker_pool), min_cct_cache_(min_cct_cache),
+      approx_epsilon_(approx_epsilon) {}
 
 void SolverInfocom::ComputeRouteAndRatePaper(
     vector<Coflow*>& coflows, map<long, long>* rates,
-    map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-    map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps) {
+    ReservationTable* scheduler_src_reserved_bps,
+    ReservationTable* scheduler_dst_reserved_bps) {
 
-  set<Coflow*> unscheduled_coflows(coflows.begin(), coflows.end());
+  vector<Coflow*> unscheduled_coflows = coflows;
+  // models and cache entries are filled in by MinCCT().
+  for (Coflow* coflow: unscheduled_coflows) {
+    route_models_[coflow];
+  }
+  if (min_cct_cache_) min_cct_cache_->Add(unscheduled_coflows);
   while (!unscheduled_coflows.empty()) {
+    vector<double> ccts(unscheduled_coflows.size());
+    {
+      // coflows are evaluated independently, on a snapshot of the reserved
+      // bandwidth, which shares its rows with the tables until they change.
+      const ReservationTable src_snapshot = *scheduler_src_reserved_bps;
+      const ReservationTable dst_snapshot = *scheduler_dst_reserved_bps;
+      // tasks may run on other threads, under the path of this thread.
+      const string parent_path = Profiler::CurrentPath();
+      auto min_cct_task = [this, &unscheduled_coflows, &ccts,
+          &src_snapshot, &dst_snapshot, &parent_path](int idx) {
+        ScopedTimer timer(parent_path, "min_cct");
+        ccts[idx] = MinCCT(unscheduled_coflows[idx], src_snapshot,
+                           dst_snapshot);
+      };
+      if (worker_pool_) {
+        worker_pool_->ParallelFor((int) unscheduled_coflows.size(),
+                                  min_cct_task);
+      } else {
+        for (int idx = 0; idx < unscheduled_coflows.size(); idx++) {
+          min_cct_task(idx);
+        }
+      }
+    }
+
     Coflow* coflow_min = nullptr;
     double cct_min = -1;
-    for (Coflow* coflow: unscheduled_coflows) {
-      double cct = MinCCT(
-          coflow, *scheduler_src_reserved_bps, *scheduler_dst_reserved_bps);
+    for (int idx = 0; idx < unscheduled_coflows.size(); idx++) {
+      Coflow* coflow = unscheduled_coflows[idx];
+      double cct = ccts[idx];
       coflow->infocom_base_cct_ = cct;
       if (debug_level_ >= 1) {
         cout << coflow->GetName() << " solver_cct = " << cct << endl;
       }
-      if ((cct > 0 && cct < cct_min) || cct_min < 0) {
-        // we pick the coflow with smallest cct to schedule
+      if ((cct > 0 && (cct < cct_min || (
+          cct == cct_min
+              && coflow->GetCoflowId() < coflow_min->GetCoflowId())))
+          || cct_min < 0) {
+        // we pick the coflow with smallest cct to schedule, and the one with
+        // the smallest id on ties.
         cct_min = cct;
         coflow_min = coflow;
       }
@@ -55,27 +143,27 @@ void SolverInfocom::ComputeRouteAndRatePaper(
              << " rate " << rate << endl;
       }
       rates->operator[](flow->GetFlowId()) = rate;
-      Scheduler* scheduler = flow->assigned_scheduler_;
-      int src = flow->GetSrc(), dst = flow->GetDest();
-      scheduler_src_reserved_bps->operator[](std::make_pair(scheduler, src)) +=
-          rate;
-      scheduler_dst_reserved_bps->operator[](std::make_pair(scheduler, dst)) +=
-          rate;
+      int scheduler_idx = SchedulerIdx(flow->assigned_scheduler_);
+      scheduler_src_reserved_bps->Add(scheduler_idx, flow->GetSrc(), rate);
+      scheduler_dst_reserved_bps->Add(scheduler_idx, flow->GetDest(), rate);
     }
     if (debug_level_ >= 1) {
       cout << "[SolverInfocom::ComputeRouteAndRatePaper] Scheduled "
            << coflow_min->GetName() << " with cct = " << cct_min << endl;
     }
-    unscheduled_coflows.erase(coflow_min);
+    unscheduled_coflows.erase(std::find(unscheduled_coflows.begin(),
+                                        unscheduled_coflows.end(),
+                                        coflow_min));
   }
 }
 void SolverInfocom::ComputeRouteAndRateSunny(
     vector<Coflow*>& coflows, map<long, long>* rates,
-    map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-    map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps) {
+    ReservationTable* scheduler_src_reserved_bps,
+    ReservationTable* scheduler_dst_reserved_bps) {
   // calculate cct as if each coflow is the only one in the network.
   for (Coflow* coflow: coflows) {
-    map<pair<Scheduler*, int>, long> no_src_reserved_bps, no_dst_reserved_bps;
+    ReservationTable no_src_reserved_bps(schedulers_.size()),
+        no_dst_reserved_bps(schedulers_.size());
     double cct = MinCCT(coflow, no_src_reserved_bps, no_dst_reserved_bps);
     coflow->infocom_base_cct_ = cct;
   }
@@ -104,12 +192,9 @@ void SolverInfocom::ComputeRouteAndRateSunny(
         continue;
       }
       rates->operator[](flow->GetFlowId()) = rate;
-      Scheduler* scheduler = flow->assigned_scheduler_;
-      int src = flow->GetSrc(), dst = flow->GetDest();
-      scheduler_src_reserved_bps->operator[](std::make_pair(scheduler, src)) +=
-          rate;
-      scheduler_dst_reserved_bps->operator[](std::make_pair(scheduler, dst)) +=
-          rate;
+      int scheduler_idx = SchedulerIdx(flow->assigned_scheduler_);
+      scheduler_src_reserved_bps->Add(scheduler_idx, flow->GetSrc(), rate);
+      scheduler_dst_reserved_bps->Add(scheduler_idx, flow->GetDest(), rate);
     }
     if (debug_level_ >= 2) {
       cout << "Scheduled " << coflow->GetName() << " with cct " << cct << endl;
@@ -121,194 +206,740 @@ void SolverInfocom::ComputeRouteAndRateSunny(
 void SolverInfocom::ComputeRouteAndRate(vector<Coflow*>& coflows,
                                         map<long, long>* rates) {
 
-  map<pair<Scheduler*, int>, long> scheduler_src_reserved_bps;
-  map<pair<Scheduler*, int>, long> scheduler_dst_reserved_bps;
+  ReservationTable scheduler_src_reserved_bps(schedulers_.size());
+  ReservationTable scheduler_dst_reserved_bps(schedulers_.size());
+  // bits of flows may have changed since the last call.
+  route_models_.clear();
+  if (min_cct_cache_) {
+    min_cct_cache_->Retain(coflows);
+  }
 
-  // ComputeRouteAndRateSunny v.s. ComputeRouteAndRatePaper
-  ComputeRouteAndRatePaper(coflows, rates, &scheduler_src_reserved_bps,
-                           &scheduler_dst_reserved_bps);
-  // Work conservation
-  DistributeBandwidth(coflows, rates,
-                      &scheduler_src_reserved_bps,
-                      &scheduler_dst_reserved_bps);
+  {
+    // ComputeRouteAndRateSunny v.s. ComputeRouteAndRatePaper
+    ScopedTimer timer("rate_control");
+    ComputeRouteAndRatePaper(coflows, rates, &scheduler_src_reserved_bps,
+                             &scheduler_dst_reserved_bps);
+  }
+  {
+    // Work conservation
+    ScopedTimer timer("work_conservation");
+    DistributeBandwidth(coflows, rates,
+                        &scheduler_src_reserved_bps,
+                        &scheduler_dst_reserved_bps);
+  }
 
   IsValidRates(coflows, *rates, true/*exit_if_invalid*/,
                debug_level_);
+
+  if (INFOCOM_STICKY_ROUTING) {
+    // coflows keep their route once they get rates.
+    for (Coflow* coflow : coflows) {
+      if (!coflow->has_route_) continue;
+      for (Flow* flow : *coflow->GetFlows()) {
+        if (ContainsKey(*rates, flow->GetFlowId())) {
+          coflow->infocom_sticky_route_ = true;
+          break;
+        }
+      }
+    }
+  }
 }
 
 double SolverInfocom::MinCCT(
     Coflow* coflow,
-    const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-    const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps) {
+    const ReservationTable& scheduler_src_reserved_bps,
+    const ReservationTable& scheduler_dst_reserved_bps) {
+  if (INFOCOM_STICKY_ROUTING && coflow->infocom_sticky_route_) {
+    // flows keep their schedulers, only the cct changes.
+    return FindCCTGivenRoute(coflow, scheduler_src_reserved_bps,
+                             scheduler_dst_reserved_bps);
+  }
+  MinCCTCache::Entry* entry = nullptr;
+  MinCCTCache::Entry lookup;
+  if (min_cct_cache_) {
+    // find() instead of [], as this may run on the worker pool. Entries are
+    // added beforehand by Add(), and a coflow without one skips the cache.
+    auto id_entry = min_cct_cache_->entries_.find(coflow->GetCoflowId());
+    if (id_entry != min_cct_cache_->entries_.end()) {
+      entry = &id_entry->second;
+    }
+  }
+  if (entry) {
+    FingerprintMinCCT(coflow, scheduler_src_reserved_bps,
+                      scheduler_dst_reserved_bps, &lookup);
+    int num_flows_with_demand = 0;
+    for (Flow* flow : *coflow->GetFlows()) {
+      if (flow->HasDemand()) num_flows_with_demand++;
+    }
+    if (entry->valid
+        && entry->demand_fingerprint == lookup.demand_fingerprint
+        && entry->residual_bps == lookup.residual_bps
+        && (!entry->has_route
+            || entry->route.size() == num_flows_with_demand)) {
+      min_cct_cache_->num_hits_++;
+      min_cct_cache_->usec_saved_ += entry->compute_usec;
+      int flow_idx = 0;
+      for (Flow* flow : *coflow->GetFlows()) {
+        flow->assigned_scheduler_ = nullptr;
+        if (flow->HasDemand() && entry->has_route) {
+          flow->assigned_scheduler_ = schedulers_[entry->route[flow_idx++]];
+        }
+      }
+      coflow->has_route_ = entry->has_route;
+      return entry->cct;
+    }
+    min_cct_cache_->num_misses_++;
+  }
+
+  struct timeval start_time;
+  gettimeofday(&start_time, NULL);
+  double cct = -1;
   if (FindRoute(coflow,
                 scheduler_src_reserved_bps, scheduler_dst_reserved_bps)) {
-    return FindCCTGivenRoute(coflow,
-                             scheduler_src_reserved_bps,
-                             scheduler_dst_reserved_bps,
-                             debug_level_);
+    cct = FindCCTGivenRoute(coflow,
+                            scheduler_src_reserved_bps,
+                            scheduler_dst_reserved_bps);
+  }
+
+  if (entry) {
+    struct timeval end_time;
+    gettimeofday(&end_time, NULL);
+    lookup.valid = true;
+    lookup.has_route = coflow->has_route_;
+    if (lookup.has_route) {
+      for (Flow* flow : *coflow->GetFlows()) {
+        if (flow->HasDemand()) {
+          lookup.route.push_back(SchedulerIdx(flow->assigned_scheduler_));
+        }
+      }
+    }
+    lookup.cct = cct;
+    lookup.compute_usec = long(secondPass(end_time, start_time) * 1e6);
+    *entry = std::move(lookup);
+  }
+  return cct;
+}
+
+void SolverInfocom::FingerprintMinCCT(
+    Coflow* coflow,
+    const ReservationTable& scheduler_src_reserved_bps,
+    const ReservationTable& scheduler_dst_reserved_bps,
+    MinCCTCache::Entry* entry) const {
+  // FNV-1a over (flow id, bits left).
+  unsigned long fingerprint = 14695981039346656037UL;
+  vector<int> srcs, dsts;
+  for (Flow* flow : *coflow->GetFlows()) {
+    if (!flow->HasDemand()) continue;
+    for (long value : {(long) flow->GetFlowId(), flow->GetBitsLeft()}) {
+      fingerprint = (fingerprint ^ (unsigned long) value) * 1099511628211UL;
+    }
+    srcs.push_back(flow->GetSrc());
+    dsts.push_back(flow->GetDest());
+  }
+  entry->demand_fingerprint = fingerprint;
+
+  std::sort(srcs.begin(), srcs.end());
+  srcs.erase(std::unique(srcs.begin(), srcs.end()), srcs.end());
+  std::sort(dsts.begin(), dsts.end());
+  dsts.erase(std::unique(dsts.begin(), dsts.end()), dsts.end());
+  entry->residual_bps.clear();
+  for (int idx = 0; idx < schedulers_.size(); idx++) {
+    Scheduler* scheduler = schedulers_[idx];
+    for (int src : srcs) {
+      entry->residual_bps.push_back(scheduler->GetSrcPortBps(src)
+                                    - scheduler_src_reserved_bps.Get(idx, src));
+    }
+    for (int dst : dsts) {
+      entry->residual_bps.push_back(scheduler->GetDstPortBps(dst)
+                                    - scheduler_dst_reserved_bps.Get(idx, dst));
+    }
   }
-  return -1;
 }
 
 bool SolverInfocom::FindRoute(
     Coflow* coflow,
-    const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-    const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps) {
+    const ReservationTable& scheduler_src_reserved_bps,
+    const ReservationTable& scheduler_dst_reserved_bps,
+    double* solved_alpha) {
   // clear routing info
   for (Flow* flow: *coflow->GetFlows()) {
     flow->assigned_scheduler_ = nullptr;
   }
   coflow->has_route_ = false;
-  try {
-    GRBEnv env = GRBEnv();
 
-    GRBModel model = GRBModel(env);
+  RouteModel* route_model = GetRouteModel(coflow);
+  if (route_model->by_columns && !route_model->routings.empty()) {
+    // routings of earlier rounds would lead the column generation to another
+    // optimal routing than a cold start, so it starts over.
+    BuildRouteLp(route_model);
+  }
+  LpSolver* model = route_model->model.get();
+  auto set_rhs = [route_model, model](int row, double rhs) {
+    if (model) {
+      model->SetRhs(row, rhs);
+    } else {
+      route_model->rhs[row] = rhs;
+    }
+  };
+  // inbound and outbound cap on the residual bandwidth.
+  for (const auto& tuple: route_model->src_rows) {
+    Scheduler* scheduler = tuple.first.first;
+    int src = tuple.first.second;
+    long residual_bps = scheduler->GetSrcPortBps(src)
+        - scheduler_src_reserved_bps.Get(SchedulerIdx(scheduler), src);
+    set_rhs(tuple.second, residual_bps / 1e9);
+    if (debug_level_ >= 3) {
+      cout << "Set constraints " << scheduler->name_ << " src " << src
+           << " with residual_bps = " << residual_bps << endl;
+    }
+  }
+  for (const auto& tuple: route_model->dst_rows) {
+    Scheduler* scheduler = tuple.first.first;
+    int dst = tuple.first.second;
+    long residual_bps = scheduler->GetDstPortBps(dst)
+        - scheduler_dst_reserved_bps.Get(SchedulerIdx(scheduler), dst);
+    set_rhs(tuple.second, residual_bps / 1e9);
+    if (debug_level_ >= 3) {
+      cout << "Set constraints " << scheduler->name_ << " dst " << dst
+           << " with residual_bps = " << residual_bps << endl;
+    }
+  }
 
-    if (debug_level_ == 0) {
-      model.getEnv().set(GRB_IntParam_OutputFlag, 0); // Gurobi output
+  const vector<Flow*>& flows = route_model->flows;
+  // (m_j_k) of each flow, i.e. routing, indexed by flow, then by scheduler
+  // in schedulers_.
+  vector<vector<double>> flow_to_scheduler_m(
+      flows.size(), vector<double>(schedulers_.size(), 0.0));
+  double alpha = 0;
+  LpSolver::Status status;
+  {
+    ScopedTimer timer(model ? "lp_solve" : "approx_solve");
+    status =
+        !model ? SolveRouteApprox(route_model, &flow_to_scheduler_m, &alpha) :
+        route_model->by_columns ?
+        SolveRouteByColumns(route_model, &flow_to_scheduler_m, &alpha) :
+        SolveRouteLp(route_model, &flow_to_scheduler_m, &alpha);
+  }
+  if (status == LpSolver::LP_OPTIMAL) {
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      Flow* flow = flows[flow_idx];
+      Scheduler* best_scheduler = nullptr;
+      double best_m = -1;
+      if (debug_level_ >= 4) {
+        cout << flow->toString() << endl; // debug
+      }
+      for (int idx = 0; idx < schedulers_.size(); idx++) {
+        Scheduler* scheduler = schedulers_[idx];
+        double m = flow_to_scheduler_m[flow_idx][idx];
+        // debug
+        if (debug_level_ >= 4) {
+          cout << "     " << scheduler->name_ << ", m=" << m << ", "
+               << "m_" + to_string(flow->GetFlowId()) + "_" + scheduler->name_
+               << endl;
+        }
+        // m within the tolerance of the backends ties, to the first.
+        if (best_m < 0 || m > best_m + 1e-6 * alpha) {
+          best_scheduler = scheduler;
+          best_m = m;
+        }
+      } // for schedulers
+      assert(best_scheduler);
+      flow->assigned_scheduler_ = best_scheduler;
+      if (debug_level_ >= 4) {
+        cout << coflow->GetName() << " " << flow->toString()
+             << " assigned to " << best_scheduler->name_ << endl;
+      }
+    }
+    coflow->has_route_ = true;
+    if (solved_alpha) *solved_alpha = alpha;
+    if (debug_level_ >= 2) {
+      cout << coflow->GetName() << " solver_cct = "
+           << 1 / alpha << " (could be infeasible)\n";
     }
+    return true;
+  } else if (status != LpSolver::LP_ERROR) {
+    cerr << " NOT feasible\n";
+    return false;
+  }
+  cout << "By default: NOT feasible\n";
+  return false;
+}
 
-    // variable : alpha = 1/cct
-    GRBVar alpha = model.addVar(0.0, GRB_INFINITY, 0.0, GRB_CONTINUOUS, "a");
+double SolverInfocom::TieBreakObj(int flow_idx, int scheduler_idx) const {
+  // Prefer the slower schedulers, which leaves the faster ones to the
+  // coflows routed after, and rounds better in FindRoute().
+  long max_rate_bps = 1;
+  for (Scheduler* scheduler : schedulers_) {
+    max_rate_bps = std::max(max_rate_bps, scheduler->SCHEDULER_LINK_RATE_BPS_);
+  }
+  double obj = 2 - (double) schedulers_[scheduler_idx]->SCHEDULER_LINK_RATE_BPS_
+      / max_rate_bps;
+  // Flows differ by a splitmix64 of the pair, so that no two routings tie.
+  uint64_t z = (uint64_t) flow_idx * schedulers_.size() + scheduler_idx + 1;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return obj + 1e-3 * (z >> 11) / 9007199254740992.0; // 2^53
+}
 
-    // containers for (m_j_k), i.e. routing
-    map<pair<Scheduler*, int>, vector<pair<GRBVar, double>>,
-        AscendingSchedulerPort> scheduler_src_to_vars_m_v;
-    map<pair<Scheduler*, int>, vector<pair<GRBVar, double>>,
-        AscendingSchedulerPort> scheduler_dst_to_vars_m_v;
-    map<Flow*, map<Scheduler*, GRBVar>,
-        AscendingFlowOnCoflowIdSrcDst> flow_to_scheduler_var_m;
+SolverInfocom::RouteModel* SolverInfocom::GetRouteModel(Coflow* coflow) {
+  // find() instead of [], as this may run on the worker pool.
+  auto coflow_model = route_models_.find(coflow);
+  if (coflow_model == route_models_.end()) {
+    coflow_model = route_models_.insert(
+        std::make_pair(coflow, unique_ptr<RouteModel>())).first;
+  }
+  unique_ptr<RouteModel>& route_model = coflow_model->second;
+  if (route_model) {
+    return route_model.get();
+  }
+  ScopedTimer timer("lp_build");
+  route_model.reset(new RouteModel);
+  for (Flow* flow: *coflow->GetFlows()) {
+    if (flow->HasDemand()) route_model->flows.push_back(flow);
+  }
+  std::stable_sort(route_model->flows.begin(), route_model->flows.end(),
+                   AscendingFlowOnCoflowIdSrcDst());
 
-    for (Flow* flow: *coflow->GetFlows()) {
-      if (!flow->HasDemand()) {
-        continue;
+  // Add constraints: inbound and outbound cap, whose right-hand sides are set
+  // by FindRoute(). Variables fill in the constraints later.
+  for (Flow* flow : route_model->flows) {
+    for (Scheduler* scheduler : schedulers_) {
+      route_model->src_rows[std::make_pair(scheduler, flow->GetSrc())] = -1;
+      route_model->dst_rows[std::make_pair(scheduler, flow->GetDest())] = -1;
+    }
+  }
+  route_model->by_columns = false;
+  route_model->alpha_floor_row = -1;
+  route_model->alpha_var = -1;
+  if (approx_epsilon_ > 0) {
+    // constraints are only numbered, without a LP.
+    int num_rows = 0;
+    for (auto& tuple: route_model->src_rows) tuple.second = num_rows++;
+    for (auto& tuple: route_model->dst_rows) tuple.second = num_rows++;
+    route_model->rhs.resize(num_rows);
+    for (Flow* flow : route_model->flows) {
+      route_model->flow_to_scheduler_rows.emplace_back();
+      for (Scheduler* scheduler : schedulers_) {
+        route_model->flow_to_scheduler_rows.back().push_back(std::make_pair(
+            route_model->src_rows[std::make_pair(scheduler, flow->GetSrc())],
+            route_model->dst_rows[std::make_pair(scheduler, flow->GetDest())]));
       }
-      for (Scheduler* scheduler  : schedulers_) {
-        GRBVar m = model.addVar(
-            0.0, GRB_INFINITY, 0.0, GRB_CONTINUOUS,
-            "m_" + to_string(flow->GetFlowId()) + "_" + scheduler->name_);
+    }
+    return route_model.get();
+  }
+
+  BuildRouteLp(route_model.get());
+  LpSolver* model = route_model->model.get();
+  route_model->by_columns = !model->IsSparse() &&
+      route_model->flows.size() * schedulers_.size() > MAX_DENSE_ROUTE_VARS_;
+  return route_model.get();
+}
+
+void SolverInfocom::BuildRouteLp(RouteModel* route_model) {
+  route_model->model.reset(LpSolver::Create(LP_SOLVER_NAME, debug_level_));
+  LpSolver* model = route_model->model.get();
+  route_model->alpha_var = -1;
+  route_model->flow_to_scheduler_var_m.clear();
+  route_model->routings.clear();
+  route_model->routing_vars.clear();
+  // Set objective: maximize 1/cct, or minimize cct
+  model->SetMaximize(true);
+  for (auto& tuple: route_model->src_rows) {
+    tuple.second = model->AddConstr(
+        {}, LpSolver::LP_LESS_EQUAL, 0.0, debug_level_ >= 4 ?
+        "Csrc_" + tuple.first.first->name_ + "_" + to_string(tuple.first.second)
+        : "");
+  }
+  for (auto& tuple: route_model->dst_rows) {
+    tuple.second = model->AddConstr(
+        {}, LpSolver::LP_LESS_EQUAL, 0.0, debug_level_ >= 4 ?
+        "Cdst_" + tuple.first.first->name_ + "_" + to_string(tuple.first.second)
+        : "");
+  }
+  // a slack basis, as alpha >= 0 anyway until the second objective.
+  route_model->alpha_floor_row = model->AddConstr(
+      {}, LpSolver::LP_LESS_EQUAL, 0.0, debug_level_ >= 4 ? "Calpha" : "");
+}
+
+LpSolver::Status SolverInfocom::SolveRouteLp(
+    RouteModel* route_model,
+    vector<vector<double>>* flow_to_scheduler_m, double* alpha) {
+  LpSolver* model = route_model->model.get();
+  const vector<Flow*>& flows = route_model->flows;
+  vector<vector<int>>& flow_to_scheduler_var_m =
+      route_model->flow_to_scheduler_var_m;
+  if (route_model->alpha_var < 0) {
+    // variable : alpha = 1/cct
+    route_model->alpha_var = model->AddVar(
+        0.0, LpSolver::INFINITY_BOUND, 1.0, "a",
+        {std::make_pair(route_model->alpha_floor_row, -1.0)});
+    flow_to_scheduler_var_m.resize(flows.size());
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      Flow* flow = flows[flow_idx];
+      // Add constraint: one path per flow, i.e. sum(m) - alpha == 0
+      int flow_row = model->AddConstr(
+          {std::make_pair(route_model->alpha_var, -1.0)}, LpSolver::LP_EQUAL,
+          0.0, debug_level_ >= 4 ? "Cflow_" + to_string(flow->GetFlowId())
+                                 : "");
+      for (Scheduler* scheduler : schedulers_) {
         // we use Gbits for variable v
-        scheduler_src_to_vars_m_v[
-            std::make_pair(scheduler, flow->GetSrc())].push_back(
-            std::make_pair(m, flow->GetBitsLeft() / 1e9));
-        scheduler_dst_to_vars_m_v[
-            std::make_pair(scheduler, flow->GetDest())].push_back(
-            std::make_pair(m, flow->GetBitsLeft() / 1e9));
-        flow_to_scheduler_var_m[flow][scheduler] = m;
-      }
-    }
-
-    // Integrate new variables
-    model.update();
-
-    // Set objective: maximize 1/cct, or minimize cct
-    GRBLinExpr obj = alpha;
-    model.setObjective(obj, GRB_MAXIMIZE);
-
-    // Add constraint: inbound cap
-    for (const auto& tuple: scheduler_src_to_vars_m_v) {
-      Scheduler* scheduler = tuple.first.first;
-      int src = tuple.first.second;
-      GRBLinExpr constraint;
-      for (const auto& m_v_pair:tuple.second) {
-        constraint += m_v_pair.first * m_v_pair.second;
-      }
-      long residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          scheduler_src_reserved_bps, std::make_pair(scheduler, src), 0L);
-      model.addConstr(constraint <= residual_bps / 1e9,
-                      "Csrc_" + scheduler->name_ + "_" + to_string(src));
-      if (debug_level_ >= 3) {
-        cout << "Added constraints " << scheduler->name_ << " src " << src
-             << " with residual_bps = " << residual_bps << endl;
-      }
-    }
-
-    // Add constraint: outbound cap
-    for (const auto& tuple: scheduler_dst_to_vars_m_v) {
-      Scheduler* scheduler = tuple.first.first;
-      int dst = tuple.first.second;
-      GRBLinExpr constraint;
-      for (const auto& m_v_pair:tuple.second) {
-        constraint += m_v_pair.first * m_v_pair.second;
-      }
-      long residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          scheduler_dst_reserved_bps, std::make_pair(scheduler, dst), 0L);
-      model.addConstr(constraint <= residual_bps / 1e9,
-                      "Cdst_" + scheduler->name_ + "_" + to_string(dst));
-      if (debug_level_ >= 3) {
-        cout << "Added constraints " << scheduler->name_ << " dst " << dst
-             << " with residual_bps = " << residual_bps << endl;
-      }
-    }
-
-    // Add constraint: one path per flow
-    for (const auto& flow_vars : flow_to_scheduler_var_m) {
-      Flow* flow = flow_vars.first;
-      GRBLinExpr constraint;
-      for (const auto& scheduler_var_pair : flow_vars.second) {
-        constraint += scheduler_var_pair.second;
-      }
-      model.addConstr(constraint == alpha,
-                      "Cflow_" + to_string(flow->GetFlowId()));
-    }
-
-    // Optimize model
-    model.optimize();
-
-    if (model.get(GRB_IntAttr_Status) == GRB_OPTIMAL) {
-      for (const auto& flow_map_pair : flow_to_scheduler_var_m) {
-        Flow* flow = flow_map_pair.first;
-        Scheduler* best_scheduler = nullptr;
-        double best_m = -1;
-        if (debug_level_ >= 4) {
-          cout << flow->toString() << endl; // debug
+        double v = flow->GetBitsLeft() / 1e9;
+        int m = model->AddVar(
+            0.0, LpSolver::INFINITY_BOUND, 0.0, debug_level_ >= 4 ?
+            "m_" + to_string(flow->GetFlowId()) + "_" + scheduler->name_ : "",
+            {std::make_pair(route_model->src_rows[std::make_pair(
+                scheduler, flow->GetSrc())], v),
+             std::make_pair(route_model->dst_rows[std::make_pair(
+                 scheduler, flow->GetDest())], v),
+             std::make_pair(flow_row, 1.0)});
+        flow_to_scheduler_var_m[flow_idx].push_back(m);
+      }
+    }
+  }
+
+  // Optimize model
+  LpSolver::Status status = model->Optimize();
+  if (status != LpSolver::LP_OPTIMAL) return status;
+  *alpha = model->GetValue(route_model->alpha_var);
+
+  // second objective, with alpha held at its optimum.
+  model->SetRhs(route_model->alpha_floor_row, -*alpha * (1 - 1e-9));
+  model->SetObj(route_model->alpha_var, 0.0);
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    for (int idx = 0; idx < schedulers_.size(); idx++) {
+      model->SetObj(flow_to_scheduler_var_m[flow_idx][idx],
+                    TieBreakObj(flow_idx, idx));
+    }
+  }
+  status = model->Optimize();
+  if (status == LpSolver::LP_OPTIMAL) {
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      for (int idx = 0; idx < schedulers_.size(); idx++) {
+        (*flow_to_scheduler_m)[flow_idx][idx] =
+            model->GetValue(flow_to_scheduler_var_m[flow_idx][idx]);
+      }
+    }
+  }
+
+  // back to alpha for the next round.
+  model->SetRhs(route_model->alpha_floor_row, 0.0);
+  model->SetObj(route_model->alpha_var, 1.0);
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    for (int idx = 0; idx < schedulers_.size(); idx++) {
+      model->SetObj(flow_to_scheduler_var_m[flow_idx][idx], 0.0);
+    }
+  }
+  return status;
+}
+
+LpSolver::Status SolverInfocom::SolveRouteByColumns(
+    RouteModel* route_model,
+    vector<vector<double>>* flow_to_scheduler_m, double* alpha) {
+  // Each column is a full routing of the coflow, which adds 1 to alpha and
+  // the bits of flows to their ports. The new column with the most reduced
+  // cost routes each flow through the scheduler with the least dual price on
+  // the flow's src and dst. FindRoute() starts each solve without routings.
+  LpSolver* model = route_model->model.get();
+  const vector<Flow*>& flows = route_model->flows;
+  vector<vector<int>>& routings = route_model->routings;
+  vector<int>& routing_vars = route_model->routing_vars;
+  LpSolver::Status status = model->Optimize();
+  while (status == LpSolver::LP_OPTIMAL) {
+    if (routings.size() >= MAX_ROUTE_COLUMNS_) {
+      if (debug_level_ >= 1) {
+        cout << "[SolverInfocom::SolveRouteByColumns] stops at "
+             << routings.size() << " routings" << endl;
+      }
+      break;
+    }
+    vector<int> routing(flows.size());
+    double reduced_cost = 1.0;
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      Flow* flow = flows[flow_idx];
+      int best_idx = -1;
+      double best_price = -1;
+      for (int idx = 0; idx < schedulers_.size(); idx++) {
+        Scheduler* scheduler = schedulers_[idx];
+        double price = model->GetDual(route_model->src_rows[std::make_pair(
+            scheduler, flow->GetSrc())]) + model->GetDual(
+            route_model->dst_rows[std::make_pair(scheduler, flow->GetDest())]);
+        // break ties by the link rate, e.g. on the first column.
+        if (best_idx < 0 || price < best_price - 1e-12
+            || (price < best_price + 1e-12
+                && scheduler->SCHEDULER_LINK_RATE_BPS_
+                    > schedulers_[best_idx]->SCHEDULER_LINK_RATE_BPS_)) {
+          best_idx = idx;
+          best_price = price;
         }
-        for (const auto& scheduler_var_m:flow_map_pair.second) {
-          Scheduler* scheduler = scheduler_var_m.first;
-          double scheduler_m = scheduler_var_m.second.get(GRB_DoubleAttr_X);
-          // debug
-          if (debug_level_ >= 4) {
-            cout << "     " << scheduler->name_ << ", m=" << scheduler_m << ", "
-                 << scheduler_var_m.second.get(GRB_StringAttr_VarName) << endl;
-          }
-          if (best_m < scheduler_m || best_m < 0) {
-            best_scheduler = scheduler;
-            best_m = scheduler_m;
-          }
-        } // for schedulers
-        assert(best_scheduler);
-        flow->assigned_scheduler_ = best_scheduler;
-        if (debug_level_ >= 4) {
-          cout << coflow->GetName() << " " << flow->toString()
-               << " assigned to " << best_scheduler->name_ << endl;
+      }
+      routing[flow_idx] = best_idx;
+      reduced_cost -= best_price * flow->GetBitsLeft() / 1e9;
+    }
+    if (reduced_cost <= 1e-9) {
+      break; // optimal
+    }
+    // we use Gbits for the load on ports
+    map<int, double> row_to_load;
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      Flow* flow = flows[flow_idx];
+      Scheduler* scheduler = schedulers_[routing[flow_idx]];
+      row_to_load[route_model->src_rows[std::make_pair(
+          scheduler, flow->GetSrc())]] += flow->GetBitsLeft() / 1e9;
+      row_to_load[route_model->dst_rows[std::make_pair(
+          scheduler, flow->GetDest())]] += flow->GetBitsLeft() / 1e9;
+    }
+    routing_vars.push_back(model->AddVar(
+        0.0, LpSolver::INFINITY_BOUND, 1.0,
+        debug_level_ >= 4 ? "r_" + to_string(routings.size()) : "",
+        vector<pair<int, double>>(row_to_load.begin(), row_to_load.end())));
+    routings.push_back(routing);
+    status = model->Optimize();
+  }
+  if (status != LpSolver::LP_OPTIMAL) return status;
+
+  *alpha = model->GetObjValue();
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    for (int column_idx = 0; column_idx < routings.size(); column_idx++) {
+      (*flow_to_scheduler_m)[flow_idx][routings[column_idx][flow_idx]] +=
+          model->GetValue(routing_vars[column_idx]);
+    }
+  }
+  return status;
+}
+
+LpSolver::Status SolverInfocom::SolveRouteApprox(
+    RouteModel* route_model,
+    vector<vector<double>>* flow_to_scheduler_m, double* alpha) {
+  // Each flow is a commodity whose paths are the schedulers, each going
+  // through the (scheduler, src) and (scheduler, dst) constraints. Every
+  // phase routes the demand of each flow over its shortest path, and
+  // lengthens the constraints it goes through by (1 + epsilon * routed /
+  // capacity). The routed flow, scaled down to fit the capacities, is a
+  // lower bound of alpha, and sum(capacity * length) / sum(demand * shortest
+  // path length) an upper bound. Phases stop once the bounds are within
+  // epsilon, or at the end of Garg-Konemann, i.e. when sum(capacity * length)
+  // reaches 1 from initial lengths of delta / capacity.
+  const double epsilon = approx_epsilon_;
+  const vector<Flow*>& flows = route_model->flows;
+  const vector<vector<pair<int, int>>>& flow_to_scheduler_rows =
+      route_model->flow_to_scheduler_rows;
+  // we use Gbps for capacities and Gbits for demands.
+  const vector<double>& capacity = route_model->rhs;
+  int num_rows = capacity.size();
+  for (double cap : capacity) {
+    if (cap < 0) return LpSolver::LP_INFEASIBLE;
+  }
+
+  // Scale demands to route each flow through the scheduler with the most
+  // residual bandwidth on its src and dst, so that the optimal alpha of the
+  // scaled demands is at least 1.
+  vector<double> demand(flows.size());
+  vector<double> load(num_rows, 0.0);
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    demand[flow_idx] = flows[flow_idx]->GetBitsLeft() / 1e9;
+    const pair<int, int>* best_rows = nullptr;
+    double best_cap = 0;
+    for (const pair<int, int>& rows : flow_to_scheduler_rows[flow_idx]) {
+      double cap = std::min(capacity[rows.first], capacity[rows.second]);
+      if (cap > best_cap) {
+        best_rows = &rows;
+        best_cap = cap;
+      }
+    }
+    if (!best_rows) {
+      *alpha = 0; // no residual bandwidth for the flow.
+      return LpSolver::LP_OPTIMAL;
+    }
+    load[best_rows->first] += demand[flow_idx];
+    load[best_rows->second] += demand[flow_idx];
+  }
+  double scale = -1;
+  for (int row = 0; row < num_rows; row++) {
+    if (load[row] > 0 && (scale < 0 || capacity[row] / load[row] < scale)) {
+      scale = capacity[row] / load[row];
+    }
+  }
+  for (double& flow_demand : demand) flow_demand *= scale;
+
+  // Lengths start at 1 / capacity instead of delta / capacity, kept in range
+  // by rescaling, as only their ratios matter. log_delta_scale is the log of
+  // the factor from these lengths to Garg-Konemann's.
+  vector<double> length(num_rows, 0.0);
+  for (int row = 0; row < num_rows; row++) {
+    if (capacity[row] > 0) length[row] = 1 / capacity[row];
+  }
+  double log_delta_scale = -log(num_rows / (1 - epsilon)) / epsilon;
+  // shortest path of a flow over schedulers with residual bandwidth.
+  auto shortest_path = [&](int flow_idx, double* path_length) {
+    int best_idx = -1;
+    for (int idx = 0; idx < schedulers_.size(); idx++) {
+      const pair<int, int>& rows = flow_to_scheduler_rows[flow_idx][idx];
+      if (capacity[rows.first] <= 0 || capacity[rows.second] <= 0) continue;
+      double sum = length[rows.first] + length[rows.second];
+      if (best_idx < 0 || sum < *path_length) {
+        best_idx = idx;
+        *path_length = sum;
+      }
+    }
+    return best_idx;
+  };
+
+  std::fill(load.begin(), load.end(), 0.0);
+  int num_phases = 0;
+  double lower_bound = 0;
+  while (true) {
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      double remaining = demand[flow_idx];
+      while (remaining > 0) {
+        double path_length = 0;
+        int idx = shortest_path(flow_idx, &path_length);
+        const pair<int, int>& rows = flow_to_scheduler_rows[flow_idx][idx];
+        double routed = std::min(remaining, std::min(capacity[rows.first],
+                                                     capacity[rows.second]));
+        (*flow_to_scheduler_m)[flow_idx][idx] += routed;
+        for (int row : {rows.first, rows.second}) {
+          load[row] += routed;
+          length[row] *= 1 + epsilon * routed / capacity[row];
         }
+        remaining -= routed;
       }
-      coflow->has_route_ = true;
+    }
+    num_phases++;
+
+    double congestion = 0, volume = 0, max_length = 0;
+    for (int row = 0; row < num_rows; row++) {
+      if (capacity[row] <= 0) continue;
+      congestion = std::max(congestion, load[row] / capacity[row]);
+      volume += capacity[row] * length[row];
+      max_length = std::max(max_length, length[row]);
+    }
+    double routed_length = 0;
+    for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+      double path_length = 0;
+      shortest_path(flow_idx, &path_length);
+      routed_length += demand[flow_idx] * path_length;
+    }
+    lower_bound = num_phases / congestion;
+    double upper_bound = volume / routed_length;
+    if (lower_bound >= (1 - epsilon) * upper_bound
+        || log(volume) + log_delta_scale >= 0) {
       if (debug_level_ >= 2) {
-        cout << coflow->GetName() << " solver_cct = "
-             << 1 / alpha.get(GRB_DoubleAttr_X) << " (could be infeasible)\n";
+        cout << "[SolverInfocom::SolveRouteApprox] alpha within ["
+             << lower_bound * scale << ", " << upper_bound * scale
+             << "] after " << num_phases << " phases" << endl;
       }
-      return true;
-    } else {
-      cerr << " NOT feasible\n";
-      return false;
+      break;
+    }
+    if (max_length > 1e100) {
+      for (double& row_length : length) row_length /= max_length;
+      log_delta_scale += log(max_length);
     }
+  }
 
-  } catch (GRBException e) {
-    cerr << "Gurobi Error: " << e.getMessage() << endl;
-  } catch (...) {
-    cerr << "Exception during optimization" << endl;
+  *alpha = lower_bound * scale;
+  RoundRouteApprox(route_model, flow_to_scheduler_m);
+  // sum(m_j_k) of each flow is alpha, as in the LP.
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    for (double& m : (*flow_to_scheduler_m)[flow_idx]) {
+      m *= *alpha;
+    }
   }
-  cout << "By default: NOT feasible\n";
-  return false;
+  return LpSolver::LP_OPTIMAL;
+}
 
-  return 0;
+void SolverInfocom::RoundRouteApprox(
+    RouteModel* route_model,
+    vector<vector<double>>* flow_to_scheduler_m) {
+  // Routing each flow through the scheduler with the most of its m_j_k, as
+  // FindRoute() does, may be far from the fractional cct, as multiplicative
+  // weights spread flows over schedulers. From there, flows are moved off the
+  // bottleneck constraint as long as that shortens the cct of the route.
+  const vector<Flow*>& flows = route_model->flows;
+  const vector<vector<pair<int, int>>>& flow_to_scheduler_rows =
+      route_model->flow_to_scheduler_rows;
+  const vector<double>& capacity = route_model->rhs;
+  int num_rows = capacity.size();
+  auto has_capacity = [&](const pair<int, int>& rows) {
+    return capacity[rows.first] > 0 && capacity[rows.second] > 0;
+  };
+  vector<int> route(flows.size(), -1);
+  vector<double> load(num_rows, 0.0);
+  // rows of each flow on its route, to find the flows of a row.
+  vector<vector<int>> row_to_flows(num_rows);
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    const vector<double>& m = (*flow_to_scheduler_m)[flow_idx];
+    for (int idx = 0; idx < schedulers_.size(); idx++) {
+      if (!has_capacity(flow_to_scheduler_rows[flow_idx][idx])) continue;
+      if (route[flow_idx] < 0 || m[idx] > m[route[flow_idx]]) {
+        route[flow_idx] = idx;
+      }
+    }
+    const pair<int, int>& rows =
+        flow_to_scheduler_rows[flow_idx][route[flow_idx]];
+    for (int row : {rows.first, rows.second}) {
+      load[row] += flows[flow_idx]->GetBitsLeft() / 1e9;
+      row_to_flows[row].push_back(flow_idx);
+    }
+  }
+  auto row_cct = [&](int row) {
+    return capacity[row] > 0 ? load[row] / capacity[row] : 0.0;
+  };
+  // each move lowers the sorted ccts of rows, which bounds the moves anyway.
+  const int max_moves = flows.size() * schedulers_.size();
+  for (int num_moves = 0; num_moves < max_moves; num_moves++) {
+    int bottleneck = 0;
+    for (int row = 1; row < num_rows; row++) {
+      if (row_cct(row) > row_cct(bottleneck)) bottleneck = row;
+    }
+    double cct = row_cct(bottleneck);
+    int best_flow = -1, best_idx = -1;
+    double best_cct = cct * (1 - 1e-9);
+    for (int flow_idx : row_to_flows[bottleneck]) {
+      double bits = flows[flow_idx]->GetBitsLeft() / 1e9;
+      for (int idx = 0; idx < schedulers_.size(); idx++) {
+        const pair<int, int>& rows = flow_to_scheduler_rows[flow_idx][idx];
+        if (idx == route[flow_idx] || !has_capacity(rows)) continue;
+        double moved_cct =
+            std::max((load[rows.first] + bits) / capacity[rows.first],
+                     (load[rows.second] + bits) / capacity[rows.second]);
+        if (moved_cct < best_cct) {
+          best_flow = flow_idx;
+          best_idx = idx;
+          best_cct = moved_cct;
+        }
+      }
+    }
+    if (best_flow < 0) break;
+    double bits = flows[best_flow]->GetBitsLeft() / 1e9;
+    const pair<int, int>& old_rows =
+        flow_to_scheduler_rows[best_flow][route[best_flow]];
+    for (int row : {old_rows.first, old_rows.second}) {
+      load[row] -= bits;
+      vector<int>& row_flows = row_to_flows[row];
+      row_flows.erase(std::find(row_flows.begin(), row_flows.end(),
+                                best_flow));
+    }
+    route[best_flow] = best_idx;
+    const pair<int, int>& new_rows =
+        flow_to_scheduler_rows[best_flow][best_idx];
+    for (int row : {new_rows.first, new_rows.second}) {
+      load[row] += bits;
+      row_to_flows[row].push_back(best_flow);
+    }
+  }
+  for (int flow_idx = 0; flow_idx < flows.size(); flow_idx++) {
+    vector<double>& m = (*flow_to_scheduler_m)[flow_idx];
+    for (int idx = 0; idx < schedulers_.size(); idx++) {
+      m[idx] = idx == route[flow_idx] ? 1.0 : 0.0;
+    }
+  }
 }
 
 void SolverInfocom::DistributeBandwidth(
     vector<Coflow*>& coflows, map<long, long>* rates,
-    map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-    map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps) {
+    ReservationTable* scheduler_src_reserved_bps,
+    ReservationTable* scheduler_dst_reserved_bps) {
   vector<Coflow*> sorted_coflows = coflows;
   std::stable_sort(sorted_coflows.begin(), sorted_coflows.end(),
                    [](Coflow* l, Coflow* r) {
@@ -334,11 +965,12 @@ void SolverInfocom::DistributeBandwidth(
         cout << "WC " << flow->toString() << " " << endl;
       }
       Scheduler* scheduler = flow->assigned_scheduler_;
+      int scheduler_idx = SchedulerIdx(scheduler);
       int src = flow->GetSrc(), dst = flow->GetDest();
-      long src_residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          *scheduler_src_reserved_bps, std::make_pair(scheduler, src), 0L);
-      long dst_residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          *scheduler_dst_reserved_bps, std::make_pair(scheduler, dst), 0L);
+      long src_residual_bps = scheduler->GetSrcPortBps(src)
+          - scheduler_src_reserved_bps->Get(scheduler_idx, src);
+      long dst_residual_bps = scheduler->GetDstPortBps(dst)
+          - scheduler_dst_reserved_bps->Get(scheduler_idx, dst);
       long residual_bps = min(src_residual_bps, dst_residual_bps);
       if (residual_bps <= 2) {
         // ignore increment that is too small
@@ -346,10 +978,8 @@ void SolverInfocom::DistributeBandwidth(
       }
       // increase the rate!
       rates->operator[](flow->GetFlowId()) += residual_bps;
-      scheduler_src_reserved_bps->operator[](std::make_pair(scheduler, src))
-          += residual_bps;
-      scheduler_dst_reserved_bps->operator[](std::make_pair(scheduler, dst))
-          += residual_bps;
+      scheduler_src_reserved_bps->Add(scheduler_idx, src, residual_bps);
+      scheduler_dst_reserved_bps->Add(scheduler_idx, dst, residual_bps);
       if (debug_level_ >= 4) {
         cout << "WC Added rate " << residual_bps << " for "
              << coflow->GetName() << " " << flow->toString() << " new rate = "
@@ -359,12 +989,117 @@ void SolverInfocom::DistributeBandwidth(
   }// for coflow
 }
 
-// static
 double SolverInfocom::FindCCTGivenRoute(
     Coflow* coflow,
-    const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-    const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps,
-    int debug_level) {
+    const ReservationTable& scheduler_src_reserved_bps,
+    const ReservationTable& scheduler_dst_reserved_bps) {
+
+  assert(coflow->has_route_);
+
+  // bits of the coflow on each [scheduler idx][port], reset to 0 before
+  // return. One copy per thread, as MinCCT() may run on the worker pool.
+  static thread_local vector<vector<long>> src_bits, dst_bits;
+  src_bits.resize(schedulers_.size());
+  dst_bits.resize(schedulers_.size());
+
+  vector<pair<int, int>> touched_src, touched_dst;
+  for (Flow* flow :*coflow->GetFlows()) {
+    if (!flow->HasDemand()) {
+      continue;
+    }
+    Scheduler* scheduler = flow->assigned_scheduler_;
+    if (!scheduler) {
+      cerr << flow->toString() << " has no scheduler!!!\n";
+    }
+    assert(scheduler); // bug?
+    int scheduler_idx = SchedulerIdx(scheduler);
+    AddBits(scheduler_idx, flow->GetSrc(), flow->GetBitsLeft(), &src_bits,
+            &touched_src);
+    AddBits(scheduler_idx, flow->GetDest(), flow->GetBitsLeft(), &dst_bits,
+            &touched_dst);
+  }
+
+  double cct = 0;
+  // fold both sides, so that bits tables are reset even if infeasible.
+  bool src_feasible = FoldCCTOnPorts(touched_src, scheduler_src_reserved_bps,
+                                     true/*is_src*/, &src_bits, &cct);
+  bool dst_feasible = FoldCCTOnPorts(touched_dst, scheduler_dst_reserved_bps,
+                                     false/*is_src*/, &dst_bits, &cct);
+  if (!src_feasible || !dst_feasible) {
+    if (debug_level_ >= 1) {
+      cout << "[FindCCTGivenRoute]: NO feasible cct for "
+           << coflow->GetName() << endl;
+    }
+    cct = -1;
+  } else if (debug_level_ >= 1) {
+    cout << coflow->GetName() << " cct_given_route = "
+         << cct << ", ratio over lowerbound = "
+         << cct * ELEC_BPS / coflow->GetMaxPortLoadInBits() << endl;
+  }
+  if (debug_level_ >= 3) {
+    double lp_cct = FindCCTGivenRouteLp(coflow, scheduler_src_reserved_bps,
+                                        scheduler_dst_reserved_bps, 0);
+    if (fabs(lp_cct - cct) > 1e-6 * max(1.0, fabs(cct))) {
+      cerr << "[FindCCTGivenRoute] ERROR: " << coflow->GetName()
+           << " cct_given_route = " << cct << " while solver_cct_given_route = "
+           << lp_cct << endl;
+    }
+  }
+  return cct;
+}
+
+int SolverInfocom::SchedulerIdx(Scheduler* scheduler) const {
+  // only a few schedulers.
+  for (int idx = 0; idx < schedulers_.size(); idx++) {
+    if (schedulers_[idx] == scheduler) return idx;
+  }
+  cerr << "[SolverInfocom::SchedulerIdx] ERROR: unknown scheduler "
+       << scheduler->name_ << endl;
+  exit(-1);
+}
+
+// static
+void SolverInfocom::AddBits(int scheduler_idx, int port, long bits,
+                            vector<vector<long>>* bits_table,
+                            vector<pair<int, int>>* touched) {
+  vector<long>& port_bits = (*bits_table)[scheduler_idx];
+  if (port >= port_bits.size()) {
+    port_bits.resize(port + 1, 0L);
+  }
+  if (port_bits[port] == 0) {
+    touched->push_back(std::make_pair(scheduler_idx, port));
+  }
+  port_bits[port] += bits;
+}
+
+bool SolverInfocom::FoldCCTOnPorts(
+    const vector<pair<int, int>>& touched,
+    const ReservationTable& scheduler_reserved_bps,
+    bool is_src, vector<vector<long>>* bits_table, double* cct) {
+  bool feasible = true;
+  for (const auto& scheduler_idx_port : touched) {
+    Scheduler* scheduler = schedulers_[scheduler_idx_port.first];
+    int port = scheduler_idx_port.second;
+    long& bits = (*bits_table)[scheduler_idx_port.first][port];
+    long port_bps = is_src ? scheduler->GetSrcPortBps(port)
+                           : scheduler->GetDstPortBps(port);
+    long residual_bps = port_bps
+        - scheduler_reserved_bps.Get(scheduler_idx_port.first, port);
+    if (residual_bps <= 0) {
+      feasible = false;
+    } else {
+      *cct = max(*cct, bits / (double) residual_bps);
+    }
+    bits = 0;
+  }
+  return feasible;
+}
+
+double SolverInfocom::FindCCTGivenRouteLp(
+    Coflow* coflow,
+    const ReservationTable& scheduler_src_reserved_bps,
+    const ReservationTable& scheduler_dst_reserved_bps,
+    int debug_level) const {
 
   assert(coflow->has_route_);
 
@@ -387,76 +1122,66 @@ double SolverInfocom::FindCCTGivenRoute(
         flow->GetBitsLeft();
   }
 
-  try {
-
-    GRBEnv env = GRBEnv();
+  unique_ptr<LpSolver> model(LpSolver::Create(LP_SOLVER_NAME, debug_level));
 
-    GRBModel model = GRBModel(env);
-    model.getEnv().set(GRB_IntParam_OutputFlag, 0); // disable output
+  // objective
+  // Set objective: minimize cct
+  int cct = model->AddVar(0.0, LpSolver::INFINITY_BOUND, 1.0, "cct");
+  model->SetMaximize(false);
 
-    // objective
-    GRBVar cct = model.addVar(0.0, GRB_INFINITY, 0.0, GRB_CONTINUOUS, "cct");
-
-    // Integrate new variables
-    model.update();
+  // Add constraint: inbound cap, i.e. src_bits <= cct * residual_bps
+  for (const auto& tuple: scheduler_src_to_bits) {
+    Scheduler* scheduler = tuple.first.first;
+    int src = tuple.first.second;
+    long src_bits = tuple.second;
+    long residual_bps = scheduler->GetSrcPortBps(src)
+        - scheduler_src_reserved_bps.Get(SchedulerIdx(scheduler), src);
+    model->AddConstr({std::make_pair(cct, residual_bps / 1e9)},
+                     LpSolver::LP_GREATER_EQUAL, src_bits / 1e9,
+                     "Csrc_" + scheduler->name_ + "_" + to_string(src));
+    // debug
+    // cout << "[FindCCTGivenRoute]: " << scheduler->name_ << " src " << src
+    //     << " residual " << residual_bps << " src_bits " << src_bits << endl;
+  }
 
-    // Set objective: minimize cct
-    GRBLinExpr obj = cct;
-    model.setObjective(obj, GRB_MINIMIZE);
+  // Add constraint: outbound cap
+  for (const auto& tuple: scheduler_dst_to_bits) {
+    Scheduler* scheduler = tuple.first.first;
+    int dst = tuple.first.second;
+    long dst_bits = tuple.second;
+    long residual_bps = scheduler->GetDstPortBps(dst)
+        - scheduler_dst_reserved_bps.Get(SchedulerIdx(scheduler), dst);
+    model->AddConstr({std::make_pair(cct, residual_bps / 1e9)},
+                     LpSolver::LP_GREATER_EQUAL, dst_bits / 1e9,
+                     "Cdst_" + scheduler->name_ + "_" + to_string(dst));
+    // debug
+    // cout << "[FindCCTGivenRoute]: " << scheduler->name_ << " dst " << dst
+    //     << " residual " << residual_bps << " dst_bits " << dst_bits << endl;
+  }
 
-    // Add constraint: inbound cap
-    for (const auto& tuple: scheduler_src_to_bits) {
-      Scheduler* scheduler = tuple.first.first;
-      int src = tuple.first.second;
-      long src_bits = tuple.second;
-      long residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          scheduler_src_reserved_bps, std::make_pair(scheduler, src), 0L);
-      model.addConstr(src_bits / 1e9 <= cct * residual_bps / 1e9,
-                      "Csrc_" + scheduler->name_ + "_" + to_string(src));
-      // debug
-      // cout << "[FindCCTGivenRoute]: " << scheduler->name_ << " src " << src
-      //     << " residual " << residual_bps << " src_bits " << src_bits << endl;
-    }
+  // Optimize model
+  LpSolver::Status status;
+  {
+    ScopedTimer timer("lp_solve");
+    status = model->Optimize();
+  }
 
-    // Add constraint: outbound cap
-    for (const auto& tuple: scheduler_dst_to_bits) {
-      Scheduler* scheduler = tuple.first.first;
-      int dst = tuple.first.second;
-      long dst_bits = tuple.second;
-      long residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_ - FindWithDef(
-          scheduler_dst_reserved_bps, std::make_pair(scheduler, dst), 0L);
-      model.addConstr(dst_bits / 1e9 <= cct * residual_bps / 1e9,
-                      "Cdst_" + scheduler->name_ + "_" + to_string(dst));
-      // debug
-      // cout << "[FindCCTGivenRoute]: " << scheduler->name_ << " dst " << dst
-      //     << " residual " << residual_bps << " dst_bits " << dst_bits << endl;
+  if (status == LpSolver::LP_OPTIMAL) {
+    double solver_cct_given_route = model->GetValue(cct);
+    if (debug_level >= 1) {
+      cout << coflow->GetName() << " solver_cct_given_route = "
+           << solver_cct_given_route << ", ratio over lowerbound = "
+           << solver_cct_given_route * ELEC_BPS
+               / coflow->GetMaxPortLoadInBits() << endl;
     }
-
-    // Optimize model
-    model.optimize();
-
-    if (model.get(GRB_IntAttr_Status) == GRB_OPTIMAL) {
-      double solver_cct_given_route = cct.get(GRB_DoubleAttr_X);
-      if (debug_level >= 1) {
-        cout << coflow->GetName() << " solver_cct_given_route = "
-             << solver_cct_given_route << ", ratio over lowerbound = "
-             << solver_cct_given_route * ELEC_BPS
-                 / coflow->GetMaxPortLoadInBits() << endl;
-      }
-      return solver_cct_given_route;
-    } else {
-      if (debug_level >= 1) {
-        cout << "[FindCCTGivenRoute]: NO feasible cct for "
-             << coflow->GetName() << endl;
-        // exit(-1);
-      }
-      return -1;
+    return solver_cct_given_route;
+  } else if (status != LpSolver::LP_ERROR) {
+    if (debug_level >= 1) {
+      cout << "[FindCCTGivenRoute]: NO feasible cct for "
+           << coflow->GetName() << endl;
+      // exit(-1);
     }
-
-  } catch (GRBException e) {
-    cerr << "Gurobi Error: " << e.getMessage() << endl;
-  } catch (...) {
-    cerr << "Exception during optimization" << endl;
+    return -1;
   }
   cout << "[FindCCTGivenRoute]: By default NOT feasible\n";
   return -1;
@@ -493,10 +1218,10 @@ bool SolverInfocom::IsValidRates(vector<Coflow*>& coflows,
     // debug
     // cout << scheduler->name_ << " src " << src << " reserved bps "
     //     << reserved_bps << endl;
-    if (reserved_bps > scheduler->SCHEDULER_LINK_RATE_BPS_) {
+    if (reserved_bps > scheduler->GetSrcPortBps(src)) {
       cerr << "Error: scheduler " << scheduler->name_ << " src " << src << " "
            << "Invalid reserved bps " << reserved_bps << " > "
-           << scheduler->SCHEDULER_LINK_RATE_BPS_ << endl;
+           << scheduler->GetSrcPortBps(src) << endl;
       if (exit_if_invalid) {
         exit(-1);
       } else {
@@ -513,10 +1238,10 @@ bool SolverInfocom::IsValidRates(vector<Coflow*>& coflows,
     // debug
     // cout << scheduler->name_ << " dst " << dst << " reserved bps "
     //      << reserved_bps << endl;
-    if (reserved_bps > scheduler->SCHEDULER_LINK_RATE_BPS_) {
+    if (reserved_bps > scheduler->GetDstPortBps(dst)) {
       cerr << "Error: scheduler " << scheduler->name_ << " dst " << dst << " "
            << "Invalid reserved bps " << reserved_bps << " > "
-           << scheduler->SCHEDULER_LINK_RATE_BPS_ << endl;
+           << scheduler->GetDstPortBps(dst) << endl;
       if (exit_if_invalid) {
         exit(-1);
       } else {
@@ -536,10 +1261,10 @@ bool SolverInfocom::IsValidRates(vector<Coflow*>& coflows,
       }
       Scheduler* scheduler = flow->assigned_scheduler_;
       int src = flow->GetSrc(), dst = flow->GetDest();
-      long src_residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_
+      long src_residual_bps = scheduler->GetSrcPortBps(src)
           - FindWithDef(validate_scheduler_src_bps,
                         std::make_pair(scheduler, src), 0L/*default_val*/);
-      long dst_residual_bps = scheduler->SCHEDULER_LINK_RATE_BPS_
+      long dst_residual_bps = scheduler->GetDstPortBps(dst)
           - FindWithDef(validate_scheduler_dst_bps,
                         std::make_pair(scheduler, dst), 0L/*default_val*/);
       long wasted_bps = min(src_residual_bps, dst_residual_bps);
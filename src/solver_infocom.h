@@ -5,10 +5,13 @@
 #ifndef XIMULATOR_SOLVER_INFOCOM_H
 #define XIMULATOR_SOLVER_INFOCOM_H
 
-#include "gurobi_c++.h"
+#include "lp_solver.h"
 #include "scheduler.h"
+#include "worker_pool.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -18,9 +21,79 @@ class Scheduler;
 
 using namespace std;
 
+// Memo of SolverInfocom::MinCCT() across reschedules. Each coflow keeps its
+// last route and cct, which are reused as long as the remaining bits of its
+// flows and the residual bandwidth of every (scheduler, port) its flows may
+// go through are unchanged. Any change of them invalidates the entry.
+class MinCCTCache {
+ public:
+  MinCCTCache() : num_hits_(0), num_misses_(0), usec_saved_(0) {}
+
+  // Drop entries of coflows not in coflows, e.g. finished ones.
+  void Retain(const vector<Coflow*>& coflows);
+  // Entries for coflows, if not yet. Not on the worker pool; coflows without
+  // an entry skip the cache.
+  void Add(const vector<Coflow*>& coflows);
+  // hit rate, and the time saved, i.e. the time the hits took to compute.
+  void Report(ostream& out) const;
+  long GetNumHits() const { return num_hits_; }
+  long GetNumMisses() const { return num_misses_; }
+
+ private:
+  friend class SolverInfocom;
+  struct Entry {
+    bool valid = false;
+    // fingerprint of (flow id, bits left) of flows with demand.
+    unsigned long demand_fingerprint = 0;
+    // residual bps of all (scheduler, port) the flows may go through.
+    vector<long> residual_bps;
+    bool has_route = false;
+    // scheduler idx of each flow with demand, in the order of GetFlows().
+    vector<int> route;
+    double cct = -1;
+    // time to compute the entry.
+    long compute_usec = 0;
+  };
+  // by coflow id. Keys are only inserted outside of the worker pool.
+  map<int, Entry> entries_;
+  atomic<long> num_hits_, num_misses_, usec_saved_;
+};
+
+// Reserved bps of each (scheduler, port), indexed by [scheduler idx][port]
+// with scheduler idx in the schedulers of SolverInfocom. A copy is a cheap
+// snapshot, sharing the ports of each scheduler until either copy changes
+// them. Only concurrent reads are safe.
+class ReservationTable {
+ public:
+  explicit ReservationTable(int num_schedulers = 0) : rows_(num_schedulers) {}
+
+  long Get(int scheduler_idx, int port) const {
+    const vector<long>* row = rows_[scheduler_idx].get();
+    return row && port < row->size() ? (*row)[port] : 0L;
+  }
+  void Add(int scheduler_idx, int port, long bps) {
+    MutableRow(scheduler_idx, port)[port] += bps;
+  }
+  void Set(int scheduler_idx, int port, long bps) {
+    MutableRow(scheduler_idx, port)[port] = bps;
+  }
+
+ private:
+  // ports of scheduler_idx owned by this table, with room for port.
+  vector<long>& MutableRow(int scheduler_idx, int port);
+  vector<shared_ptr<vector<long>>> rows_;
+};
+
 class SolverInfocom {
  public:
-  SolverInfocom(vector<Scheduler*>& schedulers, int debug_level = 0);
+  // MinCCT() of coflows are evaluated on worker_pool, and memoized in
+  // min_cct_cache, if given. FindRoute() solves the routing LP exactly, or
+  // approximately within a factor of (1 - approx_epsilon) if
+  // approx_epsilon > 0, which trades accuracy for time on large coflows.
+  SolverInfocom(vector<Scheduler*>& schedulers, int debug_level = 0,
+                WorkerPool* worker_pool = nullptr,
+                MinCCTCache* min_cct_cache = nullptr,
+                double approx_epsilon = 0);
   virtual ~SolverInfocom() {}
 
   void ComputeRouteAndRate(vector<Coflow*>& coflows, map<long, long>* rates);
@@ -28,38 +101,77 @@ class SolverInfocom {
   // two alternatives to algorithm 1 line 2-17 in infocom'15 paper
   void ComputeRouteAndRatePaper(
       vector<Coflow*>& coflows, map<long, long>* rates,
-      map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-      map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps);
+      ReservationTable* scheduler_src_reserved_bps,
+      ReservationTable* scheduler_dst_reserved_bps);
   void ComputeRouteAndRateSunny(
       vector<Coflow*>& coflows, map<long, long>* rates,
-      map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-      map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps);
+      ReservationTable* scheduler_src_reserved_bps,
+      ReservationTable* scheduler_dst_reserved_bps);
 
   // TODO: make the following functions private or protected if needed.
+  // In sticky routing, coflows with a kept route are not routed again.
   double MinCCT(
       Coflow* coflow,
-      const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-      const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps);
+      const ReservationTable& scheduler_src_reserved_bps,
+      const ReservationTable& scheduler_dst_reserved_bps);
+  // Records alpha = 1/cct of the fractional routing before rounding in
+  // solved_alpha, if given.
   bool FindRoute(
       Coflow* coflow,
-      const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-      const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps);
+      const ReservationTable& scheduler_src_reserved_bps,
+      const ReservationTable& scheduler_dst_reserved_bps,
+      double* solved_alpha = nullptr);
+  // cct of a routed coflow over the residual bandwidth, i.e. the max of
+  // bits / residual_bps over the (scheduler, port) it goes through. Returns
+  // -1 if some of them has no residual bandwidth.
+  double FindCCTGivenRoute(
+      Coflow* coflow,
+      const ReservationTable& scheduler_src_reserved_bps,
+      const ReservationTable& scheduler_dst_reserved_bps);
+  // Same as above, solved as a LP. Kept to cross-check FindCCTGivenRoute().
+  double FindCCTGivenRouteLp(
+      Coflow* coflow,
+      const ReservationTable& scheduler_src_reserved_bps,
+      const ReservationTable& scheduler_dst_reserved_bps,
+      int debug_level) const;
 
  private:
   vector<Scheduler*> schedulers_;
   const int debug_level_;
+  WorkerPool* worker_pool_; // not owned.
+  MinCCTCache* min_cct_cache_; // not owned.
+  const double approx_epsilon_;
+  // FindRoute() solves the routing LP as a whole, unless the LP backend
+  // keeps a dense model and the coflow has more (flow, scheduler) pairs than
+  // MAX_DENSE_ROUTE_VARS_. Then it generates routings of the coflow as
+  // columns, up to MAX_ROUTE_COLUMNS_.
+  static const int MAX_DENSE_ROUTE_VARS_;
+  static const int MAX_ROUTE_COLUMNS_;
+  int SchedulerIdx(Scheduler* scheduler) const;
+  // Fill in the fingerprint and residual_bps of entry for coflow.
+  void FingerprintMinCCT(
+      Coflow* coflow,
+      const ReservationTable& scheduler_src_reserved_bps,
+      const ReservationTable& scheduler_dst_reserved_bps,
+      MinCCTCache::Entry* entry) const;
+  // Add bits to bits_table[scheduler_idx][port], recording the entry in
+  // touched if it was 0.
+  static void AddBits(int scheduler_idx, int port, long bits,
+                      vector<vector<long>>* bits_table,
+                      vector<pair<int, int>>* touched);
+  // Fold bits / residual_bps of touched entries into cct, and reset them.
+  // Returns false if some touched entry has no residual bandwidth.
+  bool FoldCCTOnPorts(
+      const vector<pair<int, int>>& touched,
+      const ReservationTable& scheduler_reserved_bps,
+      bool is_src, vector<vector<long>>* bits_table, double* cct);
 
   // Distributed residual bandwidth according to reserved_bps records, mark up
   // flow rates in rates, also update the reserved_bps records.
   void DistributeBandwidth(
       vector<Coflow*>& coflows, map<long, long>* rates,
-      map<pair<Scheduler*, int>, long>* scheduler_src_reserved_bps,
-      map<pair<Scheduler*, int>, long>* scheduler_dst_reserved_bps);
-  static double FindCCTGivenRoute(
-      Coflow* coflow,
-      const map<pair<Scheduler*, int>, long>& scheduler_src_reserved_bps,
-      const map<pair<Scheduler*, int>, long>& scheduler_dst_reserved_bps,
-      int debug_level);
+      ReservationTable* scheduler_src_reserved_bps,
+      ReservationTable* scheduler_dst_reserved_bps);
   static bool IsValidRates(vector<Coflow*>& coflows,
                            const map<long, long>& rates,
                            bool exit_if_invalid,
@@ -73,6 +185,73 @@ class SolverInfocom {
     bool operator()(const std::pair<Scheduler*, int>& l,
                     const std::pair<Scheduler*, int>& r) const;
   };
+
+  // constraint of each (scheduler, port) in the routing LP.
+  typedef map<pair<Scheduler*, int>, int, AscendingSchedulerPort> PortRowMap;
+
+  // LP of routing a coflow. It is kept across the rounds of
+  // ComputeRouteAndRatePaper(), where only the residual bandwidth of ports,
+  // i.e. the right-hand sides, changes.
+  struct RouteModel {
+    // null if solved by SolveRouteApprox().
+    unique_ptr<LpSolver> model;
+    // flows with demand, sorted by AscendingFlowOnCoflowIdSrcDst.
+    vector<Flow*> flows;
+    PortRowMap src_rows;
+    PortRowMap dst_rows;
+    bool by_columns;
+    // alpha >= rhs, written as -alpha <= -rhs, which holds alpha near its
+    // optimum while the second objective picks the routing. -1 without a LP.
+    int alpha_floor_row;
+    // for SolveRouteLp(): alpha = 1/cct, and var of (m_j_k) of each flow,
+    // indexed by scheduler in schedulers_.
+    int alpha_var;
+    vector<vector<int>> flow_to_scheduler_var_m;
+    // for SolveRouteByColumns(): scheduler idx of each flow in each routing,
+    // and the var of each routing.
+    vector<vector<int>> routings;
+    vector<int> routing_vars;
+    // for SolveRouteApprox(): right-hand side of each constraint, and the
+    // (src, dst) constraints of each flow, indexed by scheduler.
+    vector<double> rhs;
+    vector<vector<pair<int, int>>> flow_to_scheduler_rows;
+  };
+  // models of coflows routed since the last ComputeRouteAndRate(). Keys are
+  // inserted before MinCCT() runs on the worker pool, where each task only
+  // fills in the model of its own coflow.
+  map<Coflow*, unique_ptr<RouteModel>> route_models_;
+
+  RouteModel* GetRouteModel(Coflow* coflow);
+  // (Re)create the LP of route_model, with its constraints on ports and on
+  // the floor of alpha.
+  void BuildRouteLp(RouteModel* route_model);
+  // Coefficient of m_j_k in the second objective of the routing LP, about
+  // 1 to 2 by the link rate of the scheduler, distinct over (flow, scheduler).
+  double TieBreakObj(int flow_idx, int scheduler_idx) const;
+  // Solve the routing LP as a whole. Record alpha = 1/cct and (m_j_k) of each
+  // flow, indexed by scheduler in schedulers_. The optimal face of alpha is
+  // often wide, so (m_j_k) maximizes the second objective of TieBreakObj()
+  // over it, which has a unique optimum whatever the backend and the basis
+  // it starts from.
+  LpSolver::Status SolveRouteLp(
+      RouteModel* route_model,
+      vector<vector<double>>* flow_to_scheduler_m, double* alpha);
+  // Same as above, with routings of the coflow generated as columns, without
+  // the second objective. Routings start over in each FindRoute(), so the
+  // result does not depend on earlier rounds.
+  LpSolver::Status SolveRouteByColumns(
+      RouteModel* route_model,
+      vector<vector<double>>* flow_to_scheduler_m, double* alpha);
+  // Same as above, within a factor of (1 - approx_epsilon_) of the optimal
+  // alpha, by the multiplicative weights of Garg-Konemann and Fleischer for
+  // the maximum concurrent flow.
+  LpSolver::Status SolveRouteApprox(
+      RouteModel* route_model,
+      vector<vector<double>>* flow_to_scheduler_m, double* alpha);
+  // Round (m_j_k) of SolveRouteApprox() to one scheduler per flow, with m_j_k
+  // of 1 there and 0 elsewhere.
+  void RoundRouteApprox(RouteModel* route_model,
+                        vector<vector<double>>* flow_to_scheduler_m);
 };
 
 #endif //XIMULATOR_SOLVER_INFOCOM_H
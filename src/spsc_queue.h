@@ -0,0 +1,65 @@
+//
+//  spsc_queue.h
+//  Ximulator
+//
+//  A bounded lock-free queue of one producer thread and one consumer thread.
+//  Slots are preallocated and reused in place, so that elements holding
+//  vectors keep their capacity across uses.
+//
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+template<typename T>
+class SpscQueue {
+ public:
+  // capacity is rounded up to a power of 2.
+  explicit SpscQueue(size_t capacity) : head_(0), tail_(0) {
+    size_t size = 1;
+    while (size < capacity) size *= 2;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+
+  // Producer: the slot to fill in, or nullptr if full. The slot is visible
+  // to the consumer after Push().
+  T* Back() {
+    size_t tail = tail_.load(memory_order_relaxed);
+    if (tail - head_.load(memory_order_acquire) > mask_) return nullptr;
+    return &slots_[tail & mask_];
+  }
+  void Push() { tail_.store(tail_.load(memory_order_relaxed) + 1,
+                            memory_order_release); }
+
+  // Consumer: the oldest slot, or nullptr if empty. The slot may be reused by
+  // the producer after Pop().
+  T* Front() {
+    size_t head = head_.load(memory_order_relaxed);
+    if (head == tail_.load(memory_order_acquire)) return nullptr;
+    return &slots_[head & mask_];
+  }
+  void Pop() { head_.store(head_.load(memory_order_relaxed) + 1,
+                           memory_order_release); }
+
+  // Either side: true if nothing is pushed and not popped.
+  bool Empty() const {
+    return head_.load(memory_order_acquire)
+        == tail_.load(memory_order_acquire);
+  }
+
+ private:
+  vector<T> slots_;
+  size_t mask_;
+  // next slot to pop, written by the consumer only.
+  atomic<size_t> head_;
+  // next slot to push, written by the producer only.
+  atomic<size_t> tail_;
+};
+
+#endif //SPSC_QUEUE_H
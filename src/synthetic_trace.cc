@@ -0,0 +1,183 @@
+//
+//  synthetic_trace.cc
+//  Ximulator
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "synthetic_trace.h"
+
+SyntheticTraceOptions
+SyntheticTraceOptions::FromName(const string& name, int num_racks) {
+  SyntheticTraceOptions options;
+  options.num_racks = num_racks;
+  vector<string> fields;
+  stringstream ss(name);
+  string field;
+  while (getline(ss, field, '_')) fields.push_back(field);
+  try {
+    if (fields.size() > 1) options.arrival = fields[1];
+    if (fields.size() > 2) options.arrival_rate = stod(fields[2]);
+    if (fields.size() > 3) options.num_coflows = stol(fields[3]);
+    if (fields.size() > 4) options.skew = stod(fields[4]);
+    if (fields.size() > 5) options.seed = stoul(fields[5]);
+  } catch (const exception& e) {
+    cerr << "[SyntheticTraceOptions::FromName] ERROR: illegal field in "
+         << name << endl;
+    exit(-1);
+  }
+  if ((options.arrival != "poisson" && options.arrival != "mmpp")
+      || options.arrival_rate <= 0 || options.num_coflows < 0
+      || options.skew < 0 || options.num_racks <= 0 || fields.size() > 6) {
+    cerr << "[SyntheticTraceOptions::FromName] ERROR: illegal " << name
+         << ", expect synthetic_<poisson|mmpp>_<rate per sec>_<num coflows>_"
+         << "<skew>_<seed>" << endl;
+    exit(-1);
+  }
+  return options;
+}
+
+SyntheticTraceSource::SyntheticTraceSource(
+    const SyntheticTraceOptions& options)
+    : options_(options), rng_(options.seed), has_next_(false),
+      num_generated_(0), arrival_ms_(0), bursting_(false) {
+  // bursts and quiet periods last as long on average, so that their mean
+  // rate is arrival_rate.
+  quiet_rate_ = 2 * options_.arrival_rate / (options_.burst_ratio + 1);
+  burst_rate_ = options_.burst_ratio * quiet_rate_;
+
+  rank_to_rack_.resize(options_.num_racks);
+  for (int rack = 0; rack < options_.num_racks; rack++) {
+    rank_to_rack_[rack] = rack;
+  }
+  // Fisher-Yates, rather than shuffle(), whose draws differ across standard
+  // libraries.
+  for (int i = options_.num_racks - 1; i > 0; i--) {
+    swap(rank_to_rack_[i], rank_to_rack_[(int) (Uniform() * (i + 1))]);
+  }
+  if (options_.skew > 0) {
+    rank_cdf_.resize(options_.num_racks);
+    double sum = 0;
+    for (int rank = 0; rank < options_.num_racks; rank++) {
+      sum += pow(rank + 1, -options_.skew);
+      rank_cdf_[rank] = sum;
+    }
+    for (double& cdf : rank_cdf_) cdf /= sum;
+  }
+  taken_.assign(options_.num_racks, false);
+}
+
+bool SyntheticTraceSource::Peek(TraceRecord* record, bool* legal) {
+  if (!has_next_) {
+    if (num_generated_ >= options_.num_coflows) return false;
+    Generate(&next_);
+    has_next_ = true;
+  }
+  *record = next_;
+  *legal = true;
+  return true;
+}
+
+void SyntheticTraceSource::Pop() {
+  if (!has_next_) {
+    // a coflow not peeked is generated and skipped.
+    if (num_generated_ >= options_.num_coflows) return;
+    Generate(&next_);
+  }
+  has_next_ = false;
+}
+
+void SyntheticTraceSource::Generate(TraceRecord* record) {
+  if (num_generated_ > 0) {
+    if (options_.arrival == "poisson") {
+      arrival_ms_ += 1000 * Exponential(options_.arrival_rate);
+    } else {
+      // mmpp: the state switches at exponential intervals of
+      // coflows_per_period mean inter-arrivals. Arrivals and switches are
+      // memoryless, so an arrival past the switch is redrawn from there.
+      double period_ms =
+          1000 * options_.coflows_per_period / options_.arrival_rate;
+      double next_ms = arrival_ms_;
+      while (true) {
+        double rate = bursting_ ? burst_rate_ : quiet_rate_;
+        double to_arrival_ms = 1000 * Exponential(rate);
+        double to_switch_ms = period_ms * Exponential(1);
+        if (to_arrival_ms < to_switch_ms) {
+          next_ms += to_arrival_ms;
+          break;
+        }
+        next_ms += to_switch_ms;
+        bursting_ = !bursting_;
+      }
+      arrival_ms_ = next_ms;
+    }
+  }
+  num_generated_++;
+
+  record->job_id = (int) num_generated_;
+  record->arrival_ms = floor(arrival_ms_);
+  record->num_map = Width(options_.mapper_mu, options_.mapper_sigma);
+  record->num_red = Width(options_.reducer_mu, options_.reducer_sigma);
+  PlaceOnRacks(record->num_map, &record->mapper_locations);
+  PlaceOnRacks(record->num_red, &record->reducer_locations);
+  record->reducer_input_bytes.resize(record->num_red);
+  for (long& bytes : record->reducer_input_bytes) {
+    double mb = LogNormal(options_.reducer_mb_mu, options_.reducer_mb_sigma);
+    long input_MB = max(options_.min_reducer_mb,
+                        min(options_.max_reducer_mb, (long) mb));
+    bytes = 1000000 * input_MB;
+  }
+}
+
+double SyntheticTraceSource::Uniform() {
+  // 53 random bits in [0, 1).
+  return (rng_() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double SyntheticTraceSource::Exponential(double rate) {
+  return -log(1 - Uniform()) / rate;
+}
+
+double SyntheticTraceSource::LogNormal(double mu, double sigma) {
+  // Box-Muller, one of the pair.
+  double u1 = 1 - Uniform();
+  double u2 = Uniform();
+  double normal = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+  return exp(mu + sigma * normal);
+}
+
+int SyntheticTraceSource::Width(double mu, double sigma) {
+  double width = round(LogNormal(mu, sigma));
+  return (int) max(1.0, min((double) options_.num_racks, width));
+}
+
+void SyntheticTraceSource::PlaceOnRacks(int count, vector<int>* locations) {
+  locations->clear();
+  // rejection sampling, which is quick unless most racks are taken. Then the
+  // most popular racks left are taken in order.
+  int attempts = 4 * count + 64;
+  while ((int) locations->size() < count && attempts-- > 0) {
+    int rank;
+    if (rank_cdf_.empty()) {
+      rank = (int) (Uniform() * options_.num_racks);
+    } else {
+      rank = (int) (upper_bound(rank_cdf_.begin(), rank_cdf_.end(),
+                                Uniform()) - rank_cdf_.begin());
+      rank = min(rank, options_.num_racks - 1);
+    }
+    int rack = rank_to_rack_[rank];
+    if (taken_[rack]) continue;
+    taken_[rack] = true;
+    locations->push_back(rack);
+  }
+  for (int rank = 0; (int) locations->size() < count; rank++) {
+    int rack = rank_to_rack_[rank];
+    if (taken_[rack]) continue;
+    taken_[rack] = true;
+    locations->push_back(rack);
+  }
+  for (int rack : *locations) taken_[rack] = false;
+}
@@ -0,0 +1,103 @@
+//
+//  synthetic_trace.h
+//  Ximulator
+//
+//  A seeded stream of synthetic coflows, for workloads beyond the FB trace in
+//  racks and arrival rate. By default the distributions are fitted to
+//  trace/fbtrace-1hr.txt:
+//  - arrivals: Poisson of the trace's mean rate, or a two-state Markov
+//    modulated Poisson process (MMPP) of the same mean rate, whose bursts
+//    arrive burst_ratio times faster than the quiet periods.
+//  - widths: numbers of mappers and reducers are lognormal, capped by the
+//    number of racks.
+//  - sizes: input MB of each reducer is lognormal, within the trace's range.
+//  - placement: racks are Zipf distributed of exponent skew over a seeded
+//    permutation of racks, uniform if skew is 0. Mappers, and reducers, of a
+//    coflow are on distinct racks.
+//  Coflows are generated one at a time on Peek(), so that the workload is
+//  never held in memory. Random variates are transformed by hand from
+//  mt19937_64, which is the same on all standard libraries, so that a seed
+//  gives the same workload everywhere.
+//
+
+#ifndef SYNTHETIC_TRACE_H
+#define SYNTHETIC_TRACE_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "trace_reader.h"
+
+using namespace std;
+
+struct SyntheticTraceOptions {
+  // "poisson" or "mmpp".
+  string arrival = "poisson";
+  // mean coflows per second.
+  double arrival_rate = 0.1447;
+  // mmpp: rate of bursts over rate of quiet periods, and mean number of
+  // coflows of a period before the state switches.
+  double burst_ratio = 10;
+  double coflows_per_period = 20;
+  long num_coflows = 526;
+  int num_racks = 150;
+  // Zipf exponent of rack popularity.
+  double skew = 0;
+  unsigned long seed = 1;
+
+  // lognormal parameters of ln(width) and ln(MB).
+  double mapper_mu = 1.648;
+  double mapper_sigma = 1.615;
+  double reducer_mu = 1.249;
+  double reducer_sigma = 1.816;
+  double reducer_mb_mu = 4.89;
+  double reducer_mb_sigma = 2.96;
+  long min_reducer_mb = 1;
+  long max_reducer_mb = 232145;
+
+  // Parse "synthetic_<arrival>_<rate>_<num_coflows>_<skew>_<seed>" into
+  // options, where trailing fields may be omitted for their defaults. Exits
+  // on illegal fields.
+  static SyntheticTraceOptions FromName(const string& name, int num_racks);
+};
+
+class SyntheticTraceSource : public TraceSource {
+ public:
+  explicit SyntheticTraceSource(const SyntheticTraceOptions& options);
+  virtual ~SyntheticTraceSource() {}
+
+  // Coflows are always legal.
+  virtual bool Peek(TraceRecord* record, bool* legal);
+  virtual void Pop();
+
+ private:
+  void Generate(TraceRecord* record);
+
+  double Uniform();
+  double Exponential(double rate);
+  double LogNormal(double mu, double sigma);
+  int Width(double mu, double sigma);
+  // fill locations with count distinct racks.
+  void PlaceOnRacks(int count, vector<int>* locations);
+
+  const SyntheticTraceOptions options_;
+  mt19937_64 rng_;
+  // the next coflow, valid if has_next_.
+  TraceRecord next_;
+  bool has_next_;
+  long num_generated_;
+  double arrival_ms_;
+  // mmpp: true while bursting, with the rates of both states.
+  bool bursting_;
+  double burst_rate_;
+  double quiet_rate_;
+  // cumulative popularity of ranks, empty if skew is 0.
+  vector<double> rank_cdf_;
+  // rack of each rank.
+  vector<int> rank_to_rack_;
+  // scratch of PlaceOnRacks().
+  vector<char> taken_;
+};
+
+#endif //SYNTHETIC_TRACE_H
@@ -0,0 +1,27 @@
+//
+//  trace_converter.cc
+//  Ximulator
+//
+//  Convert a text coflow trace into the binary format, which -ftrace
+//  detects and replays without parsing, e.g.
+//    trace_converter ../trace/fbtrace-1hr.txt ../trace/fbtrace-1hr.bin
+//
+
+#include <iostream>
+
+#include "trace_reader.h"
+
+int main(int argc, const char* argv[]) {
+  if (argc != 3) {
+    cout << "usage: " << argv[0] << " text_trace binary_trace" << endl;
+    exit(0);
+  }
+  ConvertTraceToBinary(argv[1], argv[2]);
+  TraceReader reader(argv[2]);
+  TraceRecord record;
+  bool legal;
+  long num_coflows = 0;
+  for (; reader.Peek(&record, &legal); reader.Pop()) num_coflows++;
+  cout << "Converted " << num_coflows << " coflows into " << argv[2] << endl;
+  return 0;
+}
@@ -0,0 +1,66 @@
+//
+//  trace_prefetcher.cc
+//  Ximulator
+//
+
+#include <chrono>
+
+#include "trace_prefetcher.h"
+
+TracePrefetcher::TracePrefetcher(TraceSource* source, double window_ms,
+                                 int capacity)
+    : source_(source), window_ms_(window_ms), queue_(capacity),
+      peeked_arrival_ms_(-1), done_(false), stop_(false) {
+  bool legal;
+  TraceRecord first;
+  if (source_->Peek(&first, &legal) && legal) {
+    // the window starts from the first coflow.
+    peeked_arrival_ms_ = first.arrival_ms;
+  }
+  thread_ = thread(&TracePrefetcher::Prefetch, this);
+}
+
+TracePrefetcher::~TracePrefetcher() {
+  stop_ = true;
+  thread_.join();
+}
+
+void TracePrefetcher::Prefetch() {
+  while (!stop_) {
+    Slot* slot = queue_.Back();
+    if (!slot) {
+      this_thread::sleep_for(chrono::microseconds(100));
+      continue;
+    }
+    if (!source_->Peek(&slot->record, &slot->legal)) break;
+    // wait for the replay to catch up with the window, unless the replay is
+    // waiting for this coflow.
+    while (!stop_ && slot->legal && !queue_.Empty()
+        && slot->record.arrival_ms > peeked_arrival_ms_ + window_ms_) {
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+    source_->Pop();
+    queue_.Push();
+  }
+  done_ = true;
+}
+
+bool TracePrefetcher::Peek(TraceRecord* record, bool* legal) {
+  Slot* slot = queue_.Front();
+  while (!slot) {
+    // check done_ before the queue, as the last coflow is pushed before
+    // done_ is set.
+    bool done = done_;
+    slot = queue_.Front();
+    if (!slot && done) return false;
+    if (!slot) this_thread::yield();
+  }
+  *record = slot->record;
+  *legal = slot->legal;
+  if (slot->legal) peeked_arrival_ms_ = slot->record.arrival_ms;
+  return true;
+}
+
+void TracePrefetcher::Pop() {
+  if (queue_.Front()) queue_.Pop();
+}
@@ -0,0 +1,54 @@
+//
+//  trace_prefetcher.h
+//  Ximulator
+//
+//  Parse a trace ahead of the replay on a background thread. Coflows of any
+//  TraceSource are parsed up to a look-ahead window of arrival time past the
+//  last coflow peeked, and at most a fixed number at a time, then handed over
+//  to the replay through a SpscQueue. Coflows are still built by the replay,
+//  which keeps the ids of coflows and flows in the order of the trace.
+//
+
+#ifndef TRACE_PREFETCHER_H
+#define TRACE_PREFETCHER_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "spsc_queue.h"
+#include "trace_reader.h"
+
+using namespace std;
+
+class TracePrefetcher : public TraceSource {
+ public:
+  // source is owned, and only read by the background thread.
+  TracePrefetcher(TraceSource* source, double window_ms, int capacity);
+  virtual ~TracePrefetcher();
+
+  // Waits for the background thread if the next coflow is not parsed yet.
+  virtual bool Peek(TraceRecord* record, bool* legal);
+  virtual void Pop();
+
+ private:
+  struct Slot {
+    TraceRecord record;
+    bool legal;
+  };
+
+  void Prefetch();
+
+  unique_ptr<TraceSource> source_;
+  const double window_ms_;
+  SpscQueue<Slot> queue_;
+  // arrival of the last coflow peeked, which the window starts from.
+  atomic<double> peeked_arrival_ms_;
+  // set by the background thread after the last coflow is pushed.
+  atomic<bool> done_;
+  // set on destruction, to stop the background thread early.
+  atomic<bool> stop_;
+  thread thread_;
+};
+
+#endif //TRACE_PREFETCHER_H
@@ -0,0 +1,422 @@
+//
+//  trace_reader.cc
+//  Ximulator
+//
+
+#include <algorithm> // lower_bound
+#include <cstdlib>
+#include <cstring> // memcpy, memcmp
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_reader.h"
+
+namespace {
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parse a non-negative integer at p, and skip its fraction if any, e.g.
+// "648.0" as 648. Returns false if there is no digit.
+bool ParseLong(const char*& p, const char* end, long* value) {
+  const char* start = p;
+  long result = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    result = result * 10 + (*p - '0');
+    p++;
+  }
+  if (p == start) return false;
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  *value = result;
+  return true;
+}
+
+bool ParseInt(const char*& p, const char* end, int* value) {
+  long result;
+  if (!ParseLong(p, end, &result)) return false;
+  *value = (int) result;
+  return true;
+}
+
+// Parse a non-negative decimal, e.g. "10833" or "10833.5".
+bool ParseDouble(const char*& p, const char* end, double* value) {
+  const char* start = p;
+  double result = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    result = result * 10 + (*p - '0');
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    double scale = 0.1;
+    while (p < end && *p >= '0' && *p <= '9') {
+      result += (*p - '0') * scale;
+      scale /= 10;
+      p++;
+    }
+  }
+  if (p == start) return false;
+  *value = result;
+  return true;
+}
+
+// Find the next whitespace-separated field of [p, end), and move p past it.
+bool NextField(const char*& p, const char* end,
+               const char** field_begin, const char** field_end) {
+  while (p < end && IsSpace(*p)) p++;
+  if (p == end) return false;
+  *field_begin = p;
+  while (p < end && !IsSpace(*p)) p++;
+  *field_end = p;
+  return true;
+}
+
+// values of the binary format may be unaligned in the mapped file.
+template<typename T>
+T ReadAt(const char* data, uint64_t offset) {
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+template<typename T>
+void Append(vector<char>* buffer, T value) {
+  const char* bytes = (const char*) &value;
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+void WriteAt(vector<char>* buffer, uint64_t offset, T value) {
+  memcpy(buffer->data() + offset, &value, sizeof(T));
+}
+
+const uint64_t HEADER_BYTES = 4 + 4 + 8 * 4;
+const uint64_t RECORD_HEADER_BYTES = 4 * 4 + 8;
+const uint64_t TIME_INDEX_ENTRY_BYTES = 8 + 8;
+const uint64_t ID_INDEX_ENTRY_BYTES = 8 + 8;
+
+} // namespace
+
+const char TraceReader::BINARY_MAGIC[4] = {'X', 'T', 'R', 'C'};
+const uint32_t TraceReader::BINARY_VERSION = 1;
+
+TraceReader::TraceReader(const string& file_name)
+    : data_(nullptr), size_(0), is_binary_(false), cursor_(nullptr),
+      peeked_end_(nullptr), num_jobs_(0), time_index_offset_(0),
+      id_index_offset_(0), next_position_(0) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) != 0) {
+    cout << "Error: unable to open file " << file_name << endl;
+    cout << "Now terminate the program" << endl;
+    exit(-1);
+  }
+  size_ = (size_t) file_stat.st_size;
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      cout << "Error: unable to map file " << file_name << endl;
+      cout << "Now terminate the program" << endl;
+      exit(-1);
+    }
+    // the trace is read once from the start to the end.
+    madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = (const char*) data;
+  }
+  close(fd);
+  cursor_ = data_;
+  peeked_end_ = data_;
+
+  is_binary_ = size_ >= sizeof(BINARY_MAGIC)
+      && memcmp(data_, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+  if (is_binary_) {
+    uint32_t version = size_ >= HEADER_BYTES ? ReadAt<uint32_t>(data_, 4) : 0;
+    if (version != BINARY_VERSION) {
+      cerr << "[TraceReader] ERROR: " << file_name << " is of version "
+           << version << ", not " << BINARY_VERSION << endl;
+      exit(-1);
+    }
+    num_jobs_ = ReadAt<uint64_t>(data_, 8);
+    time_index_offset_ = ReadAt<uint64_t>(data_, 24);
+    id_index_offset_ = ReadAt<uint64_t>(data_, 32);
+    if (time_index_offset_ + num_jobs_ * TIME_INDEX_ENTRY_BYTES > size_
+        || id_index_offset_ + num_jobs_ * ID_INDEX_ENTRY_BYTES > size_) {
+      cerr << "[TraceReader] ERROR: " << file_name << " is truncated" << endl;
+      exit(-1);
+    }
+    // records are read in order, but indexes are searched.
+    madvise((void*) data_, size_, MADV_NORMAL);
+  }
+}
+
+TraceReader::~TraceReader() {
+  if (data_) {
+    munmap((void*) data_, size_);
+  }
+}
+
+bool TraceReader::Peek(TraceRecord* record, bool* legal) {
+  return is_binary_ ? PeekBinary(record, legal) : PeekText(record, legal);
+}
+
+bool TraceReader::PeekText(TraceRecord* record, bool* legal) {
+  const char* end = data_ + size_;
+  if (cursor_ == end) return false;
+  const char* line_end = cursor_;
+  while (line_end < end && *line_end != '\n') line_end++;
+  peeked_end_ = line_end < end ? line_end + 1 : line_end;
+  if (line_end == cursor_) {
+    // an empty line ends the trace.
+    return false;
+  }
+
+  const char* p = cursor_;
+  const char* fields_begin[5];
+  const char* fields_end[5];
+  *legal = false;
+  for (int idx = 0; idx < 5; idx++) {
+    if (!NextField(p, line_end, &fields_begin[idx], &fields_end[idx])) {
+      return true;
+    }
+  }
+  p = fields_begin[0];
+  if (!ParseInt(p, fields_end[0], &record->job_id)) return true;
+  p = fields_begin[1];
+  if (!ParseDouble(p, fields_end[1], &record->arrival_ms)) return true;
+  p = fields_begin[2];
+  if (!ParseInt(p, fields_end[2], &record->num_map)) return true;
+  p = fields_begin[3];
+  if (!ParseInt(p, fields_end[3], &record->num_red)) return true;
+  *legal = ParseCoflowInfo(fields_begin[4], fields_end[4],
+                           record->num_map, record->num_red, record);
+  return true;
+}
+
+bool TraceReader::PeekBinary(TraceRecord* record, bool* legal) {
+  if (next_position_ >= num_jobs_) return false;
+  uint64_t offset = BinaryRecordOffset(next_position_);
+  *legal = false;
+  if (offset + RECORD_HEADER_BYTES > size_) return true;
+  record->job_id = ReadAt<int32_t>(data_, offset);
+  record->num_map = ReadAt<int32_t>(data_, offset + 4);
+  record->num_red = ReadAt<int32_t>(data_, offset + 8);
+  record->arrival_ms = ReadAt<double>(data_, offset + 16);
+  offset += RECORD_HEADER_BYTES;
+  if (record->num_map < 0 || record->num_red < 0
+      || offset + record->num_map * 4 + record->num_red * (4 + 8) > size_) {
+    return true;
+  }
+  record->mapper_locations.resize(record->num_map);
+  for (int& location : record->mapper_locations) {
+    location = ReadAt<int32_t>(data_, offset);
+    offset += 4;
+  }
+  record->reducer_locations.resize(record->num_red);
+  for (int& location : record->reducer_locations) {
+    location = ReadAt<int32_t>(data_, offset);
+    offset += 4;
+  }
+  record->reducer_input_bytes.resize(record->num_red);
+  for (long& bytes : record->reducer_input_bytes) {
+    bytes = ReadAt<int64_t>(data_, offset);
+    offset += 8;
+  }
+  *legal = true;
+  return true;
+}
+
+uint64_t TraceReader::BinaryRecordOffset(uint64_t position) const {
+  return ReadAt<uint64_t>(
+      data_, time_index_offset_ + position * TIME_INDEX_ENTRY_BYTES + 8);
+}
+
+void TraceReader::Pop() {
+  if (is_binary_) {
+    if (next_position_ < num_jobs_) next_position_++;
+  } else {
+    cursor_ = peeked_end_;
+  }
+}
+
+void TraceReader::SeekToTime(double arrival_ms) {
+  if (is_binary_) {
+    // first position in [next_position_, num_jobs_) arriving no earlier.
+    uint64_t low = next_position_, high = num_jobs_;
+    while (low < high) {
+      uint64_t mid = low + (high - low) / 2;
+      double mid_arrival_ms = ReadAt<double>(
+          data_, time_index_offset_ + mid * TIME_INDEX_ENTRY_BYTES);
+      if (mid_arrival_ms < arrival_ms) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    next_position_ = low;
+    return;
+  }
+  TraceRecord record;
+  bool legal;
+  while (Peek(&record, &legal) && (!legal || record.arrival_ms < arrival_ms)) {
+    Pop();
+  }
+}
+
+bool TraceReader::SeekToJob(int job_id) {
+  if (is_binary_) {
+    uint64_t low = 0, high = num_jobs_;
+    while (low < high) {
+      uint64_t mid = low + (high - low) / 2;
+      int64_t mid_id = ReadAt<int64_t>(
+          data_, id_index_offset_ + mid * ID_INDEX_ENTRY_BYTES);
+      if (mid_id < job_id) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == num_jobs_ || ReadAt<int64_t>(
+        data_, id_index_offset_ + low * ID_INDEX_ENTRY_BYTES) != job_id) {
+      return false;
+    }
+    next_position_ = ReadAt<uint64_t>(
+        data_, id_index_offset_ + low * ID_INDEX_ENTRY_BYTES + 8);
+    return true;
+  }
+  const char* cursor = cursor_;
+  cursor_ = data_;
+  TraceRecord record;
+  bool legal;
+  while (Peek(&record, &legal)) {
+    if (legal && record.job_id == job_id) return true;
+    Pop();
+  }
+  cursor_ = cursor;
+  return false;
+}
+
+// static
+bool TraceReader::ParseCoflowInfo(const char* begin, const char* end,
+                                  int num_map, int num_red,
+                                  TraceRecord* record) {
+  record->mapper_locations.clear();
+  record->reducer_locations.clear();
+  record->reducer_input_bytes.clear();
+  const char* p = begin;
+  // m1,m2,...#
+  while (true) {
+    int location;
+    if (!ParseInt(p, end, &location)) return false;
+    record->mapper_locations.push_back(location);
+    if (p < end && *p == ',') {
+      p++;
+      continue;
+    }
+    if (p < end && *p == '#') {
+      p++;
+      break;
+    }
+    return false;
+  }
+  // r1:MB1,r2:MB2,...
+  while (true) {
+    int location;
+    long input_MB;
+    if (!ParseInt(p, end, &location)
+        || p == end || *p++ != ':'
+        || !ParseLong(p, end, &input_MB)) {
+      return false;
+    }
+    record->reducer_locations.push_back(location);
+    record->reducer_input_bytes.push_back(1000000 * input_MB);
+    if (p == end) break;
+    if (*p++ != ',') return false;
+  }
+  if (record->mapper_locations.size() != num_map
+      || record->reducer_locations.size() != num_red) {
+    cout << __func__ << ": number of mappers or reducers does not match."
+         << endl;
+    return false;
+  }
+  return true;
+}
+
+void ConvertTraceToBinary(const string& text_file_name,
+                          const string& binary_file_name) {
+  TraceReader reader(text_file_name);
+  if (reader.IsBinary()) {
+    cerr << "[ConvertTraceToBinary] ERROR: " << text_file_name
+         << " is already binary" << endl;
+    exit(-1);
+  }
+  vector<char> buffer(HEADER_BYTES, 0);
+  // (arrival_ms, record offset) and (id, position) of each coflow.
+  vector<pair<double, uint64_t>> time_index;
+  vector<pair<int64_t, uint64_t>> id_index;
+  TraceRecord record;
+  bool legal;
+  for (; reader.Peek(&record, &legal); reader.Pop()) {
+    if (!legal) {
+      cerr << "[ConvertTraceToBinary] ERROR: illegal line after "
+           << time_index.size() << " coflows" << endl;
+      exit(-1);
+    }
+    if (!time_index.empty() && record.arrival_ms < time_index.back().first) {
+      cerr << "[ConvertTraceToBinary] ERROR: coflow " << record.job_id
+           << " arrives before the previous one" << endl;
+      exit(-1);
+    }
+    id_index.push_back(std::make_pair(record.job_id, time_index.size()));
+    time_index.push_back(std::make_pair(record.arrival_ms, buffer.size()));
+    Append<int32_t>(&buffer, record.job_id);
+    Append<int32_t>(&buffer, record.num_map);
+    Append<int32_t>(&buffer, record.num_red);
+    Append<int32_t>(&buffer, 0);
+    Append<double>(&buffer, record.arrival_ms);
+    for (int location : record.mapper_locations) {
+      Append<int32_t>(&buffer, location);
+    }
+    for (int location : record.reducer_locations) {
+      Append<int32_t>(&buffer, location);
+    }
+    for (long bytes : record.reducer_input_bytes) {
+      Append<int64_t>(&buffer, bytes);
+    }
+    buffer.resize((buffer.size() + 7) / 8 * 8, 0);
+  }
+  std::stable_sort(id_index.begin(), id_index.end());
+
+  uint64_t time_index_offset = buffer.size();
+  for (const auto& arrival_offset : time_index) {
+    Append<double>(&buffer, arrival_offset.first);
+    Append<uint64_t>(&buffer, arrival_offset.second);
+  }
+  uint64_t id_index_offset = buffer.size();
+  for (const auto& id_position : id_index) {
+    Append<int64_t>(&buffer, id_position.first);
+    Append<uint64_t>(&buffer, id_position.second);
+  }
+  memcpy(buffer.data(), TraceReader::BINARY_MAGIC,
+         sizeof(TraceReader::BINARY_MAGIC));
+  WriteAt<uint32_t>(&buffer, 4, TraceReader::BINARY_VERSION);
+  WriteAt<uint64_t>(&buffer, 8, time_index.size());
+  WriteAt<uint64_t>(&buffer, 16, HEADER_BYTES);
+  WriteAt<uint64_t>(&buffer, 24, time_index_offset);
+  WriteAt<uint64_t>(&buffer, 32, id_index_offset);
+
+  ofstream binary_file(binary_file_name, ios::binary | ios::trunc);
+  if (!binary_file.is_open()) {
+    cerr << "[ConvertTraceToBinary] ERROR: unable to open file "
+         << binary_file_name << endl;
+    exit(-1);
+  }
+  binary_file.write(buffer.data(), buffer.size());
+}
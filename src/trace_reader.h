@@ -0,0 +1,118 @@
+//
+//  trace_reader.h
+//  Ximulator
+//
+//  Reader of coflow traces, memory-mapped. Two formats are detected from the
+//  content of the file:
+//  - text, as trace/fbtrace-1hr.txt, one coflow per line:
+//      id arrival_ms num_map num_red m1,m2,...#r1:MB1,r2:MB2,...
+//    Lines are tokenized in place, without copying fields into strings.
+//  - binary, converted from text by ConvertTraceToBinary() or the
+//    trace_converter tool. See below for the layout.
+//  The reader keeps a cursor on the next coflow, so that a coflow may be
+//  peeked before it is consumed.
+//
+//  Binary layout, in the byte order of the machine:
+//    header   : "XTRC", uint32 version, uint64 num_jobs,
+//               uint64 offsets of the records, time index and id index.
+//    records  : per coflow, int32 id, num_map, num_red, 0, double
+//               arrival_ms, int32 mapper locations[num_map], int32 reducer
+//               locations[num_red], int64 reducer input bytes[num_red],
+//               padded to 8 bytes.
+//    time idx : per coflow in the order of the trace, double arrival_ms and
+//               uint64 offset of its record.
+//    id idx   : per coflow in ascending id, int64 id and uint64 position in
+//               the time index.
+//
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A coflow of the trace.
+struct TraceRecord {
+  int job_id = 0;
+  double arrival_ms = 0;
+  int num_map = 0;
+  int num_red = 0;
+  // original locations of the mappers and reducers, in order.
+  vector<int> mapper_locations;
+  vector<int> reducer_locations;
+  // input bytes of each reducer, rounded down to MB.
+  vector<long> reducer_input_bytes;
+};
+
+// A stream of coflows in the order of arrival.
+class TraceSource {
+ public:
+  virtual ~TraceSource() {}
+  // Get the next coflow into record, without consuming it. Returns false at
+  // the end of the stream. If the coflow is illegal, *legal is set false and
+  // record is undefined.
+  virtual bool Peek(TraceRecord* record, bool* legal) = 0;
+  // Consume the coflow of the last Peek().
+  virtual void Pop() = 0;
+};
+
+class TraceReader : public TraceSource {
+ public:
+  // Exits if the file can not be mapped.
+  explicit TraceReader(const string& file_name);
+  virtual ~TraceReader();
+
+  bool IsBinary() const { return is_binary_; }
+
+  // The trace ends at the end of the file or an empty line.
+  virtual bool Peek(TraceRecord* record, bool* legal);
+  virtual void Pop();
+
+  // Move the cursor to the first coflow arriving at or after arrival_ms, by
+  // the time index of binary traces. Text traces are scanned from the
+  // cursor, whose arrivals must not decrease.
+  void SeekToTime(double arrival_ms);
+  // Move the cursor to the coflow of job_id, by the id index of binary
+  // traces. Text traces are scanned from the start. Returns false if absent.
+  bool SeekToJob(int job_id);
+
+  // Parse "m1,m2,...#r1:MB1,r2:MB2,..." of [begin, end) for num_map mappers
+  // and num_red reducers into record. Returns false if illegal.
+  static bool ParseCoflowInfo(const char* begin, const char* end,
+                              int num_map, int num_red, TraceRecord* record);
+
+  static const char BINARY_MAGIC[4];
+  static const uint32_t BINARY_VERSION;
+
+ private:
+  bool PeekText(TraceRecord* record, bool* legal);
+  bool PeekBinary(TraceRecord* record, bool* legal);
+  // offset of the record of the coflow at position in the time index.
+  uint64_t BinaryRecordOffset(uint64_t position) const;
+
+  const char* data_;
+  size_t size_;
+  bool is_binary_;
+
+  // text: start of the next line.
+  const char* cursor_;
+  // text: end of the line of the last Peek(), including the line break.
+  const char* peeked_end_;
+
+  // binary: from the header.
+  uint64_t num_jobs_;
+  uint64_t time_index_offset_;
+  uint64_t id_index_offset_;
+  // binary: position of the next coflow in the time index.
+  uint64_t next_position_;
+};
+
+// Convert a text trace into the binary format. Exits on an illegal line or
+// on arrivals out of order, which would break the time index.
+void ConvertTraceToBinary(const string& text_file_name,
+                          const string& binary_file_name);
+
+#endif //TRACE_READER_H
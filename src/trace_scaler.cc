@@ -0,0 +1,176 @@
+//
+//  trace_scaler.cc
+//  Ximulator
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "trace_scaler.h"
+
+TraceScalerOptions
+TraceScalerOptions::FromName(const string& name, int num_racks) {
+  TraceScalerOptions options;
+  options.num_racks = num_racks;
+  vector<string> fields;
+  stringstream ss(name);
+  string field;
+  while (getline(ss, field, '_')) fields.push_back(field);
+  try {
+    if (fields.size() > 0) options.mode = fields[0];
+    if (fields.size() > 1) options.copies = stoi(fields[1]);
+    if (fields.size() > 2) options.shift_ms = 1000 * stod(fields[2]);
+    if (fields.size() > 3) options.seed = stoul(fields[3]);
+  } catch (const exception& e) {
+    cerr << "[TraceScalerOptions::FromName] ERROR: illegal field in "
+         << name << endl;
+    exit(-1);
+  }
+  if ((options.mode != "random" && options.mode != "locality"
+      && options.mode != "hash") || options.copies < 1
+      || options.shift_ms < 0 || options.num_racks <= 0
+      || fields.size() > 4) {
+    cerr << "[TraceScalerOptions::FromName] ERROR: illegal " << name
+         << ", expect <random|locality|hash>_<copies>_<shift sec>_<seed>"
+         << endl;
+    exit(-1);
+  }
+  return options;
+}
+
+TraceScaler::TraceScaler(TraceSource* source,
+                         const TraceScalerOptions& options)
+    : source_(source), options_(options), rng_(options.seed),
+      num_pending_(0), source_done_(false), last_arrival_ms_(0) {
+  taken_.assign(options_.num_racks, false);
+}
+
+bool TraceScaler::ArrivesAfter(const Pending& a, const Pending& b) {
+  if (a.record.arrival_ms != b.record.arrival_ms) {
+    return a.record.arrival_ms > b.record.arrival_ms;
+  }
+  return a.sequence > b.sequence;
+}
+
+bool TraceScaler::Peek(TraceRecord* record, bool* legal) {
+  Fill();
+  if (pending_.empty()) return false;
+  *record = pending_.front().record;
+  *legal = pending_.front().legal;
+  return true;
+}
+
+void TraceScaler::Pop() {
+  Fill();
+  if (pending_.empty()) return;
+  pop_heap(pending_.begin(), pending_.end(), ArrivesAfter);
+  pending_.pop_back();
+}
+
+void TraceScaler::Fill() {
+  TraceRecord record;
+  bool legal;
+  while (!source_done_) {
+    if (!source_->Peek(&record, &legal)) {
+      source_done_ = true;
+      break;
+    }
+    double arrival_ms = legal ? record.arrival_ms : last_arrival_ms_;
+    // copies arrive no earlier than the original, so the earliest pending
+    // copy is next once the source is past it.
+    if (!pending_.empty()
+        && arrival_ms > pending_.front().record.arrival_ms) {
+      break;
+    }
+    source_->Pop();
+    if (legal) {
+      last_arrival_ms_ = arrival_ms;
+      AddCopies(record);
+    } else {
+      pending_.push_back(Pending());
+      pending_.back().record.arrival_ms = arrival_ms;
+      pending_.back().legal = false;
+      pending_.back().sequence = num_pending_++;
+      push_heap(pending_.begin(), pending_.end(), ArrivesAfter);
+    }
+  }
+}
+
+void TraceScaler::AddCopies(const TraceRecord& record) {
+  for (int copy = 0; copy < options_.copies; copy++) {
+    pending_.push_back(Pending());
+    Pending& pending = pending_.back();
+    pending.record = record;
+    pending.legal = true;
+    pending.sequence = num_pending_++;
+    pending.record.job_id = record.job_id * options_.copies + copy;
+    if (copy > 0 && options_.shift_ms > 0) {
+      pending.record.arrival_ms += floor(Uniform() * options_.shift_ms);
+    }
+    // mappers and reducers share the map, to keep shared racks shared.
+    rack_map_.clear();
+    Remap(copy, &pending.record.mapper_locations);
+    Remap(copy, &pending.record.reducer_locations);
+    for (const auto& kv : rack_map_) taken_[kv.second] = false;
+    push_heap(pending_.begin(), pending_.end(), ArrivesAfter);
+  }
+}
+
+void TraceScaler::Remap(int copy, vector<int>* locations) {
+  for (int& location : *locations) {
+    auto it = rack_map_.find(location);
+    if (it != rack_map_.end()) {
+      location = it->second;
+      continue;
+    }
+    int rack;
+    // distinct racks of the trace fit on distinct racks, so a rack taken by
+    // the coflow is passed over for the next one. Otherwise flows between
+    // them would be dropped as local.
+    bool probe = options_.num_racks >= options_.trace_racks
+        && (int) rack_map_.size() < options_.num_racks;
+    if (options_.mode == "hash") {
+      // splitmix64 of the rack, copy and seed, and then the next outputs of
+      // its sequence.
+      for (uint64_t attempt = 0; ; attempt++) {
+        uint64_t z = ((uint64_t) location << 32 | (uint32_t) copy)
+            + (options_.seed + attempt) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        rack = (int) (z % options_.num_racks);
+        if (!probe || !taken_[rack]) break;
+      }
+    } else if (options_.mode == "locality") {
+      // block of the rack of the trace, at least one rack.
+      long begin = (long) location * options_.num_racks / options_.trace_racks;
+      long end =
+          (long) (location + 1) * options_.num_racks / options_.trace_racks;
+      end = max(end, begin + 1);
+      long offset = (long) (Uniform() * (end - begin));
+      rack = (int) ((begin + offset) % options_.num_racks);
+      // the next racks of the block, wrapping around.
+      for (long step = 1; probe && taken_[rack] && step < end - begin;
+           step++) {
+        rack = (int) ((begin + (offset + step) % (end - begin))
+            % options_.num_racks);
+      }
+    } else {
+      // a rack not taken by the coflow, unless all are taken.
+      bool all_taken = (int) rack_map_.size() >= options_.num_racks;
+      do {
+        rack = (int) (Uniform() * options_.num_racks);
+      } while (taken_[rack] && !all_taken);
+    }
+    taken_[rack] = true;
+    rack_map_[location] = rack;
+    location = rack;
+  }
+}
+
+double TraceScaler::Uniform() {
+  // 53 random bits in [0, 1).
+  return (rng_() >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,94 @@
+//
+//  trace_scaler.h
+//  Ximulator
+//
+//  Scale the coflows of a TraceSource onto a larger fabric, keeping the
+//  structure of each coflow. Locations of the trace's racks are remapped onto
+//  num_racks racks, in one of the modes:
+//  - random: per coflow, each rack of the trace is placed on a random rack.
+//  - locality: rack r of the trace owns a block of num_racks / trace_racks
+//    racks, and is placed on a random rack of its block, per coflow. Coflows
+//    keep their skew over the racks of the trace.
+//  - hash: rack r of the trace is placed by a hash of r and the copy, the
+//    same for every coflow.
+//  Racks shared by the mappers and reducers of a coflow stay shared, and
+//  distinct racks stay distinct if num_racks >= trace_racks: hash and
+//  locality pass over racks taken by the coflow to the next rack of the hash
+//  sequence, or of the block. Each coflow may be replicated into copies of
+//  fresh placements, each arriving within shift_ms after the original, to
+//  multiply the load. Copies are buffered until their arrival, so that
+//  coflows stay in the order of arrival.
+//
+
+#ifndef TRACE_SCALER_H
+#define TRACE_SCALER_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_reader.h"
+
+using namespace std;
+
+struct TraceScalerOptions {
+  // "random", "locality" or "hash".
+  string mode = "random";
+  // copies per coflow of the trace, including the original.
+  int copies = 1;
+  // copies but the original are shifted uniformly within [0, shift_ms).
+  double shift_ms = 0;
+  unsigned long seed = 1;
+  // racks of the trace, and of the fabric.
+  int trace_racks = 150;
+  int num_racks = 150;
+
+  // Parse "<mode>_<copies>_<shift sec>_<seed>" into options, where trailing
+  // fields may be omitted for their defaults. Exits on illegal fields.
+  static TraceScalerOptions FromName(const string& name, int num_racks);
+};
+
+class TraceScaler : public TraceSource {
+ public:
+  // source is owned. The copy of a coflow of id j has id
+  // j * copies + copy, which is j without copies.
+  TraceScaler(TraceSource* source, const TraceScalerOptions& options);
+  virtual ~TraceScaler() {}
+
+  virtual bool Peek(TraceRecord* record, bool* legal);
+  virtual void Pop();
+
+ private:
+  struct Pending {
+    TraceRecord record;
+    bool legal;
+    // order of the copy, to break ties of arrival.
+    long sequence;
+  };
+  // true if a arrives after b, for a min-heap of arrival.
+  static bool ArrivesAfter(const Pending& a, const Pending& b);
+
+  // Move coflows of the source into pending_ up to the earliest pending one.
+  void Fill();
+  void AddCopies(const TraceRecord& record);
+  void Remap(int copy, vector<int>* locations);
+  double Uniform();
+
+  unique_ptr<TraceSource> source_;
+  const TraceScalerOptions options_;
+  mt19937_64 rng_;
+  // min-heap of copies not popped yet.
+  vector<Pending> pending_;
+  long num_pending_;
+  bool source_done_;
+  // arrival of the last coflow of the source, for illegal coflows.
+  double last_arrival_ms_;
+  // rack of each rack of the trace in the coflow being remapped, and racks
+  // taken by it.
+  unordered_map<int, int> rack_map_;
+  vector<char> taken_;
+};
+
+#endif //TRACE_SCALER_H
@@ -45,9 +45,6 @@ TrafficGen::~TrafficGen() {
   cout << "" << m_totalFCT << " ";
   cout << endl;
 
-  if (m_jobTraceFile.is_open()) {
-    m_jobTraceFile.close();
-  }
   if (m_cctAuditFile.is_open()) {
     m_cctAuditFile << "Done" << " ";
     m_cctAuditFile << m_total_met_deadline_num
@@ -80,7 +77,10 @@ TrafficGen::UpdateAlarm() {
 ///////////// Code for FB Trace Replay   ///////////
 ////////////////////////////////////////////////////
 
-TGTraceFB::TGTraceFB(DbLogger* db_logger) {
+const int TGTraceFB::PREFETCH_CAPACITY_ = 4096;
+const int TGTraceFB::BUILD_BATCH_PER_THREAD_ = 8;
+
+TGTraceFB::TGTraceFB(DbLogger* db_logger, TraceSource* trace_source) {
 
   db_logger_ = db_logger;
 
@@ -90,12 +90,36 @@ TGTraceFB::TGTraceFB(DbLogger* db_logger) {
   m_coflow2job = map<Coflow*, JobDesc*>();
 
   // coflow trace
-  m_jobTraceFile.open(TRAFFIC_TRACE_FILE_NAME);
-  if (!m_jobTraceFile.is_open()) {
-    cout << "Error: unable to open file "
-         << TRAFFIC_TRACE_FILE_NAME << endl;
-    cout << "Now terminate the program" << endl;
-    exit(-1);
+  trace_start_ms_ = 0;
+  if (!trace_source) {
+    TraceReader* trace_reader = new TraceReader(TRAFFIC_TRACE_FILE_NAME);
+    if (TRACE_START_JOB_ID >= 0 || TRACE_START_MS > 0) {
+      if (TRACE_START_JOB_ID < 0) {
+        trace_reader->SeekToTime(TRACE_START_MS);
+      } else if (!trace_reader->SeekToJob(TRACE_START_JOB_ID)) {
+        cerr << "[TGTraceFB::TGTraceFB] ERROR: no coflow "
+             << TRACE_START_JOB_ID << " in " << TRAFFIC_TRACE_FILE_NAME
+             << endl;
+        exit(-1);
+      }
+      bool legal;
+      if (trace_reader->Peek(&trace_record_, &legal) && legal) {
+        trace_start_ms_ = trace_record_.arrival_ms;
+      }
+    }
+    trace_source = trace_reader;
+  }
+  if (!TRACE_SCALE.empty()) {
+    trace_source = new TraceScaler(
+        trace_source, TraceScalerOptions::FromName(TRACE_SCALE, NUM_RACKS));
+  }
+  if (TRACE_PREFETCH_WINDOW_SEC > 0) {
+    trace_source = new TracePrefetcher(
+        trace_source, TRACE_PREFETCH_WINDOW_SEC * 1000, PREFETCH_CAPACITY_);
+  }
+  trace_source_.reset(trace_source);
+  if (NUM_TRAFFIC_THREADS > 1) {
+    build_pool_.reset(new WorkerPool(NUM_TRAFFIC_THREADS));
   }
 
   // output files
@@ -115,12 +139,12 @@ TGTraceFB::TGTraceFB(DbLogger* db_logger) {
     exit(-1);
   }
 
-  int seed_for_perturb_seed = 13;
-  InitSeedForCoflows(seed_for_perturb_seed);
+  rand_seed_ = 13;
 
 }
 
 TGTraceFB::~TGTraceFB() {
+  for (const BuiltCoflow& built : built_coflows_) delete built.coflow;
   if (!m_runningJob.empty()) {
     //error
     cout << "[TGTraceFB::~TGTraceFB()] Error: "
@@ -194,7 +218,9 @@ TGTraceFB::NotifyTrafficFinish(double alarm_time,
         && flow->GetEndTime() >= flow->GetStartTime()) {
       // This flow is properly done.
       // A valid start/end time => count FCT
-      m_totalFCT += (flow->GetEndTime() - flow->GetStartTime());
+      // members of a flow group, and flows merged, finish together.
+      m_totalFCT += (flow->GetEndTime() - flow->GetStartTime())
+          * flow->GetNumMembers() * flow->GetNumMerged();
       if (db_logger_) {
         db_logger_->WriteOnFlowFinish(alarm_time, flow, m_fctAuditFile);
       }
@@ -276,7 +302,6 @@ TGTraceFB::NotifyTrafficFinish(double alarm_time,
       cout << "Error: the job to delete is not found in the running jobs!\n";
     } else {
       m_runningJob.erase(runJIt);
-      m_finishJob.push_back(jp2rm);
     }
   }
 }
@@ -338,70 +363,48 @@ TGTraceFB::ScheduleToAddJobs(vector<JobDesc*>& jobs_to_add) {
   }
 }
 
-// read next job(s)
-// the last job trace line
-// should end with return
+// read next job(s) arriving at the same time.
+// the trace ends at the end of the file or an empty line.
 vector<JobDesc*>
 TGTraceFB::ReadJobs() {
 
   vector<JobDesc*> result;
 
-  string jobLine = "";
-
   long firstJobTime = -1;
 
-  while (!m_jobTraceFile.eof()) {
-
-    getline(m_jobTraceFile, jobLine);
-
-    if (jobLine.size() <= 0) {
-      // return after reading all lines in the file
-      //cout << "no more jobs are available!" << endl;
+  while (true) {
+    if (built_coflows_.empty()) BuildCoflowsAhead();
+    if (built_coflows_.empty()) break;
+    BuiltCoflow built = built_coflows_.front();
+    if (!built.legal) {
+      built_coflows_.pop_front();
+      cout << "[TGTraceFB::ReadJobs] illegal line! "
+           << "Return with job list." << endl;
       return result;
     }
 
-    //    vector<string> subFields;
-    //    long numFields = split(jobLine, subFields, '\t');
-    //    assert(numFields == 5);
-
-    std::istringstream ss(jobLine);
-    vector<std::string> fields(5);
-    if (!(ss >> fields[0] >> fields[1] >> fields[2] >> fields[3]
-             >> fields[4])) {
+    long jobOffArrivalTimel = (long) built.arrival_ms;
+    if (firstJobTime >= 0 && jobOffArrivalTimel > firstJobTime) {
+      // return because the next job has exceed the current jobs' arrival
+      // time, leaving the coflow to the next call.
       return result;
     }
+    built_coflows_.pop_front();
 
-    long jobOffArrivalTimel = stol(fields[1]);
-    int jobid = stoi(fields[0]);
-    // jobOffArrivalTime in seconds.
-    double jobOffArrivalTime = stod(fields[1])
-        / 1000.0 / TRAFFIC_ARRIVAL_SPEEDUP;
-    int map = stoi(fields[2]);
-    int red = stoi(fields[3]);
-
-    // if ENABLE_PERTURB_IN_PLAY = true, perturb flow sizes.
-    // if EQUAL_FLOW_TO_SAME_REDUCER = true, all flows to the same reducer
-    //     will be the of the same size.
-    Coflow* cfp = CreateCoflowPtrFromString(jobOffArrivalTime, jobid,
-                                            map, red, fields[4],
-                                            ENABLE_PERTURB_IN_PLAY,
-                                            EQUAL_FLOW_TO_SAME_REDUCER);
+    Coflow* cfp = built.coflow;
     if (cfp) {
       if (firstJobTime < 0) {
         firstJobTime = jobOffArrivalTimel;
       }
-
-      if (jobOffArrivalTimel > firstJobTime) {
-        // return because the next job has exceed the current jobs' arrival time
-        //seek back file seeker and return
-        m_jobTraceFile.seekg(-(jobLine.length() + 1), m_jobTraceFile.cur);
-        return result;
-      }
+      // ids in the order of arrival, as if the coflow were built now.
+      cfp->AssignIds();
 
       int num_flow = (int) cfp->GetFlows()->size();
-      JobDesc* newJobPtr = new JobDesc(jobid,
-                                       jobOffArrivalTime,
-                                       map, red, num_flow, cfp);
+      JobDesc* newJobPtr = new JobDesc(built.job_id,
+                                       cfp->GetStartTime(),
+                                       built.num_map,
+                                       built.num_red,
+                                       num_flow, cfp);
       // add entry into the map
       m_coflow2job.insert(pair<Coflow*, JobDesc*>(cfp, newJobPtr));
       result.push_back(newJobPtr);
@@ -411,6 +414,50 @@ TGTraceFB::ReadJobs() {
   return result;
 }
 
+
+void TGTraceFB::BuildCoflowsAhead() {
+  int batch_size = build_pool_
+                   ? build_pool_->GetNumThreads() * BUILD_BATCH_PER_THREAD_
+                   : 1;
+  if ((int) build_records_.size() < batch_size) {
+    build_records_.resize(batch_size);
+  }
+  size_t first = built_coflows_.size();
+  bool legal;
+  while ((int) (built_coflows_.size() - first) < batch_size
+      && trace_source_->Peek(&build_records_[built_coflows_.size() - first],
+                             &legal)) {
+    trace_source_->Pop();
+    const TraceRecord& record = build_records_[built_coflows_.size() - first];
+    built_coflows_.push_back({record.job_id, record.arrival_ms,
+                              record.num_map, record.num_red, legal,
+                              nullptr});
+  }
+  int num_built = (int) (built_coflows_.size() - first);
+  auto build = [&](int i) {
+    BuiltCoflow& built = built_coflows_[first + i];
+    if (!built.legal) return;
+    // jobOffArrivalTime in seconds.
+    double jobOffArrivalTime = (built.arrival_ms - trace_start_ms_)
+        / 1000.0 / TRAFFIC_ARRIVAL_SPEEDUP;
+    // if ENABLE_PERTURB_IN_PLAY = true, perturb flow sizes.
+    // if EQUAL_FLOW_TO_SAME_REDUCER = true, all flows to the same reducer
+    //     will be the of the same size.
+    bool defer_ids = Coflow::defer_ids_;
+    Coflow::defer_ids_ = true;
+    built.coflow = CreateCoflowFromRecord(jobOffArrivalTime,
+                                          build_records_[i],
+                                          ENABLE_PERTURB_IN_PLAY,
+                                          EQUAL_FLOW_TO_SAME_REDUCER);
+    Coflow::defer_ids_ = defer_ids;
+  };
+  if (build_pool_ && num_built > 1) {
+    build_pool_->ParallelFor(num_built, build);
+  } else {
+    for (int i = 0; i < num_built; i++) build(i);
+  }
+}
+
 class ResourceRequestGenerator {
  public:
   ResourceRequestGenerator(const double rv_values[],
@@ -439,26 +486,35 @@ TGTraceFB::CreateCoflowPtrFromString(double time, int coflow_id,
   //  cout << "[TGTraceFB::CreateCoflowPtrFromString] "
   //       << "Creating coflow #"<< coflow_id << endl;
 
-  vector<string> subFields;
-  if (split(cfInfo, subFields, '#') != 2) {
+  TraceRecord record;
+  record.job_id = coflow_id;
+  record.num_map = num_map;
+  record.num_red = num_red;
+  if (!TraceReader::ParseCoflowInfo(cfInfo.data(),
+                                    cfInfo.data() + cfInfo.size(),
+                                    num_map, num_red, &record)) {
     cout << __func__ << ": number of fields illegal!"
          << "Return with NULL coflow ptr." << endl;
     return NULL;
   }
+  return CreateCoflowFromRecord(time, record, do_perturb, avg_size);
+}
 
+Coflow*
+TGTraceFB::CreateCoflowFromRecord(double time, const TraceRecord& record,
+                                  bool do_perturb, bool avg_size) {
+  int coflow_id = record.job_id;
+  int num_map = record.num_map;
+  int num_red = record.num_red;
   // Obtain traffic requirements.
-  // map from (mapper_idx, reducer_idx) to flow size in bytes. Mappers and
+  // matrix of (mapper_idx, reducer_idx) to flow size in bytes. Mappers and
   // reducers are virtually indexed within this coflow. The actual placement of
   // the mapper and reducer tasks are to be determined.
-  vector<int> mapper_original_locations, reducer_original_locations;
-  mapper_original_locations = GetMapperOriginalLocFromString(num_map,
-                                                             subFields[0]);
-  vector<long> reducer_input_bytes;
-  GetReducerInfoFromString(num_red, subFields[1],
-                           &reducer_original_locations,
-                           &reducer_input_bytes);
-
-  map<pair<int, int>, long> mr_flow_bytes;
+  const vector<int>& mapper_original_locations = record.mapper_locations;
+  const vector<int>& reducer_original_locations = record.reducer_locations;
+  const vector<long>& reducer_input_bytes = record.reducer_input_bytes;
+
+  FlowSizeMatrix mr_flow_bytes;
   if (!do_perturb) {
     if (avg_size) {
       mr_flow_bytes = GetFlowSizeWithEqualSizeToSameReducer(
@@ -471,17 +527,18 @@ TGTraceFB::CreateCoflowPtrFromString(double time, int coflow_id,
     // let us allow some random perturbation.
     mr_flow_bytes = GetFlowSizeWithPerturb(
         num_map, num_red, reducer_input_bytes,
-        5/* hard code of +/-5% */, GetSeedForCoflow(coflow_id));
+        5/* hard code of +/-5% */, coflow_id);
   }
-  if (mr_flow_bytes.size() != num_map * num_red) {
+  if (mr_flow_bytes.GetNumMap() != num_map
+      || mr_flow_bytes.GetNumRed() != num_red) {
     cout << "Error: The number of flows does not match. Exit with error.\n";
     exit(-1);
   }
   if (TRAFFIC_SIZE_INFLATE != 1.0) {
-    for (auto& pair: mr_flow_bytes) {
-      pair.second *= TRAFFIC_SIZE_INFLATE;
-      if (pair.second < 1e6) {
-        pair.second = 1e6; // all flows >= 1MB;
+    for (long& flow_bytes : mr_flow_bytes.GetBytes()) {
+      flow_bytes *= TRAFFIC_SIZE_INFLATE;
+      if (flow_bytes < 1e6) {
+        flow_bytes = 1e6; // all flows >= 1MB;
       }
     }
   }
@@ -512,7 +569,7 @@ TGTraceFB::CreateCoflowPtrFromString(double time, int coflow_id,
 
   // create the coflow based on the coflow configs
   Coflow* coflow = CreateCoflow(coflow_id, time,
-                                num_map, num_red, mr_flow_bytes,
+                                num_map, num_red, std::move(mr_flow_bytes),
                                 mapper_locations, reducer_locations);
 
   if (!coflow) {
@@ -524,11 +581,9 @@ TGTraceFB::CreateCoflowPtrFromString(double time, int coflow_id,
     double lb_optc = coflow->GetMaxOptimalWorkSpanInSeconds();
     double lb_elec
         = ((double) coflow->GetLoadOnMaxOptimalWorkSpanInBits()) / ELEC_BPS;
-    unsigned int rand_seed = GetSeedForCoflow(coflow_id);
-    std::mt19937 mt_rand(rand_seed); // srand(rand_seed);
+    CounterRng rng(rand_seed_, coflow_id, CounterRng::COFLOW_STREAM);
     // currently we assume the inflation x = 1;
-    double deadline
-        = lb_optc + lb_optc * (((double) (mt_rand() % 100)) / 100.0);
+    double deadline = lb_optc + lb_optc * (rng.Below(100) / 100.0);
     coflow->SetDeadlineSec(deadline);
     if (DEBUG_LEVEL >= 10) {
       cout << " lb_elec " << lb_elec << " lb_optc " << lb_optc
@@ -541,23 +596,44 @@ TGTraceFB::CreateCoflowPtrFromString(double time, int coflow_id,
 
 Coflow* TGTraceFB::CreateCoflow(int coflow_id, double arrival_time,
                                 int num_map, int num_red,
-                                const map<pair<int, int>, long>& mr_flow_bytes,
+                                FlowSizeMatrix mr_flow_bytes,
                                 const vector<int>& mapper_locations,
                                 const vector<int>& reducer_locations) {
   // Create flows by marrying the placement decisions with traffic requirements.
   vector<Flow*> flows;
-  for (const auto& kv_pair : mr_flow_bytes) {
-    int mapper_idx = kv_pair.first.first;
-    int reducer_idx = kv_pair.first.second;
-    long flow_bytes = kv_pair.second;
-    int src = mapper_locations[mapper_idx];
-    int dst = reducer_locations[reducer_idx];
-    if (!REMOTE_IN_OUT_PORTS && src == dst) {
-      // we choose not to add traffic with the same source and destination so
-      // as to avoid error in scheduler.
-      continue;
+  if (FLOW_GROUPS) {
+    CreateFlowGroups(arrival_time, num_map, num_red, mr_flow_bytes,
+                     mapper_locations, reducer_locations, &flows);
+  } else {
+    flows.reserve(mr_flow_bytes.GetNumFlows());
+    // only ports of racks constrain rates, so flows between the same racks,
+    // of tasks sharing a rack, may be merged into the first of them.
+    map<pair<int, int>, Flow*> flow_of_rack_pair;
+    for (int mapper_idx = 0; mapper_idx < num_map; mapper_idx++) {
+      int src = mapper_locations[mapper_idx];
+      for (int reducer_idx = 0; reducer_idx < num_red; reducer_idx++) {
+        int dst = reducer_locations[reducer_idx];
+        if (!REMOTE_IN_OUT_PORTS && src == dst) {
+          // we choose not to add traffic with the same source and destination
+          // so as to avoid error in scheduler.
+          continue;
+        }
+        long flow_bytes = mr_flow_bytes.At(mapper_idx, reducer_idx);
+        if (AGGREGATE_RACK_PAIRS) {
+          auto inserted =
+              flow_of_rack_pair.insert(make_pair(make_pair(src, dst), nullptr));
+          if (!inserted.second) {
+            inserted.first->second->MergeFlow(flow_bytes);
+            continue;
+          }
+          inserted.first->second = new Flow(arrival_time, src, dst, flow_bytes);
+          flows.push_back(inserted.first->second);
+        } else {
+          flows.push_back(new Flow(arrival_time, src, dst, flow_bytes));
+        }
+        flows.back()->SetIndexInCoflow(mapper_idx * num_red + reducer_idx);
+      }
     }
-    flows.push_back(new Flow(arrival_time, src, dst, flow_bytes));
   }
 
   if (flows.empty()) {
@@ -571,7 +647,6 @@ Coflow* TGTraceFB::CreateCoflow(int coflow_id, double arrival_time,
     flow->SetParentCoflow(coflow);
   }
   coflow->SetPlacement(mapper_locations, reducer_locations);
-  coflow->SetMRFlowBytes(mr_flow_bytes);
   // initialize the static alpha upon creation.
   coflow->SetStaticAlpha(coflow->CalcAlpha());
 
@@ -580,142 +655,121 @@ Coflow* TGTraceFB::CreateCoflow(int coflow_id, double arrival_time,
   vector<double> mapper_traffic_req_MB, reducer_traffic_req_MB;
   GetNodeReqTrafficMB(num_map, num_red, mr_flow_bytes,
                       &mapper_traffic_req_MB, &reducer_traffic_req_MB);
+  coflow->SetMRFlowBytes(std::move(mr_flow_bytes));
   coflow->SetMapReduceLoadMB(mapper_locations, reducer_locations,
                              mapper_traffic_req_MB, reducer_traffic_req_MB);
   coflow->SetJobId(coflow_id);
-  coflow->coflow_rand_seed_ = GetSeedForCoflow(coflow_id);
+  coflow->coflow_rand_seed_ = rand_seed_;
   return coflow;
 }
 
-vector<int>
-TGTraceFB::GetMapperOriginalLocFromString(int num_mapper_wanted,
-                                          const string& mapper_trace) {
-  vector<string> locations;
-  long num_fields = split(mapper_trace, locations, ',');
-  if (num_fields != num_mapper_wanted) {
-    cout << "ERROR: num_fields != num_mapper_wanted. "
-         << "Return empty assignments." << endl;
-    return vector<int>();
-  }
-  vector<int> result;
-  for (const string& loc : locations) {
-    result.push_back(std::stoi(loc));
-  }
-  return result;
-}
-
-void TGTraceFB::GetReducerInfoFromString(int num_reducer_wanted,
-                                         const string& reducer_trace,
-                                         vector<int>* original_locations,
-                                         vector<long>* reducer_input_bytes) {
-  original_locations->clear();
-  reducer_input_bytes->clear();
-
-  vector<string> reducer_info;
-  int num_fields = split(reducer_trace, reducer_info, ',');
-  if (num_fields != num_reducer_wanted) {
-    cout << __func__ << ": num_fields != num_reducer_wanted. "
-         << "Return empty assignments." << endl;
-    return;
-  }
-  for (int reducer_idx = 0; reducer_idx < num_reducer_wanted; reducer_idx++) {
-    vector<string> reducer_input_pair;
-    int num_sub_fields = split(reducer_info[reducer_idx],
-                               reducer_input_pair, ':');
-    if (num_sub_fields != 2) {
-      cout << __func__ << ": num_sub_fields != 2. Return empty assignments.\n";
-      return;
+void TGTraceFB::CreateFlowGroups(double arrival_time, int num_map, int num_red,
+                                 const FlowSizeMatrix& mr_flow_bytes,
+                                 const vector<int>& mapper_locations,
+                                 const vector<int>& reducer_locations,
+                                 vector<Flow*>* flows) {
+  // srcs and their flow indices of each group into the reducer, by flow
+  // size.
+  map<long, int> group_of_size;
+  vector<vector<int>> group_srcs, group_indices;
+  for (int reducer_idx = 0; reducer_idx < num_red; reducer_idx++) {
+    int dst = reducer_locations[reducer_idx];
+    group_of_size.clear();
+    group_srcs.clear();
+    group_indices.clear();
+    for (int mapper_idx = 0; mapper_idx < num_map; mapper_idx++) {
+      int src = mapper_locations[mapper_idx];
+      if (!REMOTE_IN_OUT_PORTS && src == dst) continue;
+      long flow_bytes = mr_flow_bytes.At(mapper_idx, reducer_idx);
+      auto inserted =
+          group_of_size.insert(make_pair(flow_bytes, (int) group_srcs.size()));
+      if (inserted.second) {
+        group_srcs.emplace_back();
+        group_indices.emplace_back();
+      }
+      group_srcs[inserted.first->second].push_back(src);
+      group_indices[inserted.first->second].push_back(
+          mapper_idx * num_red + reducer_idx);
+    }
+    for (int group_idx = 0; group_idx < (int) group_srcs.size(); group_idx++) {
+      int first_mapper = group_indices[group_idx].front() / num_red;
+      long flow_bytes = mr_flow_bytes.At(first_mapper, reducer_idx);
+      flows->push_back(new Flow(arrival_time, group_srcs[group_idx], dst,
+                                flow_bytes));
+      flows->back()->SetIndexInCoflow(group_indices[group_idx].front());
+      flows->back()->SetMemberIndicesInCoflow(group_indices[group_idx]);
     }
-    original_locations->push_back(std::stoi(reducer_input_pair[0]));
-    reducer_input_bytes->push_back(1000000 * stol(reducer_input_pair[1]));
   }
+  // in the order of the flows of the first members, as without groups.
+  sort(flows->begin(), flows->end(), [](Flow* l, Flow* r) {
+    return l->GetIndexInCoflow() < r->GetIndexInCoflow();
+  });
 }
 
 void TGTraceFB::GetNodeReqTrafficMB(
     int num_map, int num_red,
-    const map<pair<int, int>, long>& mr_flow_bytes,
+    const FlowSizeMatrix& mr_flow_bytes,
     vector<double>* mapper_traffic_req_MB,
     vector<double>* reducer_traffic_req_MB) {
   std::vector<double>(num_map).swap(*mapper_traffic_req_MB);
   std::vector<double>(num_red).swap(*reducer_traffic_req_MB);
-  for (const auto& kv_pair: mr_flow_bytes) {
-    double req_MB = (double) kv_pair.second / 1e6;
-    int mapper_idx = kv_pair.first.first;
-    mapper_traffic_req_MB->operator[](mapper_idx) += req_MB;
-    int reducer_idx = kv_pair.first.second;
-    reducer_traffic_req_MB->operator[](reducer_idx) += req_MB;
-  }
-}
-
-// use seed_for_seed to initialize the vector of m_seed_for_coflow,
-// in length of PERTURB_SEED_NUM.
-void TGTraceFB::InitSeedForCoflows(int seed_for_seed) {
-  std::mt19937 mt_rand(seed_for_seed); //  srand(seed_for_seed);
-  for (int i = 0; i < PERTURB_SEED_NUM; i++) {
-    m_seed_for_coflow.push_back(mt_rand()); // m_seed_for_coflow.push_back(rand());
-    // cout << " seed [" << i << "] = " << m_seed_for_coflow.back() << endl;
+  for (int mapper_idx = 0; mapper_idx < num_map; mapper_idx++) {
+    for (int reducer_idx = 0; reducer_idx < num_red; reducer_idx++) {
+      double req_MB = (double) mr_flow_bytes.At(mapper_idx, reducer_idx) / 1e6;
+      mapper_traffic_req_MB->operator[](mapper_idx) += req_MB;
+      reducer_traffic_req_MB->operator[](reducer_idx) += req_MB;
+    }
   }
 }
 
-int
-TGTraceFB::GetSeedForCoflow(int coflow_id) {
-  // use jobid to identify a unique seed;
-  int seed_idx = (coflow_id + 5122) % PERTURB_SEED_NUM;
-  int seed = m_seed_for_coflow[seed_idx];
-  // cout << "job id " << coflow_id << " seed " << seed << endl;
-  return seed;
-}
-
 // sum( flows to a reducer ) == reducer's input specified in redInput.
-map<pair<int, int>, long>
+FlowSizeMatrix
 TGTraceFB::GetFlowSizeWithExactSize(int numMap,
                                     int numRed,
                                     const vector<long>& redInput) {
-  map<pair<int, int>, long> mr_flow_bytes_result;
+  FlowSizeMatrix mr_flow_bytes_result(numMap, numRed);
   for (int reducer_idx = 0; reducer_idx < numRed; reducer_idx++) {
     long redInputTmp = redInput[reducer_idx];
     long avgFlowSize = ceil((double) redInputTmp / (double) numMap);
     for (int mapper_idx = 0; mapper_idx < numMap; mapper_idx++) {
       long flowSize = min(avgFlowSize, redInputTmp);
       redInputTmp -= flowSize;
-      mr_flow_bytes_result[std::make_pair(mapper_idx, reducer_idx)] = flowSize;
+      mr_flow_bytes_result.At(mapper_idx, reducer_idx) = flowSize;
     }
   }
   return mr_flow_bytes_result;
 }
 
 // divide reducer's input size, specified in redInput, to each of the mapper.
-map<pair<int, int>, long>
+FlowSizeMatrix
 TGTraceFB::GetFlowSizeWithEqualSizeToSameReducer(int numMap,
                                                  int numRed,
                                                  const vector<long>& redInput) {
-  map<pair<int, int>, long> mr_flow_bytes_result;
+  FlowSizeMatrix mr_flow_bytes_result(numMap, numRed);
   for (int reducer_idx = 0; reducer_idx < numRed; reducer_idx++) {
     long avgFlowSize = ceil((double) redInput[reducer_idx] / (double) numMap);
     for (int mapper_idx = 0; mapper_idx < numMap; mapper_idx++) {
       long flowSize = avgFlowSize;
-      mr_flow_bytes_result[std::make_pair(mapper_idx, reducer_idx)] = flowSize;
+      mr_flow_bytes_result.At(mapper_idx, reducer_idx) = flowSize;
     }
   }
   return mr_flow_bytes_result;
 }
 
-map<pair<int, int>, long>
+FlowSizeMatrix
 TGTraceFB::GetFlowSizeWithPerturb(int numMap,
                                   int numRed,
                                   const vector<long>& redInput,
                                   int perturb_perc,
-                                  unsigned int rand_seed) {
+                                  int coflow_id) {
 
   if (perturb_perc > 100) {
     cout << " Warming : try to perturb the flow sizes with more than 1MB \n";
   }
-  // seed the random generator before we preturb,
-  // so that given same traffic trace,
-  // we will have the same traffic for different schedulers.
-  std::mt19937 mt_rand(rand_seed); // srand(rand_seed);
+  // each flow draws from its own stream of the coflow, so that given same
+  // traffic trace, we will have the same traffic for different schedulers.
 
-  map<pair<int, int>, long> mr_flow_bytes_result;
+  FlowSizeMatrix mr_flow_bytes_result(numMap, numRed);
   // now we generate traffic.
   for (int reducer_idx = 0; reducer_idx < numRed; reducer_idx++) {
     long redInputTmp = redInput[reducer_idx];
@@ -724,13 +778,12 @@ TGTraceFB::GetFlowSizeWithPerturb(int numMap,
 
     for (int mapper_idx = 0; mapper_idx < numMap; mapper_idx++) {
 
-      int perturb_direction = (mt_rand() % 2 == 1) ? 1 : -1;
-      // int perturb_direction = (rand() % 2 == 1) ? 1 : -1;
+      CounterRng rng(rand_seed_, coflow_id, mapper_idx * numRed + reducer_idx);
+      int perturb_direction = (rng.Below(2) == 1) ? 1 : -1;
 
       // perturb_perc = 5 : (-5%, +5%) flow size , exclusive bound
 
-      double rand_0_to_1 = ((double) mt_rand() / (RAND_MAX));
-      // double rand_0_to_1 = ((double) rand() / (RAND_MAX));
+      double rand_0_to_1 = rng.Uniform();
       double perturb_perc_rand =
           perturb_direction * rand_0_to_1 * (double) perturb_perc / 100.0;
       long flowSize = avgFlowSize * (1 + perturb_perc_rand);
@@ -738,7 +791,7 @@ TGTraceFB::GetFlowSizeWithPerturb(int numMap,
       // only allow flows >= 1MB.
       if (flowSize < 1000000) flowSize = 1000000;
       redInputTmp -= flowSize;
-      mr_flow_bytes_result[std::make_pair(mapper_idx, reducer_idx)] = flowSize;
+      mr_flow_bytes_result.At(mapper_idx, reducer_idx) = flowSize;
 
       // debug
       if (DEBUG_LEVEL >= 10) {
@@ -762,96 +815,19 @@ TGTraceFB::GetFlowSizeWithPerturb(int numMap,
 TGFBOnebyOne::TGFBOnebyOne(DbLogger* db_logger)
     : TGTraceFB(db_logger/*db_logger*/) {
   m_last_coflow_finish_time = 0.0;
-
-  m_comptimeAuditFile.open(COMPTIME_AUDIT_FILE_NAME);
-  if (!m_comptimeAuditFile.is_open()) {
-    cout << "Error: unable to open file "
-         << COMPTIME_AUDIT_FILE_NAME << endl;
-    cout << "Now terminate the program" << endl;
-    exit(-1);
-  }
-
-  m_comptime_audit_title_line = false;
 }
 
-TGFBOnebyOne::~TGFBOnebyOne() {
-  if (m_comptimeAuditFile.is_open()) {
-    m_comptimeAuditFile << "Done" << endl;
-    m_comptimeAuditFile.close();
-  }
-}
+TGFBOnebyOne::~TGFBOnebyOne() {}
 
 void
 TGFBOnebyOne::DoSubmitJob() {
   TGTraceFB::KickStartReadyJobsAndNotifyScheduler();
 }
 
-// do not apply any destruction here!
-void
-TGFBOnebyOne::LogComptimeStat(vector<Coflow*>* cfpVp) {
-  if (cfpVp->size() != 1) {
-    // should only have 1 coflow finished at a time.
-    return;
-  }
-  // obtain comp time stats.
-  int jobid = cfpVp->front()->GetJobId();
-  CompTimeBreakdown comptime = cfpVp->front()->GetCompTime();
-
-  // look up the job for more information.
-  map<Coflow*, JobDesc*>::iterator
-      jobmapIt = m_coflow2job.find(cfpVp->front());
-  if (jobmapIt == m_coflow2job.end()) {
-    cout << "error: can't locate the job from the coflow ptr" << endl;
-    cout << "return without clearing up the dead job" << endl;
-    return;
-  }
-  JobDesc* job = jobmapIt->second;
-  int num_map = job->m_numSrc;
-  int num_red = job->m_numDst;
-
-  if (!m_comptime_audit_title_line) {
-    m_comptime_audit_title_line = true;
-    m_comptimeAuditFile
-        << "jobid" << '\t'
-        << "map" << '\t' << "red" << '\t'
-        << "sun-ttl" << '\t'
-        << "shuffleR" << '\t' << "shuffleS" << '\t'
-        << "reserve" << '\t'
-        << "solstice-ttl" << '\t'
-        << "stuff" << '\t' << "slice" << '\t'
-        << "vec-avg" << '\t' << "count" << '\t' << "min" << '\t' << "max"
-        << '\t'
-        << endl;
-  }
-  m_comptimeAuditFile
-      << jobid << '\t'
-      << num_map << '\t'
-      << num_red << '\t'
-      << comptime.GetSunflowTotalTime() << '\t'
-      << comptime.m_time_shuffle_random << '\t'
-      << comptime.m_time_sort << '\t'
-      << comptime.m_time_reserve << '\t'
-      << comptime.GetSolsticeTotalTime() << '\t'
-      << comptime.m_time_stuff << '\t'
-      << comptime.m_time_slice << '\t'
-      << comptime.GetVectorAvgTime() << '\t'
-      << comptime.m_time_vector.size() << '\t'
-      << comptime.GetVectorMinTime() << '\t'
-      << comptime.GetVectorMaxTime() << '\t'
-      << endl;
-}
-
 void
 TGFBOnebyOne::NotifyTrafficFinish(double alarmTime,
                                   vector<Coflow*>* cfpVp,
                                   vector<Flow*>* fpVp) {
-
-
-  // only output comp time when we play with 1by1.
-  // log comptime before calling TGTraceFB::NotifyTrafficFinish()
-  // as coflow pointers are destroyed in TGTraceFB::NotifyTrafficFinish().
-  LogComptimeStat(cfpVp);
-
   TGTraceFB::NotifyTrafficFinish(alarmTime, cfpVp, fpVp);
 
   // add another coflow if any.
@@ -874,41 +850,35 @@ vector<JobDesc*> TGFBOnebyOne::ReadJobs() {
   vector<JobDesc*> result;
   Coflow* coflow = nullptr;
   while (!coflow) {
-    string jobLine = "";
-    getline(m_jobTraceFile, jobLine);
-
-    if (jobLine.size() <= 0) {
+    bool legal;
+    if (!trace_source_->Peek(&trace_record_, &legal)) {
       //cout << "no more jobs are available!" << endl;
       return result;
     }
-
-    std::istringstream ss(jobLine);
-    vector<std::string> fields(5);
-    if (!(ss >> fields[0] >> fields[1] >> fields[2] >> fields[3]
-             >> fields[4])) {
+    trace_source_->Pop();
+    if (!legal) {
       cout << "[TGFBOnebyOne::ReadJobs] number of fields illegal! "
            << "Return with job list." << endl;
       return result;
     }
 
-    int jobid = stoi(fields[0]);
     double jobOffArrivalTime = m_last_coflow_finish_time;
-    int map = stoi(fields[2]);
-    int red = stoi(fields[3]);
 
     // perform perturb if needed.
     // when perturb = false,
     //  if EQUAL_FLOW_TO_SAME_REDUCER = true, all flows to the same reducer
     //     will be the of the same size.
 
-    coflow = CreateCoflowPtrFromString(jobOffArrivalTime, jobid,
-                                       map, red, fields[4],
-                                       ENABLE_PERTURB_IN_PLAY,
-                                       EQUAL_FLOW_TO_SAME_REDUCER);
+    coflow = CreateCoflowFromRecord(jobOffArrivalTime, trace_record_,
+                                    ENABLE_PERTURB_IN_PLAY,
+                                    EQUAL_FLOW_TO_SAME_REDUCER);
     if (coflow) {
       int num_flow = (int) coflow->GetFlows()->size();
-      JobDesc* newJobPtr = new JobDesc(jobid, jobOffArrivalTime,
-                                       map, red, num_flow, coflow);
+      JobDesc* newJobPtr = new JobDesc(trace_record_.job_id,
+                                       jobOffArrivalTime,
+                                       trace_record_.num_map,
+                                       trace_record_.num_red,
+                                       num_flow, coflow);
       // add entry into the map
       m_coflow2job.insert(std::make_pair(coflow, newJobPtr));
       result.push_back(newJobPtr);
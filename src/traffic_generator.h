@@ -10,13 +10,22 @@
 #define TRAFFIC_GENERATOR_H
 
 #include <assert.h>
+#include <deque>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
 #include "global.h"
+#include "counter_rng.h"
 #include "db_logger.h"
+#include "flow_size_matrix.h"
+#include "synthetic_trace.h"
+#include "trace_prefetcher.h"
+#include "trace_reader.h"
+#include "trace_scaler.h"
+#include "worker_pool.h"
 
 using namespace std;
 
@@ -44,7 +53,7 @@ class TrafficGen {
 
  protected:
   virtual void PlaceTasks(int coflow_id, int num_map, int num_red,
-                          const map<pair<int, int>, long> &mr_flow_bytes,
+                          const FlowSizeMatrix &mr_flow_bytes,
                           const vector<int> &mapper_original_locations,
                           const vector<int> &reducer_original_locations,
                           vector<int> *mapper_locations,
@@ -63,7 +72,6 @@ class TrafficGen {
   int m_totalCoflowNum;
   int m_total_accepted_coflow_num;
   int m_total_met_deadline_num;
-  ifstream m_jobTraceFile;
 
   ofstream m_cctAuditFile;
   ofstream m_fctAuditFile;
@@ -84,7 +92,9 @@ class TrafficGen {
 ////////////////////////////////////////////////////
 class TGTraceFB : public TrafficGen {
  public:
-  TGTraceFB(DbLogger *db_logger);
+  // Replays coflows of trace_source, owned, or of TRAFFIC_TRACE_FILE_NAME if
+  // nullptr.
+  TGTraceFB(DbLogger *db_logger, TraceSource *trace_source = nullptr);
   virtual ~TGTraceFB();
 
   /* called by simulator */
@@ -100,46 +110,35 @@ class TGTraceFB : public TrafficGen {
  protected:
   vector<JobDesc *> m_runningJob; // allow Neat to access.
  private:
-  vector<JobDesc *> m_finishJob;
   vector<JobDesc *> m_readyJob;
 
   virtual void DoSubmitJob();
 
-  // Random seed bookeeping - one seed for each coflow.
-  void InitSeedForCoflows(int seed_for_seed);
-  vector<unsigned int> m_seed_for_coflow;
-
-  // Obtain reducer input bytes and the reducer assigned machines from
-  // reducer_trace. reducer_trace is formated as
-  // r1_location : r1_input; r2_location : r2_input; ...
-  // input are rounded to the closest MB.
-  // remember the locations and input bytes *in order* for each reducer.
-  void GetReducerInfoFromString(int num_reducer_wanted,
-                                const string &reducer_trace,
-                                vector<int> *original_locations,
-                                vector<long> *reducer_input_bytes);
-  vector<int> GetMapperOriginalLocFromString(int num_mapper_wanted,
-                                             const string &mapper_trace);
+  // run seed of the random streams of coflows, keyed by coflow id and flow
+  // index. See counter_rng.h.
+  uint64_t rand_seed_;
+
   // TODO: remove unused.
-  map<pair<int, int>, long>
+  FlowSizeMatrix
   GetFlowSizeWithExactSize(int numMap, int numRed,
                            const vector<long> &redInput);
   // TODO: remove unused.
-  map<pair<int, int>, long>
+  FlowSizeMatrix
   GetFlowSizeWithEqualSizeToSameReducer(int numMap, int numRed,
                                         const vector<long> &redInput);
   // flow sizes will be +/- 1MB * perturb_perc%.
   // perturb_perc is a percentage, i.e. when perturb_perc = 10, then
   //    flow sizes will be +/- 0.1 MB.
   // only allow flow >= 1MB.
-  map<pair<int, int>, long>
+  FlowSizeMatrix
   GetFlowSizeWithPerturb(int numMap, int numRed,
                          const vector<long> &redInput,
-                         int perturb_perc, unsigned int rand_seed);
+                         int perturb_perc, int coflow_id);
 
   // By default, place mappers and reducers on the original locations specified.
+  // Called concurrently for several coflows if NUM_TRAFFIC_THREADS > 1.
   virtual void PlaceTasks(int coflow_id, int num_map, int num_red,
-                          const map<pair<int, int>, long> &mr_flow_bytes,
+                          const FlowSizeMatrix &mr_flow_bytes,
                           const vector<int> &mapper_original_locations,
                           const vector<int> &reducer_original_locations,
                           vector<int> *mapper_locations,
@@ -152,25 +151,63 @@ class TGTraceFB : public TrafficGen {
 
  protected:
   virtual vector<JobDesc *> ReadJobs();
+  // cfInfo is formated as "m1,m2,...#r1:MB1,r2:MB2,...".
   Coflow *CreateCoflowPtrFromString(double time, int coflow_id,
                                     int num_map, int num_red,
                                     string cfInfo,
                                     bool do_perturb, bool avg_size);
+  Coflow *CreateCoflowFromRecord(double time, const TraceRecord &record,
+                                 bool do_perturb, bool avg_size);
   void GetNodeReqTrafficMB(int num_map, int num_red,
-                           const map<pair<int, int>, long> &mr_flow_bytes,
+                           const FlowSizeMatrix &mr_flow_bytes,
                            vector<double> *mapper_traffic_req_MB,
                            vector<double> *reducer_traffic_req_MB);
   Coflow *CreateCoflow(int coflow_id, double arrival_time,
                        int num_map, int num_red,
-                       const map<pair<int, int>, long> &mr_flow_bytes,
+                       FlowSizeMatrix mr_flow_bytes,
                        const vector<int> &mapper_locations,
                        const vector<int> &reducer_locations);
+  // Under FLOW_GROUPS, add to flows one flow group per reducer and flow size,
+  // in the order of the flow of the first mapper of each group.
+  void CreateFlowGroups(double arrival_time, int num_map, int num_red,
+                        const FlowSizeMatrix &mr_flow_bytes,
+                        const vector<int> &mapper_locations,
+                        const vector<int> &reducer_locations,
+                        vector<Flow *> *flows);
 
   void ScheduleToAddJobs(vector<JobDesc *> &jobs);
   void KickStartReadyJobsAndNotifyScheduler();
   map<Coflow *, JobDesc *> m_coflow2job;
 
-  int GetSeedForCoflow(int coflow_id);
+  // wrapped in a TraceScaler if TRACE_SCALE is set, then in a
+  // TracePrefetcher if TRACE_PREFETCH_WINDOW_SEC > 0.
+  unique_ptr<TraceSource> trace_source_;
+  static const int PREFETCH_CAPACITY_;
+  // reused by every coflow read.
+  TraceRecord trace_record_;
+
+  // A coflow of the trace built ahead of its arrival, with ids deferred
+  // until it is handed over by ReadJobs(). coflow is nullptr if the record
+  // is illegal or has no demand.
+  struct BuiltCoflow {
+    int job_id;
+    double arrival_ms;
+    int num_map;
+    int num_red;
+    bool legal;
+    Coflow *coflow;
+  };
+  // Build coflows of the next records of the trace into built_coflows_, in
+  // the order of arrival: one coflow, or a batch on build_pool_ if
+  // NUM_TRAFFIC_THREADS > 1.
+  void BuildCoflowsAhead();
+  deque<BuiltCoflow> built_coflows_;
+  unique_ptr<WorkerPool> build_pool_;
+  // records of the batch being built.
+  vector<TraceRecord> build_records_;
+  static const int BUILD_BATCH_PER_THREAD_;
+  // arrival of the first coflow replayed, subtracted from arrivals.
+  double trace_start_ms_;
 
   friend class TrafficGeneratorTest;
   friend class TrafficAnalyzerTest;
@@ -221,25 +258,33 @@ class TGFBOnebyOne : public TGTraceFB {
   // return a coflow/job at a time until the end of the trace.
   virtual vector<JobDesc *> ReadJobs() override;
 
-  void LogComptimeStat(vector<Coflow *> *cfpVp);
-  ofstream m_comptimeAuditFile;
-  bool m_comptime_audit_title_line;
-
  protected:
   // used by child class TGWindowOnebyOne
   double m_last_coflow_finish_time;
 };
 
+///////////////////////////////////////////////////////////////////
+///////////// Code for synthetic coflows                ///////////
+///////////// Replay a seeded synthetic stream as a trace.  ///////
+///////////////////////////////////////////////////////////////////
+class TGSynthetic : public TGTraceFB {
+ public:
+  // name is parsed by SyntheticTraceOptions::FromName() over NUM_RACKS.
+  TGSynthetic(DbLogger *db_logger, const string &name)
+      : TGTraceFB(db_logger, new SyntheticTraceSource(
+      SyntheticTraceOptions::FromName(name, NUM_RACKS))) {}
+  virtual ~TGSynthetic() {}
+};
 
 class TrafficFactory {
  public:
   static TrafficGen *Get(string traffic_generator_name, DbLogger *db_logger) {
     if (traffic_generator_name.substr(0, 6) == "fbplay") {
       return new TGTraceFB(db_logger);
+    } else if (traffic_generator_name.substr(0, 9) == "synthetic") {
+      return new TGSynthetic(db_logger, traffic_generator_name);
     } else if (traffic_generator_name == "fb1by1") {
       return new TGFBOnebyOne(db_logger);
-      // comp time stat only available under "1by1".
-      LOG_COMP_STAT = true;
       // Should be false unless hacking to obtain quick results.
       SPEEDUP_1BY1_TRAFFIC_IN_SCHEDULER = true;
     }
@@ -0,0 +1,72 @@
+//
+//  worker_pool.cc
+//  Ximulator
+//
+
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int num_threads)
+    : task_(nullptr), num_tasks_(0), next_task_(0), num_tasks_done_(0),
+      batch_count_(0), stopping_(false) {
+  for (int i = 1; i < num_threads; i++) {
+    workers_.push_back(thread(&WorkerPool::WorkerLoop, this));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    unique_lock<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::ParallelFor(int num_tasks, const function<void(int)> &task) {
+  if (num_tasks <= 0) return;
+  if (workers_.empty() || num_tasks == 1) {
+    for (int i = 0; i < num_tasks; i++) {
+      task(i);
+    }
+    return;
+  }
+  unique_lock<mutex> lock(mutex_);
+  task_ = &task;
+  num_tasks_ = num_tasks;
+  next_task_ = 0;
+  num_tasks_done_ = 0;
+  batch_count_++;
+  work_cv_.notify_all();
+  // the calling thread works as well.
+  RunTasks(lock);
+  done_cv_.wait(lock, [this] { return num_tasks_done_ == num_tasks_; });
+  task_ = nullptr;
+}
+
+void WorkerPool::WorkerLoop() {
+  long last_batch = 0;
+  unique_lock<mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this, &last_batch] {
+      return stopping_ || batch_count_ != last_batch;
+    });
+    if (stopping_) return;
+    last_batch = batch_count_;
+    RunTasks(lock);
+  }
+}
+
+void WorkerPool::RunTasks(unique_lock<mutex> &lock) {
+  while (task_ && next_task_ < num_tasks_) {
+    int task_idx = next_task_++;
+    const function<void(int)> *task = task_;
+    lock.unlock();
+    (*task)(task_idx);
+    lock.lock();
+    if (++num_tasks_done_ == num_tasks_) {
+      done_cv_.notify_all();
+    }
+  }
+}
@@ -0,0 +1,52 @@
+//
+//  worker_pool.h
+//  Ximulator
+//
+//  A fixed-size pool of worker threads used to run independent computation
+//  of the simulation concurrently.
+//
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class WorkerPool {
+ public:
+  // num_threads counts the calling thread, i.e. num_threads - 1 threads are
+  // spawned.
+  explicit WorkerPool(int num_threads);
+  ~WorkerPool();
+  int GetNumThreads() { return (int) workers_.size() + 1; }
+
+  // Run task(0), ..., task(num_tasks - 1) on the pool, including the calling
+  // thread, and return once all of them are done. Tasks may be run in any
+  // order, so they must not depend on each other.
+  void ParallelFor(int num_tasks, const function<void(int)> &task);
+
+ private:
+  vector<thread> workers_;
+  mutex mutex_;
+  condition_variable work_cv_;
+  condition_variable done_cv_;
+
+  // the batch of tasks being run, guarded by mutex_.
+  const function<void(int)> *task_;
+  int num_tasks_;
+  int next_task_;
+  int num_tasks_done_;
+  long batch_count_;
+  bool stopping_;
+
+  void WorkerLoop();
+  // run tasks of the current batch until none left. Require lock held.
+  void RunTasks(unique_lock<mutex> &lock);
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,58 @@
+//
+// Time of routing a large coflow in Infocom, exactly and approximately.
+// Not run with the tests.
+//
+
+#include <sys/time.h>
+
+#include "ximulator_test_base.h"
+#include "src/solver_infocom.h"
+#include "src/util.h"
+
+class SolverBenchmark : public TrafficGeneratorTest {};
+
+TEST_F(SolverBenchmark, Infocom_ApproxRoute) {
+  // a large all-to-all coflow, solved by columns on a dense LP backend.
+  string mappers, reducers;
+  for (int idx = 0; idx < 60; idx++) {
+    mappers += (idx > 0 ? "," : "") + to_string(idx);
+    reducers += (idx > 0 ? "," : "") + to_string(60 + idx) + ":"
+        + to_string(10 * (idx % 7 + 1));
+  }
+  Coflow* coflow = GenerateCoflow(/*time=*/0, /*coflow_id=*/1000,
+      /*num_map=*/60, /*num_red=*/60, /*info=*/mappers + "#" + reducers,
+      /*do_perturb=*/true, /*avg_size=*/false);
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 4 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 4 * 3)});
+  ReservationTable src_reserved_bps(schedulers.size()),
+      dst_reserved_bps(schedulers.size());
+  for (int port = 0; port < 120; port += 3) {
+    src_reserved_bps.Set(1, port, ONE_GIGA_BPS / 2);
+    dst_reserved_bps.Set(0, port, ONE_GIGA_BPS / 8);
+  }
+  for (double epsilon : {0.2, 0.1, 0.05}) {
+    SolverInfocom exact_solver(schedulers, /*debug_level=*/0);
+    SolverInfocom approx_solver(schedulers, /*debug_level=*/0, nullptr,
+                                nullptr, epsilon);
+    struct timeval start_time, mid_time, end_time;
+    gettimeofday(&start_time, NULL);
+    ASSERT_TRUE(exact_solver.FindRoute(
+        coflow, src_reserved_bps, dst_reserved_bps));
+    double exact_cct = exact_solver.FindCCTGivenRoute(
+        coflow, src_reserved_bps, dst_reserved_bps);
+    gettimeofday(&mid_time, NULL);
+    ASSERT_TRUE(approx_solver.FindRoute(
+        coflow, src_reserved_bps, dst_reserved_bps));
+    double approx_cct = approx_solver.FindCCTGivenRoute(
+        coflow, src_reserved_bps, dst_reserved_bps);
+    gettimeofday(&end_time, NULL);
+    cout << "epsilon " << epsilon << ": cct error "
+         << approx_cct / exact_cct - 1 << ", exact "
+         << secondPass(mid_time, start_time) << "s, approx "
+         << secondPass(end_time, mid_time) << "s" << endl;
+  }
+  delete coflow;
+  for (Scheduler* scheduler : schedulers) delete scheduler;
+}
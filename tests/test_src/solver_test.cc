@@ -9,9 +9,78 @@ typedef std::string basicString;
 class SolverTest : public TrafficGeneratorTest {
  protected:
   virtual void TearDown() {}
-  virtual void SetUp() { TrafficGeneratorTest::SetUp(); }
+  virtual void SetUp() {
+    TrafficGeneratorTest::SetUp();
+    INFOCOM_STICKY_ROUTING = false;
+  }
 };
 
+TEST_F(SolverTest, SimplexLp) {
+  SimplexLpSolver lp;
+  // maximize 3x + 2y, s.t. x + y <= 4, x + 3y <= 6, 1 <= x <= 3, y >= 0.
+  int x = lp.AddVar(1.0, 3.0, 3.0, "x");
+  int y = lp.AddVar(0.0, LpSolver::INFINITY_BOUND, 2.0, "y");
+  lp.SetMaximize(true);
+  int c1 = lp.AddConstr({{x, 1.0}, {y, 1.0}}, LpSolver::LP_LESS_EQUAL, 4.0,
+                        "c1");
+  int c2 = lp.AddConstr({{x, 1.0}, {y, 3.0}}, LpSolver::LP_LESS_EQUAL, 6.0,
+                        "c2");
+  EXPECT_EQ(lp.Optimize(), LpSolver::LP_OPTIMAL);
+  EXPECT_NEAR(lp.GetValue(x), 3.0, 1e-9);
+  EXPECT_NEAR(lp.GetValue(y), 1.0, 1e-9);
+  EXPECT_NEAR(lp.GetObjValue(), 11.0, 1e-9);
+  // warm start on new right-hand sides, as if solved from scratch.
+  lp.SetRhs(c1, 3.5);
+  EXPECT_EQ(lp.Optimize(), LpSolver::LP_OPTIMAL);
+  EXPECT_NEAR(lp.GetValue(x), 3.0, 1e-9);
+  EXPECT_NEAR(lp.GetValue(y), 0.5, 1e-9);
+  lp.SetRhs(c2, 0.5);
+  EXPECT_EQ(lp.Optimize(), LpSolver::LP_INFEASIBLE);
+  lp.SetRhs(c2, 6.0);
+  lp.SetRhs(c1, 2.0);
+  EXPECT_EQ(lp.Optimize(), LpSolver::LP_OPTIMAL);
+  EXPECT_NEAR(lp.GetObjValue(), 6.0, 1e-9);
+
+  // x + y == 5 and x - y >= 2 gives the min of x + 2y at x = 5, y = 0.
+  SimplexLpSolver lp_min;
+  x = lp_min.AddVar(0.0, LpSolver::INFINITY_BOUND, 1.0, "x");
+  y = lp_min.AddVar(0.0, LpSolver::INFINITY_BOUND, 2.0, "y");
+  lp_min.AddConstr({{x, 1.0}, {y, 1.0}}, LpSolver::LP_EQUAL, 5.0, "c1");
+  lp_min.AddConstr({{x, 1.0}, {y, -1.0}}, LpSolver::LP_GREATER_EQUAL, 2.0,
+                   "c2");
+  EXPECT_EQ(lp_min.Optimize(), LpSolver::LP_OPTIMAL);
+  EXPECT_NEAR(lp_min.GetObjValue(), 5.0, 1e-9);
+
+  SimplexLpSolver lp_infeasible;
+  x = lp_infeasible.AddVar(0.0, LpSolver::INFINITY_BOUND, 1.0, "x");
+  lp_infeasible.AddConstr({{x, 1.0}}, LpSolver::LP_LESS_EQUAL, -1.0, "c1");
+  EXPECT_EQ(lp_infeasible.Optimize(), LpSolver::LP_INFEASIBLE);
+
+  SimplexLpSolver lp_unbounded;
+  x = lp_unbounded.AddVar(0.0, LpSolver::INFINITY_BOUND, 1.0, "x");
+  lp_unbounded.SetMaximize(true);
+  lp_unbounded.AddConstr({{x, 1.0}}, LpSolver::LP_GREATER_EQUAL, 1.0, "c1");
+  EXPECT_EQ(lp_unbounded.Optimize(), LpSolver::LP_UNBOUNDED);
+}
+
+TEST_F(SolverTest, ReservationTable) {
+  ReservationTable table(2);
+  EXPECT_EQ(table.Get(1, 100), 0);
+  table.Add(1, 100, 5);
+  table.Add(1, 100, 5);
+  // snapshots keep their values when either copy changes.
+  ReservationTable snapshot = table;
+  table.Set(1, 100, 3);
+  table.Add(0, 7, 1);
+  snapshot.Add(1, 200, 2);
+  EXPECT_EQ(table.Get(1, 100), 3);
+  EXPECT_EQ(table.Get(0, 7), 1);
+  EXPECT_EQ(table.Get(1, 200), 0);
+  EXPECT_EQ(snapshot.Get(1, 100), 10);
+  EXPECT_EQ(snapshot.Get(0, 7), 0);
+  EXPECT_EQ(snapshot.Get(1, 200), 2);
+}
+
 TEST_F(SolverTest, Infocom_OneCoflow) {
   vector<Coflow*> coflows;
   LoadAllCoflows(coflows);
@@ -21,8 +90,8 @@ TEST_F(SolverTest, Infocom_OneCoflow) {
        new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 2)});
   SolverInfocom solver_infocom(schedulers, /*debug_level=*/0);
   for (Coflow* coflow : coflows) {
-    map<pair<Scheduler*, int>, long> no_src_reserved_bps,
-        no_dst_reserved_bps;
+    ReservationTable no_src_reserved_bps(schedulers.size()),
+        no_dst_reserved_bps(schedulers.size());
     double cct = solver_infocom.MinCCT(
         coflow, no_src_reserved_bps, no_dst_reserved_bps);
     cout << coflow->GetName() << " MinCCT_cct = " << cct << endl;
@@ -41,6 +110,212 @@ TEST_F(SolverTest, Infocom_OneCoflow) {
   }
 }
 
+TEST_F(SolverTest, Infocom_CCTGivenRoute) {
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 2)});
+  SolverInfocom solver_infocom(schedulers, /*debug_level=*/0);
+  ReservationTable src_reserved_bps(schedulers.size()),
+      dst_reserved_bps(schedulers.size());
+  for (Coflow* coflow : coflows) {
+    EXPECT_TRUE(solver_infocom.FindRoute(
+        coflow, src_reserved_bps, dst_reserved_bps));
+    double cct = solver_infocom.FindCCTGivenRoute(
+        coflow, src_reserved_bps, dst_reserved_bps);
+    EXPECT_NEAR(cct, solver_infocom.FindCCTGivenRouteLp(
+        coflow, src_reserved_bps, dst_reserved_bps, /*debug_level=*/0), 1e-9);
+    // reserve part of the ports for the next coflows.
+    for (Flow* flow : *coflow->GetFlows()) {
+      int idx = flow->assigned_scheduler_ == schedulers[0] ? 0 : 1;
+      src_reserved_bps.Add(idx, flow->GetSrc(), ONE_GIGA_BPS / 100);
+      dst_reserved_bps.Add(idx, flow->GetDest(), ONE_GIGA_BPS / 100);
+    }
+  }
+  // no residual bandwidth left on a port of the last coflow.
+  Flow* flow = coflows.back()->GetFlows()->front();
+  int idx = flow->assigned_scheduler_ == schedulers[0] ? 0 : 1;
+  src_reserved_bps.Set(idx, flow->GetSrc(),
+                       schedulers[idx]->GetSrcPortBps(flow->GetSrc()));
+  EXPECT_EQ(solver_infocom.FindCCTGivenRoute(
+      coflows.back(), src_reserved_bps, dst_reserved_bps), -1);
+  EXPECT_EQ(solver_infocom.FindCCTGivenRouteLp(
+      coflows.back(), src_reserved_bps, dst_reserved_bps, 0), -1);
+}
+
+TEST_F(SolverTest, Infocom_MinCCTCache) {
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 2)});
+  MinCCTCache cache;
+  cache.Add(coflows);
+  SolverInfocom solver_infocom(schedulers, /*debug_level=*/0, nullptr, &cache);
+  ReservationTable src_reserved_bps(schedulers.size()),
+      dst_reserved_bps(schedulers.size());
+  vector<double> ccts;
+  for (Coflow* coflow : coflows) {
+    ccts.push_back(solver_infocom.MinCCT(
+        coflow, src_reserved_bps, dst_reserved_bps));
+  }
+  EXPECT_EQ(cache.GetNumMisses(), coflows.size());
+  // same demand and residual bandwidth, with the same route.
+  for (int idx = 0; idx < coflows.size(); idx++) {
+    vector<Scheduler*> route;
+    for (Flow* flow : *coflows[idx]->GetFlows()) {
+      route.push_back(flow->assigned_scheduler_);
+    }
+    EXPECT_EQ(solver_infocom.MinCCT(
+        coflows[idx], src_reserved_bps, dst_reserved_bps), ccts[idx]);
+    int flow_idx = 0;
+    for (Flow* flow : *coflows[idx]->GetFlows()) {
+      EXPECT_EQ(flow->assigned_scheduler_, route[flow_idx++]);
+    }
+  }
+  EXPECT_EQ(cache.GetNumHits(), coflows.size());
+  // less residual bandwidth on a port of the first coflow.
+  Flow* flow = coflows.front()->GetFlows()->front();
+  src_reserved_bps.Set(1, flow->GetSrc(), ONE_GIGA_BPS / 3);
+  EXPECT_GE(solver_infocom.MinCCT(
+      coflows.front(), src_reserved_bps, dst_reserved_bps), ccts.front());
+  EXPECT_EQ(cache.GetNumMisses(), coflows.size() + 1);
+}
+
+TEST_F(SolverTest, Infocom_ApproxRoute) {
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  // an all-to-all coflow with flows of different sizes.
+  string mappers, reducers;
+  for (int idx = 0; idx < 20; idx++) {
+    mappers += (idx > 0 ? "," : "") + to_string(idx);
+    reducers += (idx > 0 ? "," : "") + to_string(20 + idx) + ":"
+        + to_string(10 * (idx % 7 + 1));
+  }
+  coflows.push_back(GenerateCoflow(/*time=*/0, /*coflow_id=*/1000,
+      /*num_map=*/20, /*num_red=*/20, /*info=*/mappers + "#" + reducers,
+      /*do_perturb=*/true, /*avg_size=*/false));
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 4 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 4 * 3)});
+  ReservationTable src_reserved_bps(schedulers.size()),
+      dst_reserved_bps(schedulers.size());
+  for (int port = 0; port < 40; port += 3) {
+    src_reserved_bps.Set(1, port, ONE_GIGA_BPS / 2);
+    dst_reserved_bps.Set(0, port, ONE_GIGA_BPS / 8);
+  }
+  // alpha = 1/cct of the approximate solver is within (1 - epsilon) of the
+  // exact one, and so is the cct of the rounded route.
+  for (double epsilon : {0.2, 0.1, 0.05}) {
+    SolverInfocom exact_solver(schedulers, /*debug_level=*/0);
+    SolverInfocom approx_solver(schedulers, /*debug_level=*/0, nullptr,
+                                nullptr, epsilon);
+    for (Coflow* coflow : coflows) {
+      double exact_alpha = 0, approx_alpha = 0;
+      ASSERT_TRUE(exact_solver.FindRoute(
+          coflow, src_reserved_bps, dst_reserved_bps, &exact_alpha));
+      double exact_cct = exact_solver.FindCCTGivenRoute(
+          coflow, src_reserved_bps, dst_reserved_bps);
+      ASSERT_TRUE(approx_solver.FindRoute(
+          coflow, src_reserved_bps, dst_reserved_bps, &approx_alpha));
+      double approx_cct = approx_solver.FindCCTGivenRoute(
+          coflow, src_reserved_bps, dst_reserved_bps);
+      EXPECT_GE(approx_alpha, (1 - epsilon) * exact_alpha);
+      EXPECT_LE(approx_alpha, (1 + 1e-6) * exact_alpha);
+      EXPECT_LE(approx_cct, exact_cct / (1 - epsilon));
+    }
+  }
+}
+
+TEST_F(SolverTest, Infocom_WarmRoute) {
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  // an all-to-all coflow large enough to be routed by columns.
+  string mappers, reducers;
+  for (int idx = 0; idx < 50; idx++) {
+    mappers += (idx > 0 ? "," : "") + to_string(idx);
+    reducers += (idx > 0 ? "," : "") + to_string(50 + idx) + ":"
+        + to_string(10 * (idx % 7 + 1));
+  }
+  coflows.push_back(GenerateCoflow(/*time=*/0, /*coflow_id=*/1000,
+      /*num_map=*/50, /*num_red=*/50, /*info=*/mappers + "#" + reducers,
+      /*do_perturb=*/true, /*avg_size=*/false));
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 2)});
+  ReservationTable no_reserved_bps(schedulers.size());
+  ReservationTable src_reserved_bps(schedulers.size()),
+      dst_reserved_bps(schedulers.size());
+  for (int port = 0; port < 100; port += 3) {
+    src_reserved_bps.Set(1, port, ONE_GIGA_BPS / 2);
+    dst_reserved_bps.Set(0, port, ONE_GIGA_BPS / 8);
+  }
+  // a LP solved again on less residual bandwidth returns the same route as
+  // a new one.
+  SolverInfocom warm_solver(schedulers, /*debug_level=*/0);
+  for (Coflow* coflow : coflows) {
+    double warm_alpha = 0, cold_alpha = 0;
+    ASSERT_TRUE(warm_solver.FindRoute(
+        coflow, no_reserved_bps, no_reserved_bps));
+    ASSERT_TRUE(warm_solver.FindRoute(
+        coflow, src_reserved_bps, dst_reserved_bps, &warm_alpha));
+    vector<Scheduler*> warm_route;
+    for (Flow* flow : *coflow->GetFlows()) {
+      warm_route.push_back(flow->assigned_scheduler_);
+    }
+    SolverInfocom cold_solver(schedulers, /*debug_level=*/0);
+    ASSERT_TRUE(cold_solver.FindRoute(
+        coflow, src_reserved_bps, dst_reserved_bps, &cold_alpha));
+    EXPECT_NEAR(warm_alpha, cold_alpha, 1e-9 * cold_alpha);
+    int flow_idx = 0;
+    for (Flow* flow : *coflow->GetFlows()) {
+      EXPECT_EQ(flow->assigned_scheduler_, warm_route[flow_idx++]);
+    }
+  }
+}
+
+TEST_F(SolverTest, Infocom_StickyRouting) {
+  INFOCOM_STICKY_ROUTING = true;
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  long ONE_GIGA_BPS = (long) 1e9;
+  vector<Scheduler*> schedulers(
+      {new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 1),
+       new SchedulerVarysImpl(ONE_GIGA_BPS / 3 * 2)});
+  MinCCTCache cache;
+  cache.Add(coflows);
+  SolverInfocom solver_infocom(schedulers, /*debug_level=*/0, nullptr, &cache);
+  map<long, long> rates_1, rates_2;
+  solver_infocom.ComputeRouteAndRate(coflows, &rates_1);
+  long num_misses = cache.GetNumMisses(), num_hits = cache.GetNumHits();
+  map<Flow*, Scheduler*> routes;
+  for (Coflow* coflow : coflows) {
+    EXPECT_TRUE(coflow->infocom_sticky_route_);
+    for (Flow* flow : *coflow->GetFlows()) {
+      routes[flow] = flow->assigned_scheduler_;
+    }
+  }
+  // a reschedule after some transmission keeps every route, without routing.
+  for (Coflow* coflow : coflows) {
+    for (Flow* flow : *coflow->GetFlows()) {
+      flow->SetRate(rates_1[flow->GetFlowId()], 0L);
+      flow->Transmit(0, 0.001);
+    }
+  }
+  solver_infocom.ComputeRouteAndRate(coflows, &rates_2);
+  EXPECT_EQ(cache.GetNumMisses(), num_misses);
+  EXPECT_EQ(cache.GetNumHits(), num_hits);
+  for (const auto& flow_scheduler : routes) {
+    EXPECT_EQ(flow_scheduler.first->assigned_scheduler_,
+              flow_scheduler.second);
+  }
+}
+
 TEST_F(SolverTest, Infocom_ManyCoflow) {
   vector<Coflow*> coflows;
   LoadAllCoflows(coflows);
@@ -2,6 +2,7 @@
 // Created by Xin Sunny Huang on 3/5/17.
 //
 
+#include <cstdio>
 #include <memory>
 
 #include "gtest/gtest.h"
@@ -41,3 +42,390 @@ TEST_F(TrafficGeneratorTest, TaskPlacementFromTrace) {
     EXPECT_EQ(expected_reducers, actual_reducers);
   }
 }
+
+TEST_F(TrafficGeneratorTest, TraceReader) {
+  TraceReader reader(TEST_DATA_DIR_ + "test_trace.txt");
+  TraceRecord record;
+  bool legal;
+  // a line is kept until popped.
+  ASSERT_TRUE(reader.Peek(&record, &legal));
+  ASSERT_TRUE(reader.Peek(&record, &legal));
+  EXPECT_TRUE(legal);
+  EXPECT_EQ(record.job_id, 1);
+  reader.Pop();
+  ASSERT_TRUE(reader.Peek(&record, &legal));
+  EXPECT_TRUE(legal);
+  EXPECT_EQ(record.job_id, 2);
+  EXPECT_EQ(record.arrival_ms, 0);
+  EXPECT_EQ(record.mapper_locations, vector<int>({104, 132}));
+  EXPECT_EQ(record.reducer_locations, vector<int>({140}));
+  EXPECT_EQ(record.reducer_input_bytes, vector<long>({48000000}));
+  int num_lines = 2;
+  for (reader.Pop(); reader.Peek(&record, &legal); reader.Pop()) {
+    EXPECT_TRUE(legal);
+    num_lines++;
+  }
+  EXPECT_EQ(num_lines, 14);
+
+  // the last line needs no line break.
+  TraceReader reader_2(TEST_DATA_DIR_ + "test_trace_2.txt");
+  num_lines = 0;
+  for (; reader_2.Peek(&record, &legal); reader_2.Pop()) {
+    EXPECT_TRUE(legal);
+    num_lines++;
+  }
+  EXPECT_EQ(num_lines, 14);
+  EXPECT_EQ(record.job_id, 108);
+
+  string info = "3,66,79#14:5.5,100:7";
+  EXPECT_TRUE(TraceReader::ParseCoflowInfo(
+      info.data(), info.data() + info.size(), 3, 2, &record));
+  EXPECT_EQ(record.mapper_locations, vector<int>({3, 66, 79}));
+  EXPECT_EQ(record.reducer_locations, vector<int>({14, 100}));
+  EXPECT_EQ(record.reducer_input_bytes, vector<long>({5000000, 7000000}));
+  EXPECT_FALSE(TraceReader::ParseCoflowInfo(
+      info.data(), info.data() + info.size(), 3, 3, &record));
+  info = "3,66#14";
+  EXPECT_FALSE(TraceReader::ParseCoflowInfo(
+      info.data(), info.data() + info.size(), 2, 1, &record));
+}
+
+TEST_F(TrafficGeneratorTest, BinaryTrace) {
+  // in the working directory, not among the test data.
+  string binary_file_name = "test_trace_2.bin";
+  ConvertTraceToBinary(TEST_DATA_DIR_ + "test_trace_2.txt", binary_file_name);
+  TraceReader text_reader(TEST_DATA_DIR_ + "test_trace_2.txt");
+  TraceReader binary_reader(binary_file_name);
+  EXPECT_FALSE(text_reader.IsBinary());
+  EXPECT_TRUE(binary_reader.IsBinary());
+  TraceRecord text_record, binary_record;
+  bool text_legal, binary_legal;
+  int num_coflows = 0;
+  while (text_reader.Peek(&text_record, &text_legal)) {
+    ASSERT_TRUE(binary_reader.Peek(&binary_record, &binary_legal));
+    EXPECT_TRUE(binary_legal);
+    EXPECT_EQ(binary_record.job_id, text_record.job_id);
+    EXPECT_EQ(binary_record.arrival_ms, text_record.arrival_ms);
+    EXPECT_EQ(binary_record.mapper_locations, text_record.mapper_locations);
+    EXPECT_EQ(binary_record.reducer_locations, text_record.reducer_locations);
+    EXPECT_EQ(binary_record.reducer_input_bytes,
+              text_record.reducer_input_bytes);
+    text_reader.Pop();
+    binary_reader.Pop();
+    num_coflows++;
+  }
+  EXPECT_FALSE(binary_reader.Peek(&binary_record, &binary_legal));
+  EXPECT_EQ(num_coflows, 14);
+
+  // seek by the indexes, or by scanning text.
+  for (TraceReader* reader : {&binary_reader, &text_reader}) {
+    TraceRecord record;
+    bool legal;
+    ASSERT_TRUE(reader->SeekToJob(19));
+    ASSERT_TRUE(reader->Peek(&record, &legal));
+    EXPECT_EQ(record.job_id, 19);
+    EXPECT_EQ(record.arrival_ms, 50);
+    reader->SeekToTime(115);
+    ASSERT_TRUE(reader->Peek(&record, &legal));
+    EXPECT_EQ(record.job_id, 54);
+    EXPECT_FALSE(reader->SeekToJob(1000));
+    ASSERT_TRUE(reader->Peek(&record, &legal));
+    EXPECT_EQ(record.job_id, 54);
+  }
+
+  // replay starts at the coflow, as if the trace started there.
+  TRAFFIC_TRACE_FILE_NAME = binary_file_name;
+  TRACE_START_JOB_ID = 54;
+  traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  ASSERT_EQ(coflows.size(), 2);
+  EXPECT_EQ(coflows[0]->GetJobId(), 54);
+  EXPECT_EQ(coflows[0]->GetStartTime(), 0);
+  EXPECT_NEAR(coflows[1]->GetStartTime(), 0.010, 1e-12);
+  for (Coflow* coflow : coflows) delete coflow;
+  TRACE_START_JOB_ID = -1;
+  remove(binary_file_name.c_str());
+}
+
+TEST_F(TrafficGeneratorTest, SyntheticTrace) {
+  SyntheticTraceOptions options =
+      SyntheticTraceOptions::FromName("synthetic_mmpp_10_2000_1.2_7", 1000);
+  EXPECT_EQ(options.arrival, "mmpp");
+  EXPECT_EQ(options.arrival_rate, 10);
+  EXPECT_EQ(options.num_coflows, 2000);
+  EXPECT_EQ(options.skew, 1.2);
+  EXPECT_EQ(options.seed, 7);
+  EXPECT_EQ(options.num_racks, 1000);
+
+  // the same seed gives the same coflows.
+  SyntheticTraceSource source(options), same_source(options);
+  TraceRecord record, same_record;
+  bool legal, same_legal;
+  int num_coflows = 0;
+  double last_arrival_ms = 0;
+  while (source.Peek(&record, &legal)) {
+    ASSERT_TRUE(same_source.Peek(&same_record, &same_legal));
+    EXPECT_TRUE(legal);
+    EXPECT_EQ(record.arrival_ms, same_record.arrival_ms);
+    EXPECT_EQ(record.mapper_locations, same_record.mapper_locations);
+    EXPECT_EQ(record.reducer_locations, same_record.reducer_locations);
+    EXPECT_EQ(record.reducer_input_bytes, same_record.reducer_input_bytes);
+    EXPECT_GE(record.arrival_ms, last_arrival_ms);
+    last_arrival_ms = record.arrival_ms;
+    EXPECT_EQ(record.mapper_locations.size(), record.num_map);
+    EXPECT_EQ(record.reducer_locations.size(), record.num_red);
+    EXPECT_EQ(set<int>(record.mapper_locations.begin(),
+                       record.mapper_locations.end()).size(), record.num_map);
+    for (int location : record.reducer_locations) {
+      EXPECT_TRUE(location >= 0 && location < 1000);
+    }
+    for (long bytes : record.reducer_input_bytes) {
+      EXPECT_GE(bytes, 1000000);
+    }
+    source.Pop();
+    same_source.Pop();
+    num_coflows++;
+  }
+  EXPECT_FALSE(same_source.Peek(&same_record, &same_legal));
+  EXPECT_EQ(num_coflows, 2000);
+  // 10 coflows per second on average.
+  EXPECT_NEAR(last_arrival_ms / 1000, 200, 100);
+
+  // replayed as a trace of the default 150 racks.
+  traffic_generator_.reset(new TGSynthetic(nullptr/*db_logger*/,
+                                           "synthetic_poisson_1_20"));
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  EXPECT_EQ(coflows.size(), 20);
+  EXPECT_EQ(coflows[0]->GetStartTime(), 0);
+  for (Coflow* coflow : coflows) delete coflow;
+}
+
+TEST_F(TrafficGeneratorTest, TraceScaler) {
+  TraceScalerOptions options =
+      TraceScalerOptions::FromName("locality_3_0.05_5", 600);
+  EXPECT_EQ(options.mode, "locality");
+  EXPECT_EQ(options.copies, 3);
+  EXPECT_EQ(options.shift_ms, 50);
+  EXPECT_EQ(options.seed, 5);
+
+  // rack r of the trace is placed on racks [4r, 4r + 4).
+  TraceReader reader(TEST_DATA_DIR_ + "test_trace_2.txt");
+  TraceScaler scaler(new TraceReader(TEST_DATA_DIR_ + "test_trace_2.txt"),
+                     options);
+  map<int, TraceRecord> originals;
+  TraceRecord record;
+  bool legal;
+  while (reader.Peek(&record, &legal)) {
+    originals[record.job_id] = record;
+    reader.Pop();
+  }
+  set<int> job_ids;
+  double last_arrival_ms = 0;
+  while (scaler.Peek(&record, &legal)) {
+    ASSERT_TRUE(legal);
+    scaler.Pop();
+    EXPECT_TRUE(job_ids.insert(record.job_id).second);
+    const TraceRecord& original = originals[record.job_id / 3];
+    EXPECT_GE(record.arrival_ms, last_arrival_ms);
+    last_arrival_ms = record.arrival_ms;
+    EXPECT_GE(record.arrival_ms, original.arrival_ms);
+    EXPECT_LT(record.arrival_ms, original.arrival_ms + 50);
+    EXPECT_EQ(record.reducer_input_bytes, original.reducer_input_bytes);
+    ASSERT_EQ(record.mapper_locations.size(), original.num_map);
+    for (int i = 0; i < original.num_map; i++) {
+      EXPECT_EQ(record.mapper_locations[i] / 4,
+                original.mapper_locations[i]);
+    }
+    ASSERT_EQ(record.reducer_locations.size(), original.num_red);
+    for (int i = 0; i < original.num_red; i++) {
+      EXPECT_EQ(record.reducer_locations[i] / 4,
+                original.reducer_locations[i]);
+    }
+  }
+  EXPECT_EQ(job_ids.size(), 3 * originals.size());
+
+  // replayed with fresh placements of the copies.
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace_2.txt";
+  TRACE_SCALE = "random_2";
+  traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
+  vector<Coflow*> coflows;
+  LoadAllCoflows(coflows);
+  EXPECT_EQ(coflows.size(), 2 * originals.size());
+  for (Coflow* coflow : coflows) delete coflow;
+  TRACE_SCALE = "";
+}
+
+// Racks of a coflow stay distinct when remapped onto as many racks or more,
+// so no flow is dropped for sharing its src and dst. Copies of the coflows
+// take fresh placements.
+TEST_F(TrafficGeneratorTest, TraceScalerKeepsBytes) {
+  vector<Coflow*> originals;
+  LoadAllCoflows(originals);
+  map<int, double> bytes_of_job;
+  for (Coflow* coflow : originals) {
+    bytes_of_job[coflow->GetJobId()] = coflow->GetSizeInByte();
+    delete coflow;
+  }
+  for (int num_racks : {150, 300}) {
+    for (string scale : {"hash_8", "locality_8"}) {
+      NUM_RACKS = num_racks;
+      TRACE_SCALE = scale;
+      traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
+      vector<Coflow*> coflows;
+      LoadAllCoflows(coflows);
+      EXPECT_EQ(coflows.size(), 8 * bytes_of_job.size());
+      for (Coflow* coflow : coflows) {
+        EXPECT_EQ(coflow->GetSizeInByte(),
+                  bytes_of_job[coflow->GetJobId() / 8])
+            << scale << " on " << num_racks << " racks, job "
+            << coflow->GetJobId();
+        delete coflow;
+      }
+    }
+  }
+  NUM_RACKS = 150;
+  TRACE_SCALE = "";
+}
+
+TEST_F(TrafficGeneratorTest, CounterRng) {
+  // known answer of Philox4x32-10 for the zero key and counter.
+  CounterRng zero(0, 0, 0);
+  EXPECT_EQ(zero(), 0x6627e8d5);
+  EXPECT_EQ(zero(), 0xe169c58d);
+  EXPECT_EQ(zero(), 0xbc57ac4c);
+  EXPECT_EQ(zero(), 0x9b00dbd8);
+
+  // streams are pure functions of (seed, coflow id, flow index).
+  CounterRng rng(13, 1000000, 7), same_rng(13, 1000000, 7);
+  CounterRng other_flow(13, 1000000, 8), other_seed(14, 1000000, 7);
+  int num_same_as_other = 0;
+  for (int i = 0; i < 100; i++) {
+    uint32_t draw = rng();
+    EXPECT_EQ(draw, same_rng());
+    if (draw == other_flow() || draw == other_seed()) num_same_as_other++;
+  }
+  EXPECT_EQ(num_same_as_other, 0);
+
+  vector<long> cumulative = {1, 1, 4};
+  int picks[3] = {0, 0, 0};
+  for (int i = 0; i < 4000; i++) {
+    double uniform = rng.Uniform();
+    EXPECT_TRUE(uniform >= 0 && uniform < 1);
+    EXPECT_LT(rng.Below(10), 10);
+    picks[rng.Pick(cumulative)]++;
+  }
+  EXPECT_NEAR(picks[0], 1000, 150);
+  EXPECT_EQ(picks[1], 0);
+  EXPECT_NEAR(picks[2], 3000, 150);
+}
+
+TEST_F(TrafficGeneratorTest, ParallelCoflowBuild) {
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace_2.txt";
+  vector<Coflow*> coflows, parallel_coflows;
+  traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
+  LoadAllCoflows(coflows);
+  NUM_TRAFFIC_THREADS = 4;
+  traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
+  LoadAllCoflows(parallel_coflows);
+  NUM_TRAFFIC_THREADS = 1;
+
+  // ids follow in the order of arrival, as if built one at a time.
+  ASSERT_EQ(parallel_coflows.size(), coflows.size());
+  int num_coflows = (int) coflows.size();
+  for (int i = 0; i < num_coflows; i++) {
+    Coflow* coflow = coflows[i];
+    Coflow* parallel_coflow = parallel_coflows[i];
+    EXPECT_EQ(parallel_coflow->GetJobId(), coflow->GetJobId());
+    EXPECT_EQ(parallel_coflow->GetCoflowId(),
+              coflow->GetCoflowId() + num_coflows);
+    EXPECT_EQ(parallel_coflow->GetStartTime(), coflow->GetStartTime());
+    ASSERT_EQ(parallel_coflow->GetFlows()->size(), coflow->GetFlows()->size());
+    for (int j = 0; j < (int) coflow->GetFlows()->size(); j++) {
+      Flow* flow = coflow->GetFlows()->at(j);
+      Flow* parallel_flow = parallel_coflow->GetFlows()->at(j);
+      EXPECT_EQ(parallel_flow->GetFlowId() - parallel_coflows[0]
+                    ->GetFlows()->at(0)->GetFlowId(),
+                flow->GetFlowId() - coflows[0]->GetFlows()->at(0)->GetFlowId());
+      EXPECT_EQ(parallel_flow->GetSizeInBit(), flow->GetSizeInBit());
+    }
+  }
+  for (Coflow* coflow : coflows) delete coflow;
+  for (Coflow* coflow : parallel_coflows) delete coflow;
+}
+
+TEST_F(TrafficGeneratorTest, FlowSizeMatrix) {
+  // 3 mappers to 2 reducers of 9MB and 4MB, split exactly.
+  Coflow* coflow = GenerateCoflow(0, 1, 3, 2, "1,2,3#4:9,5:4",
+                                  false/*do_perturb*/, false/*avg_size*/);
+  const FlowSizeMatrix& mr_flow_bytes = coflow->GetMRFlowBytes();
+  ASSERT_EQ(mr_flow_bytes.GetNumMap(), 3);
+  ASSERT_EQ(mr_flow_bytes.GetNumRed(), 2);
+  EXPECT_EQ(mr_flow_bytes.GetBytes(),
+            vector<long>({3000000, 1333334, 3000000, 1333334,
+                          3000000, 1333332}));
+  // flows follow the matrix, row by row.
+  ASSERT_EQ(coflow->GetFlows()->size(), 6);
+  for (int i = 0; i < 6; i++) {
+    Flow* flow = coflow->GetFlows()->at(i);
+    EXPECT_EQ(flow->GetIndexInCoflow(), i);
+    EXPECT_EQ(flow->GetSrc(), 1 + i / 2);
+    EXPECT_EQ(flow->GetDest(), 4 + i % 2);
+    EXPECT_EQ(flow->GetSizeInBit(), 8 * mr_flow_bytes.GetBytes()[i]);
+  }
+  delete coflow;
+}
+
+TEST_F(TrafficGeneratorTest, FlowGroups) {
+  // 3 mappers to 2 reducers of 9MB and 4MB, split exactly. Mapper 3 shares
+  // a rack with reducer 5, and sends less to it.
+  FLOW_GROUPS = true;
+  Coflow* grouped = GenerateCoflow(0, 1, 3, 2, "1,2,5#4:9,5:4",
+                                   false/*do_perturb*/, false/*avg_size*/);
+  FLOW_GROUPS = false;
+  Coflow* coflow = GenerateCoflow(0, 1, 3, 2, "1,2,5#4:9,5:4",
+                                  false/*do_perturb*/, false/*avg_size*/);
+  // 1,2,5 -> 4 of 3MB each, and 1,2 -> 5 of 1.33MB each.
+  ASSERT_EQ(grouped->GetFlows()->size(), 2);
+  Flow* group = grouped->GetFlows()->at(0);
+  EXPECT_EQ(group->GetNumMembers(), 3);
+  EXPECT_EQ(group->GetMemberSrc(2), 5);
+  EXPECT_EQ(group->GetDest(), 4);
+  EXPECT_EQ(group->GetSizeInBit(), 8 * 3000000);
+  group = grouped->GetFlows()->at(1);
+  EXPECT_EQ(group->GetNumMembers(), 2);
+  EXPECT_EQ(group->GetDest(), 5);
+  EXPECT_EQ(group->GetIndexInCoflow(), 1);
+  // ports are loaded as by the flows of the group.
+  EXPECT_EQ(grouped->GetSizeInByte(), coflow->GetSizeInByte());
+  EXPECT_EQ(grouped->CalcAlpha(), coflow->CalcAlpha());
+  EXPECT_EQ(grouped->CalcTotalBitsLeft(), coflow->CalcTotalBitsLeft());
+  EXPECT_EQ(grouped->GetLoadOnPortInBits(5, -1),
+            coflow->GetLoadOnPortInBits(5, -1));
+  EXPECT_EQ(grouped->GetLoadOnPortInBits(-1, 4),
+            coflow->GetLoadOnPortInBits(-1, 4));
+  delete grouped;
+  delete coflow;
+}
+
+TEST_F(TrafficGeneratorTest, AggregateRackPairs) {
+  // mappers 1 and 2 share rack 1, and send 3MB and 2MB to each reducer.
+  AGGREGATE_RACK_PAIRS = true;
+  Coflow* coflow = GenerateCoflow(0, 1, 3, 2, "1,1,2#3:9,4:6",
+                                  false/*do_perturb*/, false/*avg_size*/);
+  ASSERT_EQ(coflow->GetFlows()->size(), 4);
+  Flow* merged = coflow->GetFlows()->at(0);
+  EXPECT_EQ(merged->GetSrc(), 1);
+  EXPECT_EQ(merged->GetDest(), 3);
+  EXPECT_EQ(merged->GetSizeInBit(), 8 * 6000000);
+  EXPECT_EQ(merged->GetBitsLeft(), 8 * 6000000);
+  ASSERT_EQ(merged->GetNumMerged(), 2);
+  EXPECT_EQ(merged->GetMergedSizeInBit(1), 8 * 3000000);
+  EXPECT_EQ(coflow->GetFlows()->at(1)->GetDest(), 4);
+  EXPECT_EQ(coflow->GetFlows()->at(1)->GetNumMerged(), 2);
+  EXPECT_EQ(coflow->GetFlows()->at(2)->GetNumMerged(), 1);
+  EXPECT_EQ(coflow->GetSizeInByte(), 15000000);
+  EXPECT_EQ(coflow->GetMaxPortLoadInBits(), 8 * 10000000);
+  delete coflow;
+}
@@ -16,6 +16,12 @@ class XimulatorHPNsTest : public XimulatorTestBase {
     DEBUG_LEVEL = 0;
     TEST_ONLY_SAVE_COFLOW_AFTER_FINISH = false;
     ENABLE_PERTURB_IN_PLAY = false;
+    NUM_SCHEDULER_THREADS = 1;
+    ZERO_COMP_TIME = true;
+    COMP_TIME_MODEL_NAME = "measured";
+    INFOCOM_STICKY_ROUTING = false;
+    PORT_CAPACITY_FILE_NAME = "";
+    LP_SOLVER_NAME = "";
     TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
     ximulator_.reset(new Simulator());
   }
@@ -48,6 +54,28 @@ class XimulatorHPNsTest : public XimulatorTestBase {
     }
   }
 
+  // Split parent flows finish only after all their sub-flows, and the bits
+  // of every flow through the networks add up to its size.
+  void VerifySplitFlows(int num_networks) {
+    int num_split_flows = 0;
+    for (Coflow* coflow : ximulator_->GetSavedCoflow()) {
+      for (Flow* flow : *coflow->GetFlows()) {
+        EXPECT_EQ(flow->GetBitsLeft(), 0);
+        EXPECT_LE(flow->GetEndTime(), coflow->GetEndTime());
+        if (flow->GetNumSubFlows() > 0) {
+          num_split_flows++;
+          EXPECT_EQ(flow->GetNumSubFlowsFinished(), flow->GetNumSubFlows());
+        }
+        long bits_on_networks = 0;
+        for (int net_idx = 0; net_idx < num_networks; net_idx++) {
+          bits_on_networks += flow->GetBitsOnNetwork(net_idx);
+        }
+        EXPECT_EQ(bits_on_networks, flow->GetSizeInBit());
+      }
+    }
+    EXPECT_GT(num_split_flows, 0);
+  }
+
   std::unique_ptr<Simulator> ximulator_;
 };
 
@@ -155,6 +183,8 @@ TEST_F(XimulatorHPNsTest, InfocomOnIntraCoflow) {
   ximulator_->InstallTrafficGen("fb1by1", &db_logger_);
   ximulator_->InstallScheduler("infocom_20varys_80varys");
   ximulator_->Run();
+  // the same routes with or without Gurobi, by the second objective of the
+  // routing LP.
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
               REMOTE_IN_OUT_PORTS ? -1 : 3.870000, 1e-6);
 }
@@ -174,7 +204,7 @@ TEST_F(XimulatorHPNsTest, WeaverOnInterCoflow_2net_OnlineTrace2) {
   ximulator_->InstallTrafficGen("fbplay", &db_logger_);
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
-              REMOTE_IN_OUT_PORTS ? -1 : 2.980000, 1e-6);
+              REMOTE_IN_OUT_PORTS ? -1 : 3.260000, 1e-6);
 }
 
 TEST_F(XimulatorHPNsTest, InfocomOnInterCoflow) {
@@ -183,7 +213,40 @@ TEST_F(XimulatorHPNsTest, InfocomOnInterCoflow) {
   ximulator_->InstallScheduler("infocom_20varys_80varys");
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
-              REMOTE_IN_OUT_PORTS ? -1 : 3.399656, 1e-6);
+              REMOTE_IN_OUT_PORTS ? -1 : 3.372037, 1e-6);
+}
+
+// Test for infocom evaluating coflows concurrently, with the same result.
+TEST_F(XimulatorHPNsTest, InfocomConcurrentOnInterCoflow) {
+  NUM_SCHEDULER_THREADS = 4;
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->InstallScheduler("infocom_20varys_80varys");
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 3.372037, 1e-6);
+}
+
+// Test for infocom with routes solved within 10% of the routing LP.
+TEST_F(XimulatorHPNsTest, InfocomApproxOnInterCoflow) {
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->InstallScheduler("infocomApprox10_20varys_80varys");
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 3.277581, 1e-6);
+}
+
+// Test for infocom routing only new coflows, on routes of the approximate
+// solver, which do not depend on the LP backend.
+TEST_F(XimulatorHPNsTest, InfocomStickyOnInterCoflow) {
+  INFOCOM_STICKY_ROUTING = true;
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->InstallScheduler("infocomApprox10_20varys_80varys");
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 3.560000, 1e-6);
 }
 
 TEST_F(XimulatorHPNsTest, WeaverOnIntraCoflow_3net) {
@@ -200,4 +263,95 @@ TEST_F(XimulatorHPNsTest, WeaverOnInterCoflow_3net) {
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
               REMOTE_IN_OUT_PORTS ? -1 : 4.266667, 1e-6);
-}
\ No newline at end of file
+}
+
+// Test for weaver scheduler splitting large flows across networks.
+TEST_F(XimulatorHPNsTest, WeaverSplitFlowOnInterCoflow_2net) {
+  TEST_ONLY_SAVE_COFLOW_AFTER_FINISH = true;
+  ximulator_->InstallScheduler("weaverSplitFlow_20varys_80varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  VerifySplitFlows(2);
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.739000, 1e-6);
+}
+
+TEST_F(XimulatorHPNsTest, WeaverSplitFlowOnInterCoflow_3net) {
+  TEST_ONLY_SAVE_COFLOW_AFTER_FINISH = true;
+  ximulator_->InstallScheduler("weaverSplitFlow_20varys_20varys_60varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  VerifySplitFlows(3);
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.763555, 1e-6);
+}
+
+// Test for children schedulers on computation time models of their own.
+TEST_F(XimulatorHPNsTest, WeaverCompTimeModelPerChild_2net) {
+  for (const string& name : {"weaver_20varys_cost_80aalo_measured",
+                             "weaver_2net_varys_20_cost_80"}) {
+    vector<Scheduler*> schedulers =
+        SchedulerFactory::GenerateChildrenSchedulers(name);
+    ASSERT_EQ(schedulers.size(), 2);
+    CompTimeModel* cost_model =
+        dynamic_cast<SchedulerVarys*>(schedulers[0])->GetCompTimeModel();
+    CompTimeModel* measured_model =
+        dynamic_cast<SchedulerVarys*>(schedulers[1])->GetCompTimeModel();
+    EXPECT_NE(dynamic_cast<CostCompTimeModel*>(cost_model), nullptr);
+    EXPECT_NE(dynamic_cast<MeasuredCompTimeModel*>(measured_model), nullptr);
+    for (Scheduler* scheduler : schedulers) delete scheduler;
+  }
+
+  // the 800Mbps network reschedules at the default costs, the other one at
+  // those of COMP_TIME_MODEL_NAME. Both at the latter take 9.386360s, and
+  // both at the default costs 3.292635s.
+  ZERO_COMP_TIME = false;
+  COMP_TIME_MODEL_NAME = "cost_100000_10000_1000_1000";
+  ximulator_->InstallScheduler("weaver_20varys_80varys_cost");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 3.828205, 1e-6);
+}
+
+// Test for children schedulers rescheduling concurrently.
+TEST_F(XimulatorHPNsTest, WeaverConcurrentScheduleOnInterCoflow_3net) {
+  NUM_SCHEDULER_THREADS = 3;
+  ximulator_->InstallScheduler("weaver_20varys_20varys_60varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 4.266667, 1e-6);
+}
+
+// Test for networks degrading and recovering during the run.
+TEST_F(XimulatorHPNsTest, WeaverOnCapacityChange_2net) {
+  ximulator_->InstallScheduler("weaver_20varys_80varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  // the 800Mbps network goes down for 1s, and then recovers at half rate.
+  ximulator_->AddCapacityChange(0.5, 1, 0);
+  ximulator_->AddCapacityChange(1.5, 1, 400000000);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 5.651000, 1e-6);
+}
+
+TEST_F(XimulatorHPNsTest, InfocomOnCapacityChange_2net) {
+  ximulator_->InstallScheduler("infocom_20varys_80varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->AddCapacityChange(0.5, 1, 0);
+  ximulator_->AddCapacityChange(1.5, 1, 400000000);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 4.363603, 1e-6);
+}
+
+// Test for ports slower than the link rate of their network.
+TEST_F(XimulatorHPNsTest, WeaverOnPortCapacity_2net) {
+  PORT_CAPACITY_FILE_NAME = TEST_DATA_DIR_ + "test_port_capacity.txt";
+  ximulator_->InstallScheduler("weaver_20varys_80varys");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 3.771000, 1e-6);
+}
@@ -2,8 +2,12 @@
 // Created by Xin Sunny Huang on 10/22/16.
 //
 
+#include <cstdio>
+
 #include "gtest/gtest.h"
+#include "src/comp_time_model.h"
 #include "src/events.h"
+#include "src/profiler.h"
 #include "ximulator_test_base.h"
 
 class XimulatorTest : public XimulatorTestBase {
@@ -16,6 +20,18 @@ class XimulatorTest : public XimulatorTestBase {
     DEBUG_LEVEL = 0;
     TEST_ONLY_SAVE_COFLOW_AFTER_FINISH = false;
     ENABLE_PERTURB_IN_PLAY = true;
+    ZERO_COMP_TIME = true;
+    COMP_TIME_MODEL_NAME = "measured";
+    LOG_COMP_STAT = false;
+    TRACE_START_MS = 0;
+    TRACE_START_JOB_ID = -1;
+    TRACE_PREFETCH_WINDOW_SEC = 0;
+    NUM_TRAFFIC_THREADS = 1;
+    EQUAL_FLOW_TO_SAME_REDUCER = false;
+    FLOW_GROUPS = false;
+    AGGREGATE_RACK_PAIRS = false;
+    TRACE_SCALE = "";
+    NUM_RACKS = 150;
     TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
     ximulator_.reset(new Simulator());
   }
@@ -29,7 +45,7 @@ TEST_F(XimulatorTest, VarysOnInterCoflow) {
   ximulator_->InstallTrafficGen("fbplay", &db_logger_);
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
-              REMOTE_IN_OUT_PORTS ? 2.664297 : 2.640789, 1e-6);
+              REMOTE_IN_OUT_PORTS ? 2.685296 : 2.661228, 1e-6);
 }
 
 TEST_F(XimulatorTest, VarysOnInterCoflow_trace2) {
@@ -38,7 +54,158 @@ TEST_F(XimulatorTest, VarysOnInterCoflow_trace2) {
   ximulator_->InstallTrafficGen("fbplay", &db_logger_);
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
-              REMOTE_IN_OUT_PORTS ? -1 : 2.344487, 1e-6);
+              REMOTE_IN_OUT_PORTS ? -1 : 2.636472, 1e-6);
+}
+
+TEST_F(XimulatorTest, VarysOnInterCoflow_BinaryTrace2) {
+  // in the working directory, not among the test data.
+  ConvertTraceToBinary(TEST_DATA_DIR_ + "test_trace_2.txt",
+                       "test_trace_2.bin");
+  TRAFFIC_TRACE_FILE_NAME = "test_trace_2.bin";
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.636472, 1e-6);
+  remove("test_trace_2.bin");
+}
+
+// The trace is parsed at most 15ms of trace time ahead, i.e. 2 coflows.
+TEST_F(XimulatorTest, VarysOnInterCoflow_PrefetchTrace2) {
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace_2.txt";
+  TRACE_PREFETCH_WINDOW_SEC = 0.015;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.636472, 1e-6);
+}
+
+// Coflows are built 4 at a time ahead of their arrival, with the same ids.
+TEST_F(XimulatorTest, VarysOnInterCoflow_ParallelBuildTrace2) {
+  TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace_2.txt";
+  NUM_TRAFFIC_THREADS = 4;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.636472, 1e-6);
+}
+
+// Flows into a reducer are all of the same size, and sent as flow groups.
+TEST_F(XimulatorTest, VarysOnInterCoflow_FlowGroups) {
+  ENABLE_PERTURB_IN_PLAY = false;
+  EQUAL_FLOW_TO_SAME_REDUCER = true;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  double total_cct = ximulator_->GetTotalCCT();
+
+  FLOW_GROUPS = true;
+  ximulator_.reset(new Simulator());
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(), total_cct, 1e-6);
+}
+
+// Same as above, with synthetic coflows contending for the srcs of 10 racks.
+TEST_F(XimulatorTest, VarysOnSrcContention_FlowGroups) {
+  ENABLE_PERTURB_IN_PLAY = false;
+  EQUAL_FLOW_TO_SAME_REDUCER = true;
+  NUM_RACKS = 10;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("synthetic_poisson_2_30_1_3", &db_logger_);
+  ximulator_->Run();
+  double total_cct = ximulator_->GetTotalCCT();
+
+  FLOW_GROUPS = true;
+  ximulator_.reset(new Simulator());
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("synthetic_poisson_2_30_1_3", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(), total_cct, 1e-6);
+}
+
+// Coflows of the trace share racks once packed onto 40 racks, and flows
+// between the same racks are merged.
+TEST_F(XimulatorTest, VarysOnInterCoflow_AggregateRackPairs) {
+  TRACE_SCALE = "locality";
+  NUM_RACKS = 40;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  double total_cct = ximulator_->GetTotalCCT();
+
+  AGGREGATE_RACK_PAIRS = true;
+  ximulator_.reset(new Simulator());
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  // the spare bandwidth work conservation gives to the first of the flows is
+  // no longer idle once it finishes ahead of the others.
+  EXPECT_NEAR(ximulator_->GetTotalCCT(), total_cct, 1e-2);
+}
+
+// Test for schedules delayed by the cost of rate control, which is the same
+// on every run.
+TEST_F(XimulatorTest, VarysOnInterCoflow_CostCompTime) {
+  ZERO_COMP_TIME = false;
+  COMP_TIME_MODEL_NAME = "cost_1000_100_10_10";
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  EXPECT_NEAR(ximulator_->GetTotalCCT(),
+              REMOTE_IN_OUT_PORTS ? -1 : 2.726994, 1e-6);
+}
+
+TEST_F(XimulatorTest, CompTimeModel) {
+  unique_ptr<CompTimeModel> model(CompTimeModel::Create("cost_5_1_0.5_0.25"));
+  CompTimeCounters counters;
+  counters.num_coflows = 2;
+  counters.num_flows = 10;
+  counters.num_ports = 4;
+  model->Start();
+  EXPECT_NEAR(model->Stop(counters), (5 + 2 + 5 + 1) / 1e6, 1e-12);
+  model.reset(CompTimeModel::Create("measured"));
+  model->Start();
+  EXPECT_GE(model->Stop(counters), 0);
+}
+
+TEST_F(XimulatorTest, ProfileVarys) {
+  LOG_COMP_STAT = true;
+  ximulator_->InstallScheduler("varysImpl");
+  ximulator_->InstallTrafficGen("fbplay", &db_logger_);
+  ximulator_->Run();
+  LOG_COMP_STAT = false;
+  // one root for the only scheduler, whose phases are nested under it.
+  vector<string> paths = Profiler::Get().GetPaths();
+  ASSERT_FALSE(paths.empty());
+  const string root = paths.front();
+  EXPECT_EQ(root.find('/'), string::npos);
+  long num_reschedules = Profiler::Get().GetCount(root);
+  EXPECT_GT(num_reschedules, 0);
+  EXPECT_EQ(Profiler::Get().GetCount(root + "/rate_control"),
+            Profiler::Get().GetCount(root + "/rate_control/sort"));
+  EXPECT_EQ(Profiler::Get().GetCount(root + "/rate_control"),
+            Profiler::Get().GetCount(
+                root + "/rate_control/work_conservation"));
+  EXPECT_LE(Profiler::Get().GetTotalSeconds(root + "/rate_control"),
+            Profiler::Get().GetTotalSeconds(root));
+  EXPECT_LE(Profiler::Get().GetQuantileSeconds(root, 0.5),
+            Profiler::Get().GetQuantileSeconds(root, 0.99));
+
+  // quarter-octave buckets.
+  Profiler::Get().Clear();
+  for (int i = 0; i < 99; i++) Profiler::Get().Record("phase", 1e-6);
+  Profiler::Get().Record("phase", 1e-3);
+  EXPECT_EQ(Profiler::Get().GetCount("phase"), 100);
+  EXPECT_NEAR(Profiler::Get().GetTotalSeconds("phase"), 99e-6 + 1e-3, 1e-12);
+  EXPECT_GE(Profiler::Get().GetQuantileSeconds("phase", 0.5), 1e-6);
+  EXPECT_LE(Profiler::Get().GetQuantileSeconds("phase", 0.5), 1.19e-6);
+  EXPECT_LE(Profiler::Get().GetQuantileSeconds("phase", 0.99), 1.19e-6);
+  EXPECT_EQ(Profiler::Get().GetQuantileSeconds("phase", 1), 1e-3);
+  Profiler::Get().Clear();
 }
 
 TEST_F(XimulatorTest, AaloOnInterCoflow) {
@@ -46,7 +213,7 @@ TEST_F(XimulatorTest, AaloOnInterCoflow) {
   ximulator_->InstallTrafficGen("fbplay", &db_logger_);
   ximulator_->Run();
   EXPECT_NEAR(ximulator_->GetTotalCCT(),
-              REMOTE_IN_OUT_PORTS ? 3.023155 : 3.004975, 1e-6);
+              REMOTE_IN_OUT_PORTS ? 2.941921 : 2.920447, 1e-6);
 }
 
 
@@ -38,6 +38,13 @@ class TrafficGeneratorTest : public XimulatorTestBase {
 
   virtual void SetUp() {
     TRAFFIC_TRACE_FILE_NAME = TEST_DATA_DIR_ + "test_trace.txt";
+    TRACE_START_MS = 0;
+    TRACE_START_JOB_ID = -1;
+    TRACE_PREFETCH_WINDOW_SEC = 0;
+    TRACE_SCALE = "";
+    NUM_TRAFFIC_THREADS = 1;
+    FLOW_GROUPS = false;
+    AGGREGATE_RACK_PAIRS = false;
     // disable db logging.
     traffic_generator_.reset(new TGTraceFB(nullptr/*db_logger*/));
   }